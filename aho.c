@@ -0,0 +1,252 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Aho-Corasick multiple pattern search
+
+   See aho.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include <ctype.h>
+#include "aho.h"
+
+/* F U N C T I O N S *********************************************************/
+
+/*
+   Build the automaton for the given patterns.  Empty patterns never
+   match.  If the same pattern is given more than once, 'aho_search'
+   reports the first one (while 'aho_search_all' reports all of them).
+   Returns NULL if out of memory.
+*/
+aho_automaton*
+aho_build(const char **patterns,
+          const size_t *pattern_lens,
+          size_t num_patterns,
+          int ignore_case) {
+    aho_automaton *ac;
+    size_t i, j, c, max_states = 1;
+    int32_t *fail = NULL, *queue = NULL;
+    size_t head = 0, tail = 0;
+
+    if ( (ac = calloc(1, sizeof(aho_automaton))) == NULL )
+        return NULL;
+
+    /* map the bytes used by the patterns onto dense classes (0 = other) */
+    ac->num_classes = 1;
+    for (i = 0; i < num_patterns; i++) {
+        for (j = 0; j < pattern_lens[i]; j++) {
+            unsigned char b = (unsigned char) patterns[i][j];
+            if (ac->class_of[b] == 0) {
+                ac->class_of[b] = (unsigned char) ac->num_classes;
+                if (ignore_case) {
+                    ac->class_of[toupper(b)] = (unsigned char) ac->num_classes;
+                    ac->class_of[tolower(b)] = (unsigned char) ac->num_classes;
+                }
+                ac->num_classes++;
+            }
+        }
+        max_states += pattern_lens[i];
+    }
+
+    ac->num_patterns = num_patterns;
+    ac->pattern_lens = malloc((num_patterns + 1) * sizeof(size_t));
+    ac->next         = malloc(max_states * ac->num_classes * sizeof(int32_t));
+    ac->match_out    = malloc(max_states * sizeof(int32_t));
+    ac->terminal     = malloc(max_states * sizeof(int32_t));
+    ac->out_link     = malloc(max_states * sizeof(int32_t));
+    ac->duplicate    = malloc((num_patterns + 1) * sizeof(int32_t));
+    fail             = malloc(max_states * sizeof(int32_t));
+    queue            = malloc(max_states * sizeof(int32_t));
+    if (ac->pattern_lens == NULL || ac->next == NULL ||
+        ac->match_out == NULL || ac->terminal == NULL ||
+        ac->out_link == NULL || ac->duplicate == NULL ||
+        fail == NULL || queue == NULL) {
+        free(fail);
+        free(queue);
+        aho_destroy(ac);
+        return NULL;
+    }
+
+    for (i = 0; i < num_patterns; i++) {
+        ac->pattern_lens[i] = pattern_lens[i];
+        ac->duplicate[i] = -1;
+    }
+
+    /* Step 1: build the trie of all patterns */
+    ac->num_states = 1;
+    for (c = 0; c < ac->num_classes; c++)
+        ac->next[c] = -1;
+    ac->match_out[0] = -1;
+    ac->terminal[0]  = -1;
+    ac->out_link[0]  = -1;
+
+    for (i = 0; i < num_patterns; i++) {
+        int32_t s = 0;
+
+        if (pattern_lens[i] == 0)
+            continue;
+
+        for (j = 0; j < pattern_lens[i]; j++) {
+            size_t k = ac->class_of[(unsigned char) patterns[i][j]];
+            int32_t *t = &ac->next[s * ac->num_classes + k];
+            if (*t == -1) {
+                *t = (int32_t) ac->num_states++;
+                for (c = 0; c < ac->num_classes; c++)
+                    ac->next[*t * ac->num_classes + c] = -1;
+                ac->match_out[*t] = -1;
+                ac->terminal[*t]  = -1;
+            }
+            s = *t;
+        }
+
+        if (ac->terminal[s] == -1) {
+            ac->terminal[s]  = (int32_t) i;
+            ac->match_out[s] = (int32_t) i;
+        }
+        else {
+            /* chain identical patterns behind the first one */
+            int32_t p = ac->terminal[s];
+            while (ac->duplicate[p] != -1)
+                p = ac->duplicate[p];
+            ac->duplicate[p] = (int32_t) i;
+        }
+    }
+
+    /* Step 2: breadth first, compute the failure links and complete the
+       transition table so every state has a transition on every class */
+    for (c = 0; c < ac->num_classes; c++) {
+        int32_t t = ac->next[c];
+        if (t == -1) {
+            ac->next[c] = 0;
+        }
+        else {
+            fail[t] = 0;
+            ac->out_link[t] = -1;
+            queue[tail++] = t;
+        }
+    }
+
+    while (head < tail) {
+        int32_t s = queue[head++];
+
+        for (c = 0; c < ac->num_classes; c++) {
+            int32_t t = ac->next[s * ac->num_classes + c];
+            int32_t f = ac->next[fail[s] * ac->num_classes + c];
+
+            if (t == -1) {
+                ac->next[s * ac->num_classes + c] = f;
+            }
+            else {
+                fail[t] = f;
+                /* a state without its own pattern reports its suffix's */
+                if (ac->match_out[t] == -1)
+                    ac->match_out[t] = ac->match_out[f];
+                ac->out_link[t] = (ac->terminal[f] != -1) ? f : ac->out_link[f];
+                queue[tail++] = t;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+
+    return ac;
+}
+
+/*
+   Find the occurrence that ends first in the text (the longest pattern
+   if several end at the same position).  Returns 1 and fills in 'match'
+   if found, otherwise 0.
+*/
+int
+aho_search(const aho_automaton *ac,
+           const char *text,
+           size_t text_len,
+           aho_match *match) {
+    const int32_t *next = ac->next;
+    const size_t num_classes = ac->num_classes;
+    int32_t s = 0;
+    size_t i;
+
+    for (i = 0; i < text_len; i++) {
+        s = next[s * num_classes + ac->class_of[(unsigned char) text[i]]];
+        if (ac->match_out[s] >= 0) {
+            match->pattern = (size_t) ac->match_out[s];
+            match->end     = i + 1;
+            match->start   = match->end - ac->pattern_lens[match->pattern];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+   Report every occurrence of every pattern, in order of their end
+   positions, to 'callback' until it returns non-zero.
+*/
+void
+aho_search_all(const aho_automaton *ac,
+               const char *text,
+               size_t text_len,
+               aho_callback callback,
+               void *data) {
+    const int32_t *next = ac->next;
+    const size_t num_classes = ac->num_classes;
+    int32_t s = 0;
+    size_t i;
+    aho_match match;
+
+    for (i = 0; i < text_len; i++) {
+        int32_t t;
+
+        s = next[s * num_classes + ac->class_of[(unsigned char) text[i]]];
+        if (ac->match_out[s] < 0)
+            continue;
+
+        t = (ac->terminal[s] != -1) ? s : ac->out_link[s];
+        for ( ; t != -1; t = ac->out_link[t]) {
+            int32_t p;
+            for (p = ac->terminal[t]; p != -1; p = ac->duplicate[p]) {
+                match.pattern = (size_t) p;
+                match.end     = i + 1;
+                match.start   = match.end - ac->pattern_lens[p];
+                if (callback(&match, data))
+                    return;
+            }
+        }
+    }
+}
+
+void
+aho_destroy(aho_automaton *ac) {
+    if (ac == NULL)
+        return;
+
+    free(ac->pattern_lens);
+    free(ac->next);
+    free(ac->match_out);
+    free(ac->terminal);
+    free(ac->out_link);
+    free(ac->duplicate);
+    free(ac);
+}
@@ -0,0 +1,94 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Aho-Corasick multiple pattern search
+
+   Alfred V. Aho and Margaret J. Corasick, "Efficient string matching:
+   an aid to bibliographic search", CACM 18(6), 1975.
+
+   The automaton is built as a full deterministic transition table, so
+   searching costs one table lookup per text character regardless of
+   the number of patterns.  To keep the table small, the bytes are
+   first mapped onto the classes of characters that actually occur in
+   the patterns (every other byte shares a single class).  A case
+   insensitive automaton puts the upper and lower case forms of a letter
+   into the same class.
+*/
+
+#ifndef _AHO_H_
+#define _AHO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+
+/* D E F I N E S *************************************************************/
+#define AHO_ALPHABET_SIZE ( 1 << CHAR_BIT)
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    size_t        num_patterns;
+    size_t        *pattern_lens;
+    size_t        num_states;
+    size_t        num_classes;
+    unsigned char class_of[AHO_ALPHABET_SIZE];  /* byte -> character class */
+    int32_t       *next;        /* num_states x num_classes transitions */
+    int32_t       *match_out;   /* longest pattern ending at a state or -1 */
+    int32_t       *terminal;    /* pattern spelled out by a state or -1 */
+    int32_t       *out_link;    /* nearest suffix state with a pattern or -1 */
+    int32_t       *duplicate;   /* next pattern identical to a pattern or -1 */
+} aho_automaton;
+
+typedef struct {
+    size_t pattern;          /* index of the matched pattern */
+    size_t start;            /* offset of the first matched text char */
+    size_t end;              /* offset one past the last matched char */
+} aho_match;
+
+/* called for each occurrence; a non-zero return value stops the search */
+typedef int (*aho_callback)(const aho_match *match, void *data);
+
+/* P R O T O T Y P E S *******************************************************/
+aho_automaton* aho_build(const char **patterns,
+                         const size_t *pattern_lens,
+                         size_t num_patterns,
+                         int ignore_case);
+int aho_search(const aho_automaton *ac,
+               const char *text,
+               size_t text_len,
+               aho_match *match);
+void aho_search_all(const aho_automaton *ac,
+                    const char *text,
+                    size_t text_len,
+                    aho_callback callback,
+                    void *data);
+void aho_destroy(aho_automaton *ac);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _AHO_H */
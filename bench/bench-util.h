@@ -0,0 +1,119 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Helpers shared by the benchmark programs in bench/
+
+   A xorshift64 random number generator, seeded the same way on every
+   run and platform (unless bench_seed() says otherwise) so the synthetic
+   reads are reproducible; a pool of
+   random ACGT reads (with a pattern planted into a fraction of them);
+   and the elapsed time between two CLOCK_MONOTONIC readings.
+
+   Each program is a single translation unit, so everything here is
+   static.
+*/
+
+#ifndef _BENCH_UTIL_H_
+#define _BENCH_UTIL_H_
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* D E F I N E S *************************************************************/
+#define BENCH_READ_POOL_SIZE 65536        /* reads, cycled through */
+
+/* G L O B A L S *************************************************************/
+static unsigned long long bench_rng_state = 88172645463325252ULL;
+
+/* F U N C T I O N S *********************************************************/
+
+/* xorshift64 -- deterministic across runs and platforms */
+static inline unsigned long long
+bench_random(void) {
+    bench_rng_state ^= bench_rng_state << 13;
+    bench_rng_state ^= bench_rng_state >> 7;
+    bench_rng_state ^= bench_rng_state << 17;
+    return bench_rng_state;
+}
+
+/* restart the sequence from 'seed' (any value, 0 included) */
+static inline void
+bench_seed(unsigned long long seed) {
+    /* xorshift needs a non-zero state */
+    bench_rng_state = seed * 2685821657736338717ULL + 88172645463325252ULL;
+    if (bench_rng_state == 0)
+        bench_rng_state = 88172645463325252ULL;
+}
+
+/* a uniform draw from [0, 1) */
+static inline double
+bench_fraction(void) {
+    return (double) (bench_random() >> 11) / 9007199254740992.0;
+}
+
+/* 'len' random bases, null terminated */
+static inline void
+bench_random_bases(char *seq, size_t len) {
+    static const char bases[] = "ACGT";
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        seq[i] = bases[bench_random() & 3];
+    seq[len] = '\0';
+}
+
+/*
+   BENCH_READ_POOL_SIZE null terminated reads of 'read_len' bases, read i
+   at i * (read_len + 1), with 'pattern' planted into a 'rate' fraction of
+   them.  Returns NULL if out of memory.
+*/
+static inline char*
+bench_read_pool(size_t read_len, const char *pattern, double rate) {
+    size_t i;
+    size_t pattern_len = strlen(pattern);
+    char *pool;
+
+    if ( (pool = malloc(BENCH_READ_POOL_SIZE * (read_len + 1))) == NULL )
+        return NULL;
+
+    for (i = 0; i < BENCH_READ_POOL_SIZE; i++) {
+        char *read = pool + i * (read_len + 1);
+        bench_random_bases(read, read_len);
+
+        if ( (double) (bench_random() % 1000000) / 1000000.0 < rate ) {
+            size_t offset = bench_random() % (read_len - pattern_len + 1);
+            memcpy(read + offset, pattern, pattern_len);
+        }
+    }
+
+    return pool;
+}
+
+static inline double
+bench_elapsed(const struct timespec *start, const struct timespec *end) {
+    return (double) (end->tv_sec - start->tv_sec) +
+           (double) (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+#endif /* _BENCH_UTIL_H_ */
@@ -0,0 +1,237 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* compilation line:
+   make bm-bench
+
+   A small benchmark of the exact match kernels:
+
+     boyermoore_search  -- the original per-call Boyer-Moore (which
+                           rebuilds its heuristic tables for every read)
+     bm-tables          -- the precompiled 'bm_searcher' tables alone
+     sse2 / avx2        -- the vectorized kernels (where supported)
+
+   A deterministic set of synthetic reads is generated in memory (the
+   pattern is planted into a fraction of them) and each kernel is run
+   over the same stream of reads.  The hit counts of every kernel are
+   checked against each other, and the reads/second of each kernel is
+   reported, for the '-p' pattern and '-l' reads, or ('-g') over a grid
+   of random patterns of 8 - 64 bases and reads of 100 - 300bp.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "bm.h"
+#include "simd.h"
+#include "bench-util.h"
+
+/* D E F I N E S *************************************************************/
+#define PRG_NAME "bm-bench"
+#define NUM_KERNELS 4
+
+/* P R O T O T Y P E S *******************************************************/
+void help_message(void);
+void time_kernels(const char *pattern,
+                  size_t read_len,
+                  size_t num_reads,
+                  double rate,
+                  double reads_per_second[NUM_KERNELS],
+                  size_t hits[NUM_KERNELS]);
+
+/* G L O B A L S *************************************************************/
+static const char *kernel_names[NUM_KERNELS] = {
+    "boyermoore_search", "bm-tables", "sse2", "avx2"
+};
+static simd_search_fn kernels[NUM_KERNELS] = { NULL, NULL, NULL, NULL };
+
+/* M A I N *******************************************************************/
+int main(int argc, char *argv[]) {
+    static const size_t pattern_lens[] = { 8, 12, 16, 24, 32, 48, 64 };
+    static const size_t read_lens[] = { 100, 150, 200, 300 };
+    int c, k, grid = 0;
+    size_t p, r;
+    size_t num_reads = 10000000;
+    size_t read_len  = 150;
+    double rate      = 0.1;
+    const char *pattern = "AGATCGGAAGAGC";
+    double reads_per_second[NUM_KERNELS];
+    size_t hits[NUM_KERNELS];
+    char random_pattern[65];
+
+    while( (c = getopt(argc, argv, "hn:l:p:r:g")) != -1 ) {
+        switch(c) {
+            case 'h':
+                help_message();
+                exit(0);
+            case 'n':
+                num_reads = strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                read_len = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                pattern = optarg;
+                break;
+            case 'r':
+                rate = atof(optarg);
+                break;
+            case 'g':
+                grid = 1;
+                break;
+            default:
+                exit(1);
+        }
+    }
+
+    if (!grid && read_len < strlen(pattern)) {
+        fprintf(stderr, "%s : [err] read length shorter than pattern!\n",
+                        PRG_NAME);
+        exit(1);
+    }
+
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        kernels[2] = simd_search_sse2;
+    if (__builtin_cpu_supports("avx2"))
+        kernels[3] = simd_search_avx2;
+#endif
+    fprintf(stdout, "selected kernel: %s\n\n",
+                    simd_search_name(simd_search_select()));
+
+    if (!grid) {
+        time_kernels(pattern, read_len, num_reads, rate,
+                     reads_per_second, hits);
+        for (k = 0; k < NUM_KERNELS; k++) {
+            if (reads_per_second[k] <= 0)
+                continue;
+            fprintf(stdout, "%-24s : %12.0f reads/s (%.2fx)\n",
+                            kernel_names[k], reads_per_second[k],
+                            reads_per_second[k] / reads_per_second[0]);
+        }
+        return 0;
+    }
+
+    fprintf(stdout, "%8s %8s", "pattern", "read");
+    for (k = 0; k < NUM_KERNELS; k++)
+        fprintf(stdout, " %18s", kernel_names[k]);
+    fprintf(stdout, "    (M reads/s)\n");
+
+    for (p = 0; p < sizeof(pattern_lens) / sizeof(pattern_lens[0]); p++) {
+        for (r = 0; r < sizeof(read_lens) / sizeof(read_lens[0]); r++) {
+            bench_random_bases(random_pattern, pattern_lens[p]);
+            time_kernels(random_pattern, read_lens[r], num_reads, rate,
+                         reads_per_second, hits);
+
+            fprintf(stdout, "%8zu %8zu", pattern_lens[p], read_lens[r]);
+            for (k = 0; k < NUM_KERNELS; k++) {
+                if (reads_per_second[k] <= 0)
+                    fprintf(stdout, " %18s", "-");
+                else
+                    fprintf(stdout, " %18.2f", reads_per_second[k] / 1e6);
+            }
+            fprintf(stdout, "\n");
+        }
+    }
+
+    return 0;
+}
+
+/* F U N C T I O N S *********************************************************/
+void
+help_message() {
+    fprintf(stdout, "Usage: %s %s\n", PRG_NAME, "[options]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-h", "This help message");
+    fprintf(stdout, "\t%-20s%-20s\n", "-n <INT>", "Number of reads to search per test [Default: 10000000]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-l <INT>", "Read length [Default: 150]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-p <STRING>", "Search pattern [Default: AGATCGGAAGAGC]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-r <FLOAT>", "Fraction of reads with the pattern planted [Default: 0.1]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-g", "Time random patterns of 8 - 64 bases over reads");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "of 100 - 300bp instead of '-p' and '-l'");
+}
+
+/*
+   Time every kernel over the same 'num_reads' reads; a kernel the CPU
+   lacks gets 0 reads/second.  Exits if the kernels disagree.
+*/
+void
+time_kernels(const char *pattern,
+             size_t read_len,
+             size_t num_reads,
+             double rate,
+             double reads_per_second[NUM_KERNELS],
+             size_t hits[NUM_KERNELS]) {
+    size_t pattern_len = strlen(pattern);
+    struct timespec t0, t1;
+    bm_searcher *searcher;
+    char *pool;
+    size_t i;
+    int k;
+
+    pool     = bench_read_pool(read_len, pattern, rate);
+    searcher = bm_searcher_create(pattern, pattern_len);
+    if (pool == NULL || searcher == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(1);
+    }
+    /* the tables alone */
+    searcher->simd = NULL;
+
+    for (k = 0; k < NUM_KERNELS; k++) {
+        hits[k] = 0;
+        reads_per_second[k] = 0;
+        if (k >= 2 && kernels[k] == NULL)
+            continue;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < num_reads; i++) {
+            const char *read =
+                pool + (i % BENCH_READ_POOL_SIZE) * (read_len + 1);
+            const char *found;
+            if (k == 0)
+                found = boyermoore_search(read, pattern);
+            else if (k == 1)
+                found = bm_searcher_search(searcher, read, read_len);
+            else
+                found = kernels[k](read, read_len, pattern, pattern_len);
+            if (found != NULL)
+                hits[k] += (size_t) (found - read) + 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        reads_per_second[k] = num_reads / bench_elapsed(&t0, &t1);
+
+        /* every kernel must find the same (leftmost) matches */
+        if (hits[k] != hits[0]) {
+            fprintf(stderr, "%s : [err] %s disagrees with %s!\n",
+                            PRG_NAME, kernel_names[k], kernel_names[0]);
+            exit(1);
+        }
+    }
+
+    bm_searcher_destroy(searcher);
+    free(pool);
+}
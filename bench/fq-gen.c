@@ -0,0 +1,213 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* compilation line:
+   make bench/fq-gen
+
+   A deterministic synthetic FASTQ/FASTA generator for benchmarking.
+
+   Reads of random ACGT bases (with Phred+33 qualities) are written out;
+   a fraction of them ('-r') carry a copy of the pattern at a random
+   offset.  Each base of a read, planted pattern included, is turned into
+   a different base with the '-e' probability, and given a low quality
+   score when it is, so the planted copies are only found approximately
+   at higher error rates.
+
+   The same seed ('-s') and options always produce the same file, which
+   is written as plain text, or gzip compressed with '-z'.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "bench-util.h"
+
+/* D E F I N E S *************************************************************/
+#define PRG_NAME "fq-gen"
+#define DEFAULT_PATTERN "GATTACAGATTACA"
+
+/* P R O T O T Y P E S *******************************************************/
+void help_message(void);
+void make_read(char *seq, char *qual, size_t len,
+               const char *pattern, size_t pattern_len,
+               double rate, double error_rate);
+
+/* M A I N *******************************************************************/
+int main(int argc, char *argv[]) {
+    int c;
+    size_t i;
+    size_t num_reads   = 1000000;
+    size_t read_len    = 150;
+    double rate        = 0.05;
+    double error_rate  = 0.0;
+    int fasta          = 0;
+    int gzip           = 0;
+    const char *pattern  = DEFAULT_PATTERN;
+    const char *out_file = NULL;
+    size_t pattern_len;
+    char *seq, *qual;
+    gzFile out;
+
+    while( (c = getopt(argc, argv, "hn:l:r:e:p:s:fzo:")) != -1 ) {
+        switch(c) {
+            case 'h':
+                help_message();
+                exit(0);
+            case 'n':
+                num_reads = strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                read_len = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                rate = atof(optarg);
+                break;
+            case 'e':
+                error_rate = atof(optarg);
+                break;
+            case 'p':
+                pattern = optarg;
+                break;
+            case 's':
+                bench_seed(strtoull(optarg, NULL, 10));
+                break;
+            case 'f':
+                fasta = 1;
+                break;
+            case 'z':
+                gzip = 1;
+                break;
+            case 'o':
+                out_file = optarg;
+                break;
+            default:
+                exit(1);
+        }
+    }
+
+    pattern_len = strlen(pattern);
+    if (read_len == 0 || pattern_len > read_len) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] The read length has to be at least the "
+                        "pattern length!");
+        exit(1);
+    }
+
+    /* "T" writes plain text through the same interface */
+    if (out_file == NULL)
+        out = gzdopen(fileno(stdout), gzip ? "wb6" : "wbT");
+    else
+        out = gzopen(out_file, gzip ? "wb6" : "wbT");
+
+    if (out == NULL) {
+        fprintf(stderr, "%s : [err] Could not open '%s' for writing!\n",
+                        PRG_NAME, out_file ? out_file : "stdout");
+        exit(1);
+    }
+
+    if ( (seq = malloc(read_len + 1)) == NULL ||
+         (qual = malloc(read_len + 1)) == NULL ) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(1);
+    }
+
+    for (i = 0; i < num_reads; i++) {
+        make_read(seq, qual, read_len, pattern, pattern_len, rate, error_rate);
+
+        if (fasta) {
+            gzprintf(out, ">read%zu\n", i);
+            gzwrite(out, seq, (unsigned) read_len);
+            gzputc(out, '\n');
+        }
+        else {
+            gzprintf(out, "@read%zu\n", i);
+            gzwrite(out, seq, (unsigned) read_len);
+            gzputs(out, "\n+\n");
+            gzwrite(out, qual, (unsigned) read_len);
+            gzputc(out, '\n');
+        }
+    }
+
+    free(seq);
+    free(qual);
+
+    if (gzclose(out) != Z_OK) {
+        fprintf(stderr, "%s : [err] Trouble writing '%s'!\n",
+                        PRG_NAME, out_file ? out_file : "stdout");
+        exit(1);
+    }
+
+    return 0;
+}
+
+/* F U N C T I O N S *********************************************************/
+void
+help_message() {
+    fprintf(stdout, "Usage: %s %s\n", PRG_NAME, "[options]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-h", "This help message");
+    fprintf(stdout, "\t%-20s%-20s\n", "-n <INT>", "Number of reads [Default: 1000000]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-l <INT>", "Read length [Default: 150]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-p <STRING>", "Pattern to plant [Default: " DEFAULT_PATTERN "]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-r <FLOAT>", "Fraction of reads with the pattern planted");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "[Default: 0.05]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-e <FLOAT>", "Per base substitution error rate [Default: 0]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-s <INT>", "Random seed [Default: 0]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-f", "Write FASTA instead of FASTQ");
+    fprintf(stdout, "\t%-20s%-20s\n", "-z", "Gzip compress the output");
+    fprintf(stdout, "\t%-20s%-20s\n", "-o <out_file>", "Output file [Default: stdout]");
+}
+
+void
+make_read(char *seq, char *qual, size_t len,
+          const char *pattern, size_t pattern_len,
+          double rate, double error_rate) {
+    static const char bases[] = "ACGT";
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        seq[i]  = bases[bench_random() & 3];
+        qual[i] = (char) (33 + 20 + bench_random() % 21);
+    }
+
+    if (bench_fraction() < rate) {
+        size_t offset = bench_random() % (len - pattern_len + 1);
+        memcpy(seq + offset, pattern, pattern_len);
+    }
+
+    if (error_rate > 0) {
+        for (i = 0; i < len; i++) {
+            if (bench_fraction() < error_rate) {
+                /* any of the three other bases */
+                const char *b = strchr(bases, seq[i]);
+                size_t k = b ? (size_t) (b - bases) : 0;
+                seq[i]  = bases[(k + 1 + bench_random() % 3) & 3];
+                qual[i] = (char) (33 + 2 + bench_random() % 10);
+            }
+        }
+    }
+
+    seq[len]  = '\0';
+    qual[len] = '\0';
+}
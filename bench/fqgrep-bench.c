@@ -0,0 +1,263 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* compilation line:
+   make bench/fqgrep-bench
+
+   The 'make bench' driver: times a fqgrep executable over an input file
+   in each of its main modes
+
+     exact    -- '-p' (Boyer-Moore/SIMD)
+     tre      -- '-e -m <mismatches>' (the TRE approximate regexp search)
+     invert   -- '-v'
+     count    -- '-C'
+     color    -- '-c'
+     report   -- '-r'
+
+   Every mode is run '-k' times (fqgrep's output goes to /dev/null) and
+   the fastest run is kept.  One tab separated line is printed per mode:
+
+     mode  seconds  reads  reads/s  MB/s  peak RSS (KB)  exit status
+
+   'reads' and the MB of 'MB/s' are of the (decompressed) input, which is
+   read once up front to count them.  The peak RSS is the child's
+   'ru_maxrss', taken from 'wait4'.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <zlib.h>
+#include "bench-util.h"
+
+/* D E F I N E S *************************************************************/
+#define PRG_NAME "fqgrep-bench"
+#define MAX_ARGS 32
+#define READ_BUFFER_SIZE (1 << 20)
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    double seconds;
+    long   max_rss;               /* kilobytes */
+    int    status;
+} run_result;
+
+/* P R O T O T Y P E S *******************************************************/
+void   help_message(void);
+void   count_input(const char *file, size_t *reads, size_t *bytes);
+void   run_fqgrep(char *const args[], run_result *result);
+
+/* M A I N *******************************************************************/
+int main(int argc, char *argv[]) {
+    static const char *mode_names[] = {
+        "exact", "tre", "invert", "count", "color", "report"
+    };
+    static const char *mode_flags[] = {
+        NULL, "-e", "-v", "-C", "-c", "-r"
+    };
+    int c, k;
+    size_t m;
+    const char *fqgrep  = "./fqgrep";
+    const char *pattern = "GATTACAGATTACA";
+    const char *input   = NULL;
+    const char *threads = "1";
+    const char *mismatches = "2";
+    int repeats = 3;
+    size_t reads, bytes;
+
+    while( (c = getopt(argc, argv, "hx:p:m:t:k:")) != -1 ) {
+        switch(c) {
+            case 'h':
+                help_message();
+                exit(0);
+            case 'x':
+                fqgrep = optarg;
+                break;
+            case 'p':
+                pattern = optarg;
+                break;
+            case 'm':
+                mismatches = optarg;
+                break;
+            case 't':
+                threads = optarg;
+                break;
+            case 'k':
+                repeats = atoi(optarg);
+                break;
+            default:
+                exit(1);
+        }
+    }
+
+    if (optind != argc - 1 || repeats < 1) {
+        help_message();
+        exit(1);
+    }
+    input = argv[optind];
+
+    count_input(input, &reads, &bytes);
+
+    fprintf(stdout, "mode\tseconds\treads\treads_per_s\tmb_per_s\t"
+                    "peak_rss_kb\tstatus\n");
+
+    for (m = 0; m < sizeof(mode_names) / sizeof(mode_names[0]); m++) {
+        char *args[MAX_ARGS];
+        int n = 0;
+        run_result best = { 0.0, 0, 0 };
+
+        args[n++] = (char *) fqgrep;
+        args[n++] = "-t";
+        args[n++] = (char *) threads;
+        if (mode_flags[m] != NULL)
+            args[n++] = (char *) mode_flags[m];
+        if (strcmp(mode_names[m], "tre") == 0) {
+            args[n++] = "-m";
+            args[n++] = (char *) mismatches;
+        }
+        args[n++] = "-p";
+        args[n++] = (char *) pattern;
+        args[n++] = (char *) input;
+        args[n]   = NULL;
+
+        for (k = 0; k < repeats; k++) {
+            run_result result;
+            run_fqgrep(args, &result);
+            if (k == 0 || result.seconds < best.seconds)
+                best.seconds = result.seconds;
+            if (result.max_rss > best.max_rss)
+                best.max_rss = result.max_rss;
+            if (result.status != 0)
+                best.status = result.status;
+        }
+
+        fprintf(stdout, "%s\t%.3f\t%zu\t%.0f\t%.2f\t%ld\t%d\n",
+                        mode_names[m],
+                        best.seconds,
+                        reads,
+                        reads / best.seconds,
+                        bytes / best.seconds / 1e6,
+                        best.max_rss,
+                        best.status);
+        fflush(stdout);
+    }
+
+    return 0;
+}
+
+/* F U N C T I O N S *********************************************************/
+void
+help_message() {
+    fprintf(stdout, "Usage: %s %s\n", PRG_NAME, "[options] <fastq_or_fasta_file>");
+    fprintf(stdout, "\t%-20s%-20s\n", "-h", "This help message");
+    fprintf(stdout, "\t%-20s%-20s\n", "-x <FILE>", "The fqgrep executable [Default: ./fqgrep]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-p <STRING>", "Pattern to search for [Default: GATTACAGATTACA]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-m <INT>", "Mismatches of the 'tre' mode [Default: 2]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-t <INT>", "Threads to search with [Default: 1]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-k <INT>", "Runs per mode, the fastest is kept [Default: 3]");
+}
+
+/*
+   Count the records (FASTA '>' lines, or FASTQ lines / 4) and the bytes
+   of the decompressed input.  This also pulls the file into the page
+   cache, so the first timed run is not penalized for it.
+*/
+void
+count_input(const char *file, size_t *reads, size_t *bytes) {
+    gzFile in;
+    char *buf;
+    int len, fasta = -1, line_start = 1;
+    size_t lines = 0, headers = 0;
+
+    if ( (in = gzopen(file, "rb")) == NULL ) {
+        fprintf(stderr, "%s : [err] Could not open '%s' for reading!\n",
+                        PRG_NAME, file);
+        exit(1);
+    }
+
+    if ( (buf = malloc(READ_BUFFER_SIZE)) == NULL ) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(1);
+    }
+
+    *bytes = 0;
+    while ( (len = gzread(in, buf, READ_BUFFER_SIZE)) > 0 ) {
+        int i;
+        if (fasta < 0)
+            fasta = buf[0] == '>';
+        for (i = 0; i < len; i++) {
+            if (line_start && buf[i] == '>')
+                headers++;
+            line_start = buf[i] == '\n';
+            lines += line_start;
+        }
+        *bytes += (size_t) len;
+    }
+
+    free(buf);
+    gzclose(in);
+
+    *reads = fasta > 0 ? headers : lines / 4;
+}
+
+void
+run_fqgrep(char *const args[], run_result *result) {
+    struct timespec t0, t1;
+    struct rusage usage;
+    pid_t pid;
+    int status;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    if ( (pid = fork()) < 0 ) {
+        fprintf(stderr, "%s : [err] Could not fork!\n", PRG_NAME);
+        exit(1);
+    }
+
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0)
+            dup2(null_fd, STDOUT_FILENO);
+        execv(args[0], args);
+        fprintf(stderr, "%s : [err] Could not run '%s'!\n", PRG_NAME, args[0]);
+        _exit(127);
+    }
+
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        fprintf(stderr, "%s : [err] Lost track of '%s'!\n", PRG_NAME, args[0]);
+        exit(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    result->seconds = bench_elapsed(&t0, &t1);
+    result->max_rss = usage.ru_maxrss;
+    result->status  = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
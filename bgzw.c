@@ -0,0 +1,446 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Parallel BGZF compression of output streams
+
+   See bgzw.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "bgzw.h"
+
+/* D E F I N E S *************************************************************/
+/* job states */
+#define BGZW_JOB_EMPTY       0    /* free for the caller */
+#define BGZW_JOB_FILLED      1    /* holds input waiting for a worker */
+#define BGZW_JOB_COMPRESSING 2
+#define BGZW_JOB_DONE        3    /* holds blocks waiting for the writer */
+
+#define BGZW_HEADER_SIZE 18
+#define BGZW_FOOTER_SIZE 8
+
+/* P R O T O T Y P E S *******************************************************/
+static int   bgzw_write_fd(int fd, const unsigned char *data, size_t len);
+static void  bgzw_put_u16(unsigned char *p, unsigned int v);
+static void  bgzw_put_u32(unsigned char *p, unsigned long v);
+static size_t bgzw_compress_block(z_stream *zs,
+                                  const unsigned char *in,
+                                  size_t in_len,
+                                  unsigned char *out);
+static void  bgzw_compress_job(z_stream *zs, bgzw_job *job);
+static int   bgzw_submit(bgzw_writer *writer);
+static int   bgzw_error(bgzw_writer *writer);
+static void* bgzw_writer_thread(void *arg);
+static void* bgzw_worker_thread(void *arg);
+
+/* the empty block 'bgzip' ends its files with */
+static const unsigned char bgzw_eof_block[28] = {
+    0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+    0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00
+};
+
+/* F U N C T I O N S *********************************************************/
+
+/*
+   Start compressing to 'fd' at 'level' (1 to 9) with 'num_workers'
+   threads, or in the caller if that is 0.  Returns NULL if out of memory
+   or if the threads could not be started.
+*/
+bgzw_writer*
+bgzw_open(int fd, int level, int num_workers) {
+    bgzw_writer *writer;
+    size_t i;
+    int j;
+
+    if (num_workers < 0)
+        num_workers = 0;
+
+    if ( (writer = calloc(1, sizeof(bgzw_writer))) == NULL )
+        return NULL;
+
+    writer->fd    = fd;
+    writer->level = level;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+
+    writer->num_jobs = num_workers ? 2 * (size_t) num_workers + 2 : 1;
+    writer->job_size = num_workers ? BGZW_JOB_SIZE : BGZW_BLOCK_SIZE;
+    writer->jobs     = calloc(writer->num_jobs, sizeof(bgzw_job));
+    writer->workers  = calloc((size_t) num_workers + 1, sizeof(pthread_t));
+    if (writer->jobs == NULL || writer->workers == NULL)
+        goto fail;
+
+    for (i = 0; i < writer->num_jobs; i++) {
+        bgzw_job *job = &writer->jobs[i];
+        job->in  = malloc(writer->job_size);
+        job->out = malloc(writer->job_size / BGZW_BLOCK_SIZE *
+                          BGZW_MAX_BLOCK_SIZE);
+        if (job->in == NULL || job->out == NULL)
+            goto fail;
+    }
+
+    if (num_workers == 0) {
+        if (deflateInit2(&writer->zs, level, Z_DEFLATED, -15, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK)
+            goto fail;
+        return writer;
+    }
+
+    if (pthread_create(&writer->writer, NULL,
+                       bgzw_writer_thread, writer) != 0)
+        goto fail;
+
+    for (j = 0; j < num_workers; j++) {
+        if (pthread_create(&writer->workers[j], NULL,
+                           bgzw_worker_thread, writer) != 0) {
+            /* let the writer and the started workers wind down */
+            writer->num_workers = j;
+            writer->error = ENOMEM;
+            bgzw_close(writer);
+            return NULL;
+        }
+        writer->num_workers = j + 1;
+    }
+
+    return writer;
+
+fail:
+    if (writer->jobs != NULL) {
+        for (i = 0; i < writer->num_jobs; i++) {
+            free(writer->jobs[i].in);
+            free(writer->jobs[i].out);
+        }
+    }
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->cond);
+    free(writer->jobs);
+    free(writer->workers);
+    free(writer);
+    return NULL;
+}
+
+/*
+   Queue 'len' bytes for compression.  Returns 0, or the errno of a
+   failed write.
+*/
+int
+bgzw_write(bgzw_writer *writer, const char *data, size_t len) {
+    int error;
+
+    /* after a failed write, the jobs may still be in the threads' hands */
+    if ( (error = bgzw_error(writer)) != 0 )
+        return error;
+
+    while (len > 0) {
+        bgzw_job *job = &writer->jobs[writer->next_fill % writer->num_jobs];
+        size_t n = writer->job_size - job->in_len;
+
+        if (n > len)
+            n = len;
+        memcpy(job->in + job->in_len, data, n);
+        job->in_len += n;
+        data += n;
+        len  -= n;
+
+        if (job->in_len == writer->job_size &&
+            (error = bgzw_submit(writer)) != 0)
+            break;
+    }
+
+    return error;
+}
+
+/*
+   Compress and write out anything still queued, end the file with the
+   BGZF end of file block and free the writer (the file descriptor is left
+   open).  Returns 0, or the errno of a failed write.
+*/
+int
+bgzw_close(bgzw_writer *writer) {
+    size_t i;
+    int j, ret;
+
+    if (writer == NULL)
+        return 0;
+
+    if (bgzw_error(writer) == 0 &&
+        writer->jobs[writer->next_fill % writer->num_jobs].in_len > 0)
+        bgzw_submit(writer);
+
+    if (writer->num_workers == 0) {
+        if (writer->error == 0)
+            writer->error = bgzw_write_fd(writer->fd, bgzw_eof_block,
+                                          sizeof(bgzw_eof_block));
+        deflateEnd(&writer->zs);
+    }
+    else {
+        pthread_mutex_lock(&writer->lock);
+        writer->closing = 1;
+        pthread_cond_broadcast(&writer->cond);
+        pthread_mutex_unlock(&writer->lock);
+
+        for (j = 0; j < writer->num_workers; j++)
+            pthread_join(writer->workers[j], NULL);
+        pthread_join(writer->writer, NULL);
+    }
+
+    for (i = 0; i < writer->num_jobs; i++) {
+        free(writer->jobs[i].in);
+        free(writer->jobs[i].out);
+    }
+
+    ret = writer->error;
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->cond);
+    free(writer->jobs);
+    free(writer->workers);
+    free(writer);
+    return ret;
+}
+
+/* returns 0, or the errno of the failed write */
+static int
+bgzw_write_fd(int fd, const unsigned char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno != EINTR)
+                return errno;
+            continue;
+        }
+        data += n;
+        len  -= (size_t) n;
+    }
+    return 0;
+}
+
+static void
+bgzw_put_u16(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char) (v & 0xff);
+    p[1] = (unsigned char) ((v >> 8) & 0xff);
+}
+
+static void
+bgzw_put_u32(unsigned char *p, unsigned long v) {
+    bgzw_put_u16(p, (unsigned int) (v & 0xffff));
+    bgzw_put_u16(p + 2, (unsigned int) ((v >> 16) & 0xffff));
+}
+
+/*
+   Compress up to BGZW_BLOCK_SIZE bytes into one BGZF block at 'out'.
+   Input that deflate cannot fit into a block is stored instead.  Returns
+   the size of the block.
+*/
+static size_t
+bgzw_compress_block(z_stream *zs,
+                    const unsigned char *in,
+                    size_t in_len,
+                    unsigned char *out) {
+    static const unsigned char header[12] = {
+        0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00
+    };
+    unsigned char *data = out + BGZW_HEADER_SIZE;
+    size_t data_len, block_len;
+
+    deflateReset(zs);
+    zs->next_in   = (Bytef *) in;
+    zs->avail_in  = (uInt) in_len;
+    zs->next_out  = data;
+    zs->avail_out = BGZW_MAX_BLOCK_SIZE - BGZW_HEADER_SIZE - BGZW_FOOTER_SIZE;
+
+    if (deflate(zs, Z_FINISH) == Z_STREAM_END) {
+        data_len = zs->total_out;
+    }
+    else {
+        /* a single final stored block: BFINAL, LEN and NLEN, the data */
+        data[0] = 0x01;
+        bgzw_put_u16(data + 1, (unsigned int) in_len);
+        bgzw_put_u16(data + 3, (unsigned int) ~in_len & 0xffff);
+        memcpy(data + 5, in, in_len);
+        data_len = in_len + 5;
+    }
+
+    block_len = BGZW_HEADER_SIZE + data_len + BGZW_FOOTER_SIZE;
+
+    /* the gzip header, with the 'BC' extra field holding the block size */
+    memcpy(out, header, sizeof(header));
+    out[12] = 'B';
+    out[13] = 'C';
+    bgzw_put_u16(out + 14, 2);
+    bgzw_put_u16(out + 16, (unsigned int) (block_len - 1));
+
+    bgzw_put_u32(data + data_len, crc32(crc32(0L, Z_NULL, 0), in, (uInt) in_len));
+    bgzw_put_u32(data + data_len + 4, (unsigned long) in_len);
+
+    return block_len;
+}
+
+static void
+bgzw_compress_job(z_stream *zs, bgzw_job *job) {
+    size_t pos;
+
+    job->out_len = 0;
+    for (pos = 0; pos < job->in_len; pos += BGZW_BLOCK_SIZE) {
+        size_t n = job->in_len - pos;
+        if (n > BGZW_BLOCK_SIZE)
+            n = BGZW_BLOCK_SIZE;
+        job->out_len += bgzw_compress_block(zs, job->in + pos, n,
+                                            job->out + job->out_len);
+    }
+}
+
+/*
+   Hand the job being filled on, and wait for the next one to be free.
+   Returns 0, or the errno of a failed write.
+*/
+static int
+bgzw_submit(bgzw_writer *writer) {
+    bgzw_job *job = &writer->jobs[writer->next_fill % writer->num_jobs];
+    int error;
+
+    if (writer->num_workers == 0) {
+        bgzw_compress_job(&writer->zs, job);
+        job->in_len = 0;
+        if (writer->error == 0)
+            writer->error = bgzw_write_fd(writer->fd, job->out, job->out_len);
+        return writer->error;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    job->state = BGZW_JOB_FILLED;
+    writer->next_fill++;
+    pthread_cond_broadcast(&writer->cond);
+
+    job = &writer->jobs[writer->next_fill % writer->num_jobs];
+    while (job->state != BGZW_JOB_EMPTY && writer->error == 0)
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    error = writer->error;
+    pthread_mutex_unlock(&writer->lock);
+
+    if (error == 0)
+        job->in_len = 0;
+    return error;
+}
+
+static int
+bgzw_error(bgzw_writer *writer) {
+    int error;
+
+    pthread_mutex_lock(&writer->lock);
+    error = writer->error;
+    pthread_mutex_unlock(&writer->lock);
+    return error;
+}
+
+static void*
+bgzw_writer_thread(void *arg) {
+    bgzw_writer *writer = arg;
+
+    for (;;) {
+        bgzw_job *job = &writer->jobs[writer->next_write % writer->num_jobs];
+        int error;
+
+        pthread_mutex_lock(&writer->lock);
+        while ( job->state != BGZW_JOB_DONE && writer->error == 0 &&
+                !(writer->closing && writer->next_write == writer->next_fill) )
+            pthread_cond_wait(&writer->cond, &writer->lock);
+
+        if (job->state != BGZW_JOB_DONE || writer->error != 0) {
+            pthread_mutex_unlock(&writer->lock);
+            break;
+        }
+        pthread_mutex_unlock(&writer->lock);
+
+        error = bgzw_write_fd(writer->fd, job->out, job->out_len);
+
+        pthread_mutex_lock(&writer->lock);
+        if (error)
+            writer->error = error;
+        job->state = BGZW_JOB_EMPTY;
+        writer->next_write++;
+        pthread_cond_broadcast(&writer->cond);
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    if (bgzw_error(writer) == 0) {
+        int error = bgzw_write_fd(writer->fd, bgzw_eof_block,
+                                  sizeof(bgzw_eof_block));
+        pthread_mutex_lock(&writer->lock);
+        if (writer->error == 0)
+            writer->error = error;
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    return NULL;
+}
+
+static void*
+bgzw_worker_thread(void *arg) {
+    bgzw_writer *writer = arg;
+    z_stream zs;
+    int ok;
+
+    memset(&zs, 0, sizeof(z_stream));
+    ok = deflateInit2(&zs, writer->level, Z_DEFLATED, -15, 8,
+                      Z_DEFAULT_STRATEGY) == Z_OK;
+
+    for (;;) {
+        bgzw_job *job;
+
+        pthread_mutex_lock(&writer->lock);
+        if (!ok && writer->error == 0) {
+            writer->error = ENOMEM;
+            pthread_cond_broadcast(&writer->cond);
+        }
+        for (;;) {
+            job = &writer->jobs[writer->next_compress % writer->num_jobs];
+            if (writer->error != 0 || job->state == BGZW_JOB_FILLED ||
+                (writer->closing && writer->next_compress == writer->next_fill))
+                break;
+            pthread_cond_wait(&writer->cond, &writer->lock);
+        }
+
+        if (writer->error != 0 || job->state != BGZW_JOB_FILLED) {
+            pthread_mutex_unlock(&writer->lock);
+            break;
+        }
+
+        job->state = BGZW_JOB_COMPRESSING;
+        writer->next_compress++;
+        pthread_mutex_unlock(&writer->lock);
+
+        bgzw_compress_job(&zs, job);
+
+        pthread_mutex_lock(&writer->lock);
+        job->state = BGZW_JOB_DONE;
+        pthread_cond_broadcast(&writer->cond);
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    if (ok)
+        deflateEnd(&zs);
+    return NULL;
+}
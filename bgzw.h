@@ -0,0 +1,104 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Parallel BGZF compression of output streams
+
+   The counterpart of pgz for the output: data written to a 'bgzw_writer'
+   is cut into BGZF blocks (gzip members of at most 64KB, as written by
+   'bgzip'), which a pool of worker threads deflate, and a writer thread
+   writes them out strictly in order.  The result is a valid (multi
+   member) gzip file, which pgz can read back in parallel.
+
+   The blocks travel in jobs of BGZW_BLOCKS_PER_JOB blocks through a ring
+   of 'num_jobs' slots: the caller fills a job, a worker compresses it,
+   and the writer writes it and hands the slot back.  The caller only
+   waits when every slot is in use, i.e. when the compression or the
+   disk cannot keep up.
+
+   With no workers, the blocks are compressed and written by the caller
+   itself, a single block at a time, which is cheaper for the many small
+   outputs of '--demux': each then only holds a block of input and one of
+   output.
+
+   A failed write is remembered, and its errno returned by any later
+   'bgzw_write' and by 'bgzw_close'.
+*/
+
+#ifndef _BGZW_H_
+#define _BGZW_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <pthread.h>
+#include <zlib.h>
+
+/* D E F I N E S *************************************************************/
+#define BGZW_BLOCK_SIZE 0xff00            /* input bytes per BGZF block */
+#define BGZW_MAX_BLOCK_SIZE 65536         /* compressed bytes per block */
+#define BGZW_BLOCKS_PER_JOB 16
+#define BGZW_JOB_SIZE (BGZW_BLOCK_SIZE * BGZW_BLOCKS_PER_JOB)
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    int           state;
+    unsigned char *in;
+    size_t        in_len;
+    unsigned char *out;               /* the job's BGZF blocks */
+    size_t        out_len;
+} bgzw_job;
+
+typedef struct {
+    int             fd;
+    int             level;
+    int             error;            /* errno of a failed write (or 0) */
+    int             closing;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       writer;
+    pthread_t       *workers;
+    int             num_workers;
+
+    bgzw_job        *jobs;
+    size_t          num_jobs;
+    size_t          job_size;         /* input bytes per job */
+    size_t          next_fill;        /* job being filled by the caller */
+    size_t          next_compress;    /* next job for a worker */
+    size_t          next_write;       /* next job for the writer */
+
+    z_stream        zs;               /* the caller's, without workers */
+} bgzw_writer;
+
+/* P R O T O T Y P E S *******************************************************/
+bgzw_writer* bgzw_open(int fd, int level, int num_workers);
+int bgzw_write(bgzw_writer *writer, const char *data, size_t len);
+int bgzw_close(bgzw_writer *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BGZW_H */
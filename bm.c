@@ -47,7 +47,7 @@ prepare_badcharacter_heuristic(const char *str,
         result[i] = -1;
 
     for (i = 0; i < size; i++)
-        result[(size_t) str[i]] = i;
+        result[(unsigned char) str[i]] = i;
 }
  
 void prepare_goodsuffix_heuristic(const char *normal, 
@@ -121,7 +121,7 @@ boyermoore_search(const char *haystack, const char *needle) {
 
         if(j > 0)
         {
-            int k = badcharacter[(size_t) haystack[s+j-1]];
+            int k = badcharacter[(unsigned char) haystack[s+j-1]];
             int m;
             if(k < (int)j && (m = j-k-1) > goodsuffix[j])
                 s+= m;
@@ -137,3 +137,137 @@ boyermoore_search(const char *haystack, const char *needle) {
     /* not found */
     return NULL;
 }
+
+bm_searcher*
+bm_searcher_create(const char *needle, size_t needle_len) {
+    bm_searcher *searcher;
+
+    if ( (searcher = calloc(1, sizeof(bm_searcher))) == NULL )
+        return NULL;
+
+    searcher->needle     = malloc(needle_len + 1);
+    searcher->goodsuffix = malloc((needle_len + 1) * sizeof(int));
+    if (searcher->needle == NULL || searcher->goodsuffix == NULL) {
+        bm_searcher_destroy(searcher);
+        return NULL;
+    }
+
+    memcpy(searcher->needle, needle, needle_len);
+    searcher->needle[needle_len] = '\0';
+    searcher->needle_len = needle_len;
+
+    /*
+    * Initialize heuristics (once per needle)
+    */
+    prepare_badcharacter_heuristic(needle, needle_len, searcher->badcharacter);
+    if (needle_len > 0)
+        prepare_goodsuffix_heuristic(needle, needle_len, searcher->goodsuffix);
+
+    searcher->simd      = simd_search_select();
+    searcher->simd_pair = simd_search_pair_select();
+
+    return searcher;
+}
+
+const char*
+bm_searcher_search(const bm_searcher *searcher,
+                   const char *haystack,
+                   size_t haystack_len) {
+    const char *needle = searcher->needle;
+    const size_t needle_len = searcher->needle_len;
+    const int *badcharacter = searcher->badcharacter;
+    const int *goodsuffix = searcher->goodsuffix;
+
+    /*
+    * Simple checks
+    */
+    if(haystack_len == 0)
+        return NULL;
+    if(needle_len == 0)
+        return haystack;
+    if(haystack_len < needle_len)
+        return NULL;
+
+    if (searcher->simd != NULL)
+        return searcher->simd(haystack, haystack_len, needle, needle_len);
+
+    /*
+    * Boyer-Moore search
+    */
+    size_t s = 0;
+    while(s <= (haystack_len - needle_len))
+    {
+        size_t j = needle_len;
+        while(j > 0 && needle[j-1] == haystack[s+j-1])
+            j--;
+
+        if(j > 0)
+        {
+            int k = badcharacter[(unsigned char) haystack[s+j-1]];
+            int m;
+            if(k < (int)j && (m = j-k-1) > goodsuffix[j])
+                s+= m;
+            else
+                s+= goodsuffix[j];
+        }
+        else
+        {
+            return haystack + s;
+        }
+    }
+
+    /* not found */
+    return NULL;
+}
+
+/*
+   Find the leftmost occurrence of either needle, setting 'which' to 0 or
+   1 for the needle found (the first needle wins a tie).  Needles of the
+   same length are searched for in a single vectorized pass if possible.
+*/
+const char*
+bm_searcher_search_either(const bm_searcher *first,
+                          const bm_searcher *second,
+                          const char *haystack,
+                          size_t haystack_len,
+                          int *which) {
+    const char *found, *other;
+
+    *which = 0;
+    if (haystack_len == 0)
+        return NULL;
+
+    if (first->simd_pair != NULL &&
+        first->needle_len == second->needle_len &&
+        first->needle_len > 0)
+        return first->simd_pair(haystack, haystack_len,
+                                first->needle, second->needle,
+                                first->needle_len, which);
+
+    /* otherwise the second needle only needs to be looked for up to where
+       the first one was found */
+    found = bm_searcher_search(first, haystack, haystack_len);
+    if (found != NULL) {
+        size_t limit = (size_t) (found - haystack) + second->needle_len;
+        if (limit > 0 && limit - 1 < haystack_len)
+            haystack_len = limit - 1;
+    }
+
+    other = bm_searcher_search(second, haystack, haystack_len);
+    if (other != NULL) {
+        *which = 1;
+        return other;
+    }
+
+    return found;
+}
+
+void
+bm_searcher_destroy(bm_searcher *searcher) {
+    if (searcher == NULL)
+        return;
+
+    free(searcher->needle);
+    free(searcher->goodsuffix);
+    free(searcher);
+}
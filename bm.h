@@ -26,10 +26,28 @@ extern "C" {
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include "simd.h"
 
 /* D E F I N E S *************************************************************/
 #define ALPHABET_SIZE ( 1 << CHAR_BIT)
 
+/* D A T A    S T R U C T U R E S ********************************************/
+/*
+   A precompiled Boyer-Moore searcher.  The bad-character and good-suffix
+   tables only depend upon the needle, so they are computed once by
+   'bm_searcher_create' and then reused for every haystack searched.
+   Where the CPU has one, a vectorized kernel (see simd.h) is used
+   instead of the tables.
+*/
+typedef struct {
+    char   *needle;
+    size_t needle_len;
+    int    badcharacter[ALPHABET_SIZE];
+    int    *goodsuffix;
+    simd_search_fn simd;          /* vectorized search (or NULL) */
+    simd_search_pair_fn simd_pair;
+} bm_searcher;
+
 /* P R O T O T Y P E S *******************************************************/
 void compute_prefix(const char* str, size_t size, int result[size]);
 void prepare_badcharacter_heuristic(const char *str, 
@@ -39,6 +57,16 @@ void prepare_goodsuffix_heuristic(const char *normal,
                                   size_t size, 
                                   int result[size + 1]);
 const char* boyermoore_search(const char *haystack, const char *needle);
+bm_searcher* bm_searcher_create(const char *needle, size_t needle_len);
+const char* bm_searcher_search(const bm_searcher *searcher,
+                               const char *haystack,
+                               size_t haystack_len);
+const char* bm_searcher_search_either(const bm_searcher *first,
+                                      const bm_searcher *second,
+                                      const char *haystack,
+                                      size_t haystack_len,
+                                      int *which);
+void bm_searcher_destroy(bm_searcher *searcher);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,312 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Barcode demultiplexing ('--demux')
+
+   See demux.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "demux.h"
+
+/* D E F I N E S *************************************************************/
+#define DEMUX_AMBIGUOUS -2
+#define DEMUX_NUM_CODES 5         /* A, C, G, T and anything else */
+
+/* P R O T O T Y P E S *******************************************************/
+static unsigned demux_code(char c);
+static size_t   demux_slot(const demux_table *table, uint64_t key);
+static void     demux_insert(demux_table *table,
+                             uint64_t key,
+                             int32_t sample,
+                             int distance);
+static void     demux_add_neighborhood(demux_table *table,
+                                       uint64_t key,
+                                       size_t from,
+                                       int32_t sample,
+                                       int distance);
+
+/* F U N C T I O N S *********************************************************/
+
+static unsigned
+demux_code(char c) {
+    switch (c) {
+        case 'A': case 'a': return 0;
+        case 'C': case 'c': return 1;
+        case 'G': case 'g': return 2;
+        case 'T': case 't': return 3;
+        default:            return 4;
+    }
+}
+
+/* the slot holding 'key', or the empty slot it would go into */
+static size_t
+demux_slot(const demux_table *table, uint64_t key) {
+    size_t i = (size_t) ((key * 0x9E3779B97F4A7C15ULL) >> 20) &
+               table->table_mask;
+
+    while (table->keys[i] != 0 && table->keys[i] != key + 1)
+        i = (i + 1) & table->table_mask;
+
+    return i;
+}
+
+/* a sequence goes to the closest barcode, or to none if there is a tie */
+static void
+demux_insert(demux_table *table, uint64_t key, int32_t sample, int distance) {
+    size_t i = demux_slot(table, key);
+
+    if (table->keys[i] == 0 || distance < table->distances[i]) {
+        table->keys[i]      = key + 1;
+        table->values[i]    = sample;
+        table->distances[i] = (uint8_t) distance;
+    }
+    else if (distance == table->distances[i] && table->values[i] != sample) {
+        table->values[i] = DEMUX_AMBIGUOUS;
+    }
+}
+
+/* the sequences with up to 'max_mismatches' substitutions at 'from' on */
+static void
+demux_add_neighborhood(demux_table *table,
+                       uint64_t key,
+                       size_t from,
+                       int32_t sample,
+                       int distance) {
+    size_t i;
+    uint64_t c;
+
+    demux_insert(table, key, sample, distance);
+    if (distance == table->max_mismatches)
+        return;
+
+    for (i = from; i < table->barcode_l; i++) {
+        uint64_t code = (key >> (3 * i)) & 7;
+        for (c = 0; c < DEMUX_NUM_CODES; c++) {
+            if (c == code)
+                continue;
+            demux_add_neighborhood(table,
+                                   (key & ~(7ULL << (3 * i))) | (c << (3 * i)),
+                                   i + 1, sample, distance + 1);
+        }
+    }
+}
+
+/*
+   Build the lookup table of the barcodes, which must be distinct, of the
+   same length (at most DEMUX_MAX_BARCODE_LENGTH) and made up of A, C, G
+   and T.  Returns NULL if out of memory.
+*/
+demux_table*
+demux_create(char **names,
+             char **barcodes,
+             size_t num_samples,
+             int max_mismatches) {
+    demux_table *table;
+    size_t i, d, neighborhood, per_distance, size;
+
+    if ( (table = calloc(1, sizeof(demux_table))) == NULL )
+        return NULL;
+
+    table->barcode_l      = strlen(barcodes[0]);
+    table->max_mismatches = max_mismatches;
+    table->num_samples    = num_samples;
+
+    table->samples = calloc(num_samples + 1, sizeof(demux_sample));
+    if (table->samples == NULL) {
+        free(table);
+        return NULL;
+    }
+
+    for (i = 0; i <= num_samples; i++)
+        table->samples[i].fd = -1;
+
+    for (i = 0; i <= num_samples; i++) {
+        const char *name = i < num_samples ? names[i] : DEMUX_UNDETERMINED_NAME;
+        if ( (table->samples[i].name = strdup(name)) == NULL ) {
+            demux_close(table);
+            return NULL;
+        }
+        strncpy(table->samples[i].barcode,
+                i < num_samples ? barcodes[i] : "-",
+                DEMUX_MAX_BARCODE_LENGTH);
+    }
+
+    /* (L choose d) * 4^d sequences at each distance d, at half load */
+    neighborhood = 0;
+    per_distance = 1;
+    for (d = 0; d <= (size_t) max_mismatches; d++) {
+        neighborhood += per_distance;
+        per_distance  = per_distance * (table->barcode_l - d) / (d + 1) *
+                        (DEMUX_NUM_CODES - 1);
+    }
+    for (size = 16; size < 2 * neighborhood * num_samples; size *= 2)
+        ;
+
+    table->table_mask = size - 1;
+    table->keys       = calloc(size, sizeof(uint64_t));
+    table->values     = malloc(size * sizeof(int32_t));
+    table->distances  = malloc(size * sizeof(uint8_t));
+    if (table->keys == NULL || table->values == NULL ||
+        table->distances == NULL) {
+        demux_close(table);
+        return NULL;
+    }
+
+    for (i = 0; i < num_samples; i++) {
+        uint64_t key = 0;
+        for (d = 0; d < table->barcode_l; d++)
+            key |= (uint64_t) demux_code(barcodes[i][d]) << (3 * d);
+        demux_add_neighborhood(table, key, 0, (int32_t) i, 0);
+    }
+
+    return table;
+}
+
+/*
+   Open '<prefix><sample><suffix>' for every sample, BGZF compressed at
+   'level' unless that is OUTBUF_PLAIN.  Returns 0, or -1 if a file could
+   not be opened (or if out of memory).
+*/
+int
+demux_open_outputs(demux_table *table,
+                   const char *prefix,
+                   const char *suffix,
+                   int level) {
+    char path[2 * DEMUX_MAX_PREFIX_LENGTH];
+    size_t i;
+
+    for (i = 0; i <= table->num_samples; i++) {
+        demux_sample *sample = &table->samples[i];
+
+        snprintf(path, sizeof(path), "%s%s%s", prefix, sample->name, suffix);
+        sample->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (sample->fd < 0)
+            return -1;
+        if ( (sample->out = outbuf_create(sample->fd,
+                                          DEMUX_OUTBUF_SIZE, level, 0)) == NULL )
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+   The sample a sequence's barcode belongs to (and the substitutions it
+   took), or DEMUX_UNDETERMINED.  The table is only read, so any number of
+   threads may look sequences up at once.
+*/
+int
+demux_lookup(const demux_table *table,
+             const char *seq,
+             size_t seq_l,
+             int *mismatches) {
+    uint64_t key = 0;
+    size_t i;
+
+    *mismatches = 0;
+    if (seq_l < table->barcode_l)
+        return DEMUX_UNDETERMINED;
+
+    for (i = 0; i < table->barcode_l; i++)
+        key |= (uint64_t) demux_code(seq[i]) << (3 * i);
+
+    i = demux_slot(table, key);
+    if (table->keys[i] == 0 || table->values[i] == DEMUX_AMBIGUOUS)
+        return DEMUX_UNDETERMINED;
+
+    *mismatches = table->distances[i];
+    return table->values[i];
+}
+
+/* count a read towards its sample, and return the sample's output */
+outbuf*
+demux_add(demux_table *table, int sample, int mismatches) {
+    demux_sample *s = &table->samples[sample == DEMUX_UNDETERMINED ?
+                                      table->num_samples : (size_t) sample];
+
+    s->reads++;
+    if (mismatches > 0)
+        s->mismatched_reads++;
+
+    return s->out;
+}
+
+/* the reads per sample: name, barcode, reads, with mismatches, percent */
+void
+demux_write_counts(const demux_table *table, outbuf *out) {
+    char percent[32];
+    long total = 0;
+    size_t i;
+
+    for (i = 0; i <= table->num_samples; i++)
+        total += table->samples[i].reads;
+
+    for (i = 0; i <= table->num_samples; i++) {
+        const demux_sample *sample = &table->samples[i];
+
+        snprintf(percent, sizeof(percent), "%.2f",
+                 total ? 100.0 * sample->reads / total : 0.0);
+
+        outbuf_puts(out, sample->name);
+        outbuf_putc(out, '\t');
+        outbuf_puts(out, sample->barcode);
+        outbuf_putc(out, '\t');
+        outbuf_put_int(out, sample->reads);
+        outbuf_putc(out, '\t');
+        outbuf_put_int(out, sample->mismatched_reads);
+        outbuf_putc(out, '\t');
+        outbuf_puts(out, percent);
+        outbuf_putc(out, '\n');
+    }
+}
+
+/* flush and close the outputs, and free the table; -1 if a write failed */
+int
+demux_close(demux_table *table) {
+    size_t i;
+    int ret = 0;
+
+    if (table == NULL)
+        return 0;
+
+    for (i = 0; i <= table->num_samples; i++) {
+        demux_sample *sample = &table->samples[i];
+
+        if (outbuf_close(sample->out) != 0)
+            ret = -1;
+        if (sample->fd >= 0 && close(sample->fd) != 0)
+            ret = -1;
+        free(sample->name);
+    }
+
+    free(table->samples);
+    free(table->keys);
+    free(table->values);
+    free(table->distances);
+    free(table);
+    return ret;
+}
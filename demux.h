@@ -0,0 +1,106 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Barcode demultiplexing ('--demux')
+
+   The reads of a pooled run are split up by the inline barcode at their
+   start in a single pass: every read goes to the output of the sample
+   whose barcode its first bases match, with up to DEMUX_MAX_MISMATCHES
+   substitutions allowed (an 'N' in the read counts as one), or else to
+   the 'undetermined' output.
+
+   All the barcodes are of the same length.  A hash table holds every
+   barcode along with its Hamming neighborhood (every sequence within the
+   allowed number of substitutions of it), each mapped to the closest
+   sample, so a read's prefix is assigned with a single lookup however
+   many samples there are.  A sequence that is equally close to two
+   barcodes is ambiguous, and its reads are undetermined.
+
+   The outputs are '<prefix><sample><suffix>' and
+   '<prefix>undetermined<suffix>', each with a buffer of its own
+   (DEMUX_OUTBUF_SIZE, as there may be hundreds of them), which may gzip
+   compress it.
+*/
+
+#ifndef _DEMUX_H_
+#define _DEMUX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+#include "outbuf.h"
+
+/* D E F I N E S *************************************************************/
+#define DEMUX_MAX_BARCODE_LENGTH 21       /* bases packed 3 bits apiece */
+#define DEMUX_MAX_MISMATCHES 2
+#define DEMUX_MAX_PREFIX_LENGTH 1024
+#define DEMUX_OUTBUF_SIZE (1 << 16)
+#define DEMUX_UNDETERMINED -1
+#define DEMUX_UNDETERMINED_NAME "undetermined" /* no sample may take it */
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    char   *name;
+    char   barcode[DEMUX_MAX_BARCODE_LENGTH + 1];
+    int    fd;
+    outbuf *out;
+    long   reads;
+    long   mismatched_reads;      /* assigned with substitutions */
+} demux_sample;
+
+typedef struct {
+    size_t       barcode_l;
+    int          max_mismatches;
+    size_t       num_samples;
+    demux_sample *samples;        /* and the undetermined reads last */
+    uint64_t     *keys;           /* packed sequences (+1, as 0 is empty) */
+    int32_t      *values;         /* sample, or -2 if ambiguous */
+    uint8_t      *distances;      /* substitutions from that sample */
+    size_t       table_mask;
+} demux_table;
+
+/* P R O T O T Y P E S *******************************************************/
+demux_table* demux_create(char **names,
+                          char **barcodes,
+                          size_t num_samples,
+                          int max_mismatches);
+int demux_open_outputs(demux_table *table,
+                       const char *prefix,
+                       const char *suffix,
+                       int level);
+int demux_lookup(const demux_table *table,
+                 const char *seq,
+                 size_t seq_l,
+                 int *mismatches);
+outbuf* demux_add(demux_table *table, int sample, int mismatches);
+void demux_write_counts(const demux_table *table, outbuf *out);
+int demux_close(demux_table *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DEMUX_H */
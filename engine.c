@@ -0,0 +1,120 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* The choice of search engine for a single pattern
+
+   See engine.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include "engine.h"
+#include "myers.h"
+#include "iupac.h"
+
+/* F U N C T I O N S *********************************************************/
+
+/* true if the pattern is searched with the IUPAC (mask based) matchers */
+int
+engine_is_iupac(const fqgrep_params *params) {
+    return !params->force_tre && iupac_is_pattern(params->pattern) &&
+           (params->n_wildcard || iupac_is_degenerate(params->pattern));
+}
+
+/*
+   True if the -m/-S/-I/-D/-s/-i/-d settings amount to a plain edit
+   distance threshold: all costs are equal, and no per-type threshold is
+   below the number of edits the total cost allows.  That number of edits
+   is stored in 'max_edits'.
+*/
+int
+engine_unit_cost_edits(const fqgrep_params *params, int *max_edits) {
+    if ( params->cost_substitutions <= 0 ||
+         params->cost_insertions != params->cost_substitutions ||
+         params->cost_deletions  != params->cost_substitutions )
+        return 0;
+
+    *max_edits = params->max_mismatches / params->cost_substitutions;
+    if ( params->max_insertions    < *max_edits ||
+         params->max_deletions     < *max_edits ||
+         params->max_substitutions < *max_edits )
+        return 0;
+
+    return 1;
+}
+
+/*
+   True if an approximate search of a plain pattern allows substitutions
+   only; the number of them allowed is stored in 'max_substitutions'.
+*/
+int
+engine_hamming_eligible(const fqgrep_params *params,
+                        int iupac,
+                        int *max_substitutions) {
+    if ( params->max_mismatches == 0 || params->force_tre || iupac ||
+         !myers_is_dna_literal(params->pattern) ||
+         params->max_insertions != 0 || params->max_deletions != 0 ||
+         params->cost_substitutions <= 0 )
+        return 0;
+
+    *max_substitutions = params->max_mismatches / params->cost_substitutions;
+    if (params->max_substitutions < *max_substitutions)
+        *max_substitutions = params->max_substitutions;
+
+    return 1;
+}
+
+/*
+   True if an approximate (or IUPAC) search fits the bit-parallel matcher;
+   the number of edits allowed is stored in 'max_edits'.
+*/
+int
+engine_myers_eligible(const fqgrep_params *params,
+                      int iupac,
+                      int *max_edits) {
+    if ( (params->max_mismatches == 0 && !iupac) || params->force_tre )
+        return 0;
+
+    if ( !(iupac || myers_is_dna_literal(params->pattern)) ||
+         strlen(params->pattern) > MYERS_MAX_PATTERN_LENGTH )
+        return 0;
+
+    return engine_unit_cost_edits(params, max_edits);
+}
+
+void
+engine_select(const fqgrep_params *params, engine_choice *choice) {
+    memset(choice, 0, sizeof(engine_choice));
+    choice->iupac = engine_is_iupac(params);
+
+    if ( engine_hamming_eligible(params, choice->iupac,
+                                 &choice->max_substitutions) )
+        choice->engine = ENGINE_HAMMING;
+    else if ( engine_myers_eligible(params, choice->iupac,
+                                    &choice->max_edits) )
+        choice->engine = ENGINE_MYERS;
+    else if ( params->max_mismatches != 0 || params->force_tre ||
+              choice->iupac )
+        choice->engine = ENGINE_TRE;
+    else
+        choice->engine = ENGINE_BM;
+}
@@ -0,0 +1,83 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* The choice of search engine for a single pattern
+
+   fqgrep and libfqgrep pick the engine of a pattern by the same rules,
+   which are kept here so the two can not drift apart.  In order:
+
+     hamming       -- a plain (ACGT) approximate search that allows no
+                      insertions and no deletions: only substitutions,
+                      counted over the 2-bit packed sequence
+     bit-parallel  -- a plain or IUPAC pattern of up to 64 bases, when
+                      all edit costs are equal and no per-type threshold
+                      (-s/-i/-d) is below the number of edits the total
+                      cost allows; exact IUPAC searches use shift-and
+     tre           -- any other approximate or IUPAC search, or all of
+                      them with 'force_tre'
+     boyer-moore   -- an exact search of a literal pattern
+
+   A pattern is searched as IUPAC codes when it only has such codes, and
+   has degenerate ones (or reads are searched with 'N' as a wildcard),
+   unless 'force_tre' is set.  The parameters are those of libfqgrep.h.
+*/
+
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include "libfqgrep.h"
+
+/* D E F I N E S *************************************************************/
+#define ENGINE_BM      0
+#define ENGINE_MYERS   1
+#define ENGINE_TRE     2
+#define ENGINE_HAMMING 3
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    int engine;                   /* ENGINE_* */
+    int iupac;                    /* searched as IUPAC codes */
+    int max_edits;                /* of the bit-parallel search */
+    int max_substitutions;        /* of the Hamming distance search */
+} engine_choice;
+
+/* P R O T O T Y P E S *******************************************************/
+int engine_is_iupac(const fqgrep_params *params);
+int engine_unit_cost_edits(const fqgrep_params *params, int *max_edits);
+int engine_hamming_eligible(const fqgrep_params *params,
+                            int iupac,
+                            int *max_substitutions);
+int engine_myers_eligible(const fqgrep_params *params,
+                          int iupac,
+                          int *max_edits);
+void engine_select(const fqgrep_params *params, engine_choice *choice);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ENGINE_H */
@@ -21,13 +21,33 @@
 /* I N C L U D E S ***********************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <limits.h>
 #include <string.h>
+#include <stdint.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <zlib.h>  
 #include <tre/tre.h>
 #include "kseq.h"
 #include "bm.h"
+#include "myers.h"
+#include "iupac.h"
+#include "trim.h"
+#include "demux.h"
+#include "qualmatch.h"
+#include "stats.h"
+#include "aho.h"
+#include "pigeon.h"
+#include "pgz.h"
+#include "mapfq.h"
+#include "seqscan.h"
+#include "outbuf.h"
+#include "fqindex.h"
+#include "pack.h"
+#include "engine.h"
 
 /* D E F I N E S *************************************************************/
 #define VERSION "0.4.4"
@@ -36,8 +56,41 @@
 #define MAX_PATTERN_LENGTH 1024
 #define MAX_DELIM_LENGTH 10
 #define MAX_READ_COMMENT_LENGTH 81
+#define RECORD_BATCH_SIZE 4096
+#define EXIT_TROUBLE 2            /* as grep: 0 matched, 1 did not, 2 failed */
+#define OPT_BOTH_STRANDS 256      /* long options without a short form */
+#define OPT_N_WILDCARD   257
+#define OPT_PAIR_MATCH   258
+#define OPT_TRIM         259
+#define OPT_TRIM_LEVELS  260
+#define OPT_TRIM_PREFIX  261
+#define OPT_MIN_QUAL     262
+#define OPT_LOW_QUAL_COST 263
+#define OPT_STATS        264
+#define OPT_FIRST        265
+#define OPT_DEMUX        266
+#define OPT_DEMUX_PREFIX 267
+#define OPT_GZIP_LEVEL   268
+#define OPT_NO_INDEX     269
+#define OPT_PACKED       270
+#define OUTPUT_GZIP_LEVEL 6       /* default of '--gzip-level' */
+
+/* when a read pair counts as matching ('--pair-match') */
+#define PAIR_MATCH_ANY   0        /* either mate matches */
+#define PAIR_MATCH_BOTH  1        /* both mates match */
+#define PAIR_MATCH_R1    2        /* the first mate matches */
+#define PAIR_MATCH_R2    3        /* the second mate matches */
 
 /* D A T A    S T R U C T U R E S ********************************************/
+/* the patterns given via a '-P' pattern file */
+typedef struct {
+    size_t num_patterns;
+    char   **names;             /* label reported for each pattern */
+    char   **sequences;
+    size_t *lengths;
+    int    *match_counts;       /* per input file match totals */
+} pattern_set;
+
 typedef struct {
     int count;
     int color;
@@ -54,11 +107,59 @@ typedef struct {
     int max_insertions;
     int max_deletions;
     int max_substitutions;
+    int num_threads;
+    int both_strands;
+    int n_wildcard;                       /* 'N' in reads matches any base */
+    int iupac;                            /* pattern has degenerate codes */
+    int pair_match;                       /* PAIR_MATCH_* policy */
     char output_fastq[FASTQ_FILENAME_MAX_LENGTH];
     char search_pattern[MAX_PATTERN_LENGTH];
     char delim[MAX_DELIM_LENGTH];         /* delimiter used in stats report */
     regex_t *tre_regex;                   /* Compiled tre regexp */
     regaparams_t *tre_regex_match_params; /* tre regexp matching parameters */
+    bm_searcher *bm_search;               /* precompiled boyer-moore search */
+    myers_pattern *myers;                 /* bit-parallel approximate search */
+    int myers_max_edits;                  /* max edits allowed in myers search */
+    char pattern_file[FASTQ_FILENAME_MAX_LENGTH];
+    pattern_set *patterns;                /* patterns from the '-P' file */
+    aho_automaton *aho;                   /* multi-pattern exact search */
+    pigeon_matcher *pigeon;               /* multi-pattern approximate search */
+    char search_pattern_rc[MAX_PATTERN_LENGTH]; /* reverse complement */
+    bm_searcher *bm_search_rc;            /* the same, for --both-strands */
+    myers_pattern *myers_rc;
+    regex_t *tre_regex_rc;
+    char input_r1[FASTQ_FILENAME_MAX_LENGTH]; /* paired-end inputs */
+    char input_r2[FASTQ_FILENAME_MAX_LENGTH];
+    char output_r2[FASTQ_FILENAME_MAX_LENGTH]; /* second mates' output */
+    int trim;                             /* TRIM_LEFT, TRIM_RIGHT (or 0) */
+    int trim_levels[TRIM_MAX_LEVELS];     /* mismatch levels to trim at */
+    size_t num_trim_levels;
+    char trim_prefix[TRIM_MAX_PREFIX_LENGTH];
+    myers_pattern *trim_pattern;          /* the anchored adapter */
+    trim_report *trim_report;
+    int min_quality;                      /* Phred score, or -1 if unused */
+    int low_quality_cost;                 /* substitution cost below it */
+    qual_matcher *qual_match;             /* quality-aware approximate search */
+    qual_matcher *qual_match_rc;
+    int stats;                            /* time the search stages */
+    char stats_file[FASTQ_FILENAME_MAX_LENGTH]; /* JSON output (or stderr) */
+    stats_report *stats_report;
+    int max_matches;                      /* stop an input after these (or 0) */
+    int quiet;                            /* only the exit status tells */
+    char demux_file[FASTQ_FILENAME_MAX_LENGTH]; /* barcode table */
+    char demux_prefix[DEMUX_MAX_PREFIX_LENGTH];
+    demux_table *demux;                   /* barcode demultiplexing */
+    int compress;                         /* compress every output ('-z') */
+    int gzip_level;                       /* of the compressed outputs */
+    int use_index;                        /* read inputs through their index */
+    const char **index_patterns;          /* looked up in an input's index */
+    size_t num_index_patterns;            /* (0 if it cannot narrow it down) */
+    char *index_rc_storage;
+    int packed;                           /* '--packed' 2-bit search */
+    pack_pattern *pack;                   /* packed (2-bit) search */
+    pack_pattern *pack_rc;
+    int pack_max_substitutions;
+    int pack_match_case;                  /* as the search it stands in for */
 } options;
 
 typedef struct {
@@ -71,48 +172,270 @@ typedef struct {
     int  num_insertions;
     int  num_deletions;
     int  num_substitutions;
+    int  pattern_idx;        /* matching '-P' pattern (or -1) */
+    char strand;             /* '+', or '-' for a reverse complement match */
+    int  weighted_cost;      /* quality-aware cost ('--min-qual') */
 } read_match;
 
+/* a view of a single FASTQ/FASTA record's fields */
+typedef struct {
+    const char *name;
+    size_t     name_l;
+    const char *comment;
+    size_t     comment_l;
+    const char *seq;
+    size_t     seq_l;
+    const char *qual;
+    size_t     qual_l;
+    const char *raw;          /* verbatim FASTQ text to print (or NULL) */
+    size_t     raw_l;
+    const pack_seq *packed;   /* 2-bit form of 'seq' (packed search only) */
+} fastq_record;
+
+/* a group of records (copied if need be) and their matches */
+typedef struct {
+    size_t       seqno;           /* position of the batch within the input */
+    size_t       num_records;
+    fastq_record records[RECORD_BATCH_SIZE];
+    read_match   matches[RECORD_BATCH_SIZE];
+    char         *arena;          /* storage for the record fields */
+    size_t       arena_len;
+    size_t       arena_cap;
+    pack_seq     packed[RECORD_BATCH_SIZE];
+    pack_arena   pack;            /* 2-bit sequences (packed search only) */
+} record_batch;
+
+typedef struct {
+    record_batch    **items;
+    size_t          capacity;
+    size_t          head;
+    size_t          count;
+    int             closed;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} batch_queue;
+
 /* 
    declare the type of file handler and the read() function
    as described here:
    http://lh3lh3.users.sourceforge.net/parsefastq.shtml
 */
-KSEQ_INIT(gzFile, gzread)  
+int read_input(pgz_reader *fp, void *buf, unsigned int len);
+KSEQ_INIT(pgz_reader*, read_input)  
+
+/* where the records of an input file come from */
+typedef struct {
+    kseq_t          *seq;             /* a (decompressed) stream */
+    mapfq_reader    *mapped;          /* or a memory mapped plain file */
+    fqindex         *index;           /* or the candidate blocks only */
+    pgz_reader      *fp;
+    int             fd;
+} record_source;
+
+/*
+   state shared between the stages of the threaded search; for paired-end
+   input the mates of a pair are kept next to each other in the batches
+*/
+typedef struct {
+    record_source   *sources;         /* one per mate */
+    size_t          num_mates;
+    const options   *opts;
+    record_batch    *batches;         /* pool of batches cycled through */
+    size_t          num_batches;
+    batch_queue     free_batches;     /* batches ready to be filled */
+    batch_queue     filled_batches;   /* batches ready to be matched */
+    record_batch    **done;           /* matched batches by seqno slot */
+    size_t          total_batches;    /* known once the reader is done */
+    int             stopped;          /* the '-n' limit was reached */
+    pthread_mutex_t done_lock;
+    pthread_cond_t  done_cond;
+    search_stats    *stats;           /* '--stats' counters (or NULL) */
+} search_pipeline;
+
+/* the '-C' count of an input file, by the sequence-only scanner */
+typedef struct {
+    const char    *input;
+    const options *opts;
+    int           match_counter;
+    int           *pattern_counts;    /* per '-P' pattern (or NULL) */
+    char          *short_read;        /* name of a read shorter than the */
+    size_t        short_read_l;       /* '-p' pattern, which stops a search */
+    search_stats  stats;
+} count_job;
+
+/* input files counted side by side, each by the next free thread */
+typedef struct {
+    count_job       *jobs;
+    size_t          num_jobs;
+    size_t          next_job;
+    pthread_mutex_t lock;
+} count_pool;
 
 /* P R O T O T Y P E S *******************************************************/
 void  help_message(void);
 void  version_info(void);
 int   process_options(int argc, char *argv[], options *opts);
-void  search_input_fastq_file(FILE *out_fp,
+int   output_level(const options *opts, const char *file);
+int   search_input_fastq_file(outbuf *out,
                               const char *input_fastq,
                               const options opts);
-void  report_read(FILE *out_fp,
+int   search_paired_fastq_files(outbuf **outs, const options opts);
+int   count_only_search(const options *opts, size_t num_inputs);
+int   count_input_files(outbuf *out,
+                        char **inputs,
+                        size_t num_inputs,
+                        const options *opts);
+void  count_input_file(count_job *job);
+void* count_worker_thread(void *arg);
+void  report_count_job(outbuf *out, count_job *job, const options *opts);
+void  open_record_source(record_source *source,
+                         const char *input_fastq,
+                         const options *opts);
+void  close_record_source(record_source *source);
+void  report_match_counts(outbuf *out,
+                          const char *input_name,
+                          const options *opts,
+                          int match_counter);
+int   match_limit_reached(const options *opts, int match_counter);
+int   search_stopped(search_pipeline *pipeline);
+int   search_records(outbuf **outs,
+                     record_source *sources,
+                     size_t num_mates,
+                     const options *opts,
+                     search_stats *stats);
+int   search_records_threaded(outbuf **outs,
+                              record_source *sources,
+                              size_t num_mates,
+                              const options *opts,
+                              search_stats *stats);
+void  record_source_stats(record_source *source, search_stats *stats);
+const char* matcher_name(const options *opts);
+void  add_search_stats(const options *opts,
+                       search_stats *stats,
+                       size_t num_mates);
+int   next_record(record_source *source, fastq_record *rec, int *transient);
+int   next_records(record_source *sources,
+                   size_t num_mates,
+                   fastq_record *recs,
+                   int *transient);
+int   mate_names_agree(const fastq_record *r1, const fastq_record *r2);
+size_t parse_trim_levels(const char *list, int *levels);
+void  setup_trim(options *opts, const char *first_input);
+void  anchored_adapter_search(const options *opts,
+                              read_match *info,
+                              size_t seq_len);
+void  setup_quality_search(options *opts);
+qual_matcher* create_qual_matcher(const options *opts, const char *pattern);
+void  destroy_quality_search(options *opts);
+void  quality_aware_search(const options *opts,
+                           read_match *info,
+                           const fastq_record *rec);
+void  setup_demux(options *opts);
+int   index_files(int argc, char *argv[]);
+void  index_help_message(void);
+void  setup_index_search(options *opts);
+void  demux_search(const options *opts, read_match *info, size_t seq_len);
+void  demux_record(const options *opts,
+                   const fastq_record *rec,
+                   const read_match *info);
+void  trim_record(const options *opts,
+                  const fastq_record *rec,
+                  const read_match *info);
+void  kseq_to_record(const kseq_t *seq, fastq_record *rec);
+void  mapfq_to_record(const mapfq_record *mrec, fastq_record *rec);
+void  clear_match(const fastq_record *rec, read_match *info);
+void  match_record(const options *opts,
+                   const fastq_record *rec,
+                   read_match *info);
+void  match_records(const options *opts,
+                    const fastq_record *recs,
+                    read_match *infos,
+                    size_t num_mates);
+int   records_match(const options *opts,
+                    const read_match *infos,
+                    size_t num_mates);
+int   process_record(outbuf **outs,
+                     const options *opts,
+                     const fastq_record *recs,
+                     const read_match *infos,
+                     size_t num_mates);
+void  batch_queue_init(batch_queue *queue, size_t capacity);
+void  batch_queue_destroy(batch_queue *queue);
+void  batch_queue_push(batch_queue *queue, record_batch *batch);
+record_batch* batch_queue_pop(batch_queue *queue);
+void  batch_queue_close(batch_queue *queue);
+size_t batch_arena_append(record_batch *batch, const char *str, size_t len);
+int   fill_record_batch(record_source *sources,
+                        size_t num_mates,
+                        record_batch *batch);
+void* search_reader_thread(void *arg);
+void* search_worker_thread(void *arg);
+void  report_read(outbuf *out,
                   const options *opts,
-                  const kseq_t *seq,
+                  const fastq_record *rec,
                   const read_match *info);
-void  report_fastq(FILE *out_fp,
+void  report_fastq(outbuf *out,
                    const options *opts,
-                   const kseq_t *seq,
+                   const fastq_record *rec,
                    const read_match *info);
-void  report_fasta(FILE *out_fp,
+void  report_fasta(outbuf *out,
                    const options *opts,
-                   const kseq_t *seq,
+                   const fastq_record *rec,
                    const read_match *info);
-void  report_stats(FILE *out_fp,
+void  report_stats(outbuf *out,
                    const options *opts,
-                   const kseq_t *seq,
+                   const fastq_record *rec,
                    const read_match *info);
-void  display_sequence(FILE *out_fp,
+void  display_sequence(outbuf *out,
                        const options *opts,
                        const char *sequence,
+                       size_t     sequence_len,
                        const char *substr_start,
-                       const char *substr_end,
-                       const int  start_pos,
-                       const int  end_pos);
-void  setup_tre(regaparams_t *params, regex_t *regexp, options *opts);
-void  approximate_regexp_search(const options *opts, read_match *info);
-char* substring(const char *str, size_t start, size_t len);
+                       const char *substr_end);
+void  setup_tre(regaparams_t *params,
+                regex_t *regexp,
+                regex_t *regexp_rc,
+                options *opts);
+void  compile_tre_regexp(regex_t *regexp, const char *pattern);
+size_t matcher_patterns(const options *opts,
+                        const char ***sequences,
+                        size_t **lengths,
+                        char **rc_storage);
+void  approximate_regexp_search(const options *opts,
+                                read_match *info,
+                                size_t seq_len);
+void  search_params(const options *opts, fqgrep_params *params);
+int   unit_cost_edits(const options *opts, int *max_edits);
+void  setup_myers(options *opts, int max_edits);
+myers_pattern* create_myers_pattern(const options *opts, const char *pattern);
+int   bit_parallel_search(const options *opts,
+                          const myers_pattern *mp,
+                          const char *sequence,
+                          size_t seq_len,
+                          myers_match *match);
+pattern_set* load_pattern_file(const char *pattern_file);
+void  free_pattern_set(pattern_set *patterns);
+void  setup_aho(options *opts);
+void  multi_pattern_search(const options *opts,
+                           read_match *info,
+                           size_t seq_len);
+void  setup_pigeon(options *opts);
+void  approximate_multi_pattern_search(const options *opts,
+                                       read_match *info,
+                                       size_t seq_len);
+void  approximate_myers_search(const options *opts,
+                               read_match *info,
+                               size_t seq_len);
+void  setup_hamming(options *opts, int max_substitutions);
+void  setup_packed_search(options *opts);
+void  pack_records(const options *opts,
+                   pack_arena *arena,
+                   fastq_record *recs,
+                   pack_seq *packed,
+                   size_t num_records);
+void  packed_search(const options *opts,
+                    read_match *info,
+                    const fastq_record *rec);
 char* stringn_duplicate(const char *str, size_t n);
 
 /* G L O B A L S *************************************************************/
@@ -122,8 +445,20 @@ char* stringn_duplicate(const char *str, size_t n);
 int main(int argc, char *argv[]) {
 
     int opt_idx;
-    FILE *out_fp;
+    int out_fd, out_r2_fd = -1;
+    int num_matched = 0;
+    outbuf *out, *out_r2 = NULL;
     char input_fastq[FASTQ_FILENAME_MAX_LENGTH] = { '\0' };
+    regex_t regxp;                    /* Compiled pattern to search for. */
+    regex_t regxp_rc;                 /* and its reverse complement */
+    regaparams_t match_params;        /* regexp matching parameters */
+    fqgrep_params params;             /* the same, as libfqgrep takes them */
+    engine_choice engine;             /* how a '-p' pattern is searched */
+
+    /* 'fqgrep index' writes the k-mer indexes of its input files */
+    if (argc > 1 && strcmp(argv[1], "index") == 0) {
+        return index_files(argc - 1, argv + 1);
+    }
 
     /* application of default options */
     options opts = {
@@ -142,27 +477,115 @@ int main(int argc, char *argv[]) {
         INT_MAX,      // maxiumum allowable insertions in match
         INT_MAX,      // maxiumum allowable deletions in match
         INT_MAX,      // maxiumum allowable substitutions in match
+        1,            // number of search threads
+        0,            // search both strands flag
+        0,            // read 'N' wildcard flag
+        0,            // IUPAC pattern flag
+        PAIR_MATCH_ANY, // read pair match policy
         {'\0'},       // output fastq file name
         {'\0'},       // search pattern string
         "\t",         // delimiter string for stats report
         NULL,         // pointer to tre regexp entity
-        NULL          // pointer to tre regexp matching parameters
+        NULL,         // pointer to tre regexp matching parameters
+        NULL,         // pointer to precompiled boyer-moore searcher
+        NULL,         // pointer to bit-parallel approximate searcher
+        0,            // max edits allowed in bit-parallel search
+        {'\0'},       // pattern file name
+        NULL,         // pointer to the pattern file's patterns
+        NULL,         // pointer to multi-pattern aho-corasick automaton
+        NULL,         // pointer to multi-pattern approximate matcher
+        {'\0'},       // reverse complement search pattern string
+        NULL,         // pointer to reverse complement boyer-moore searcher
+        NULL,         // pointer to reverse complement bit-parallel searcher
+        NULL,         // pointer to reverse complement tre regexp entity
+        {'\0'},       // paired-end first mates' input file name
+        {'\0'},       // paired-end second mates' input file name
+        {'\0'},       // paired-end second mates' output file name
+        0,            // adapter trimming side
+        {0},          // adapter trimming mismatch levels
+        0,            // number of adapter trimming mismatch levels
+        {'\0'},       // adapter trimming output file prefix
+        NULL,         // pointer to anchored adapter bit-parallel searcher
+        NULL,         // pointer to adapter trimming report
+        -1,           // minimum base quality (quality-aware search is off)
+        0,            // cost of substitutions at low quality bases
+        NULL,         // pointer to quality-aware searcher
+        NULL,         // pointer to reverse complement quality-aware searcher
+        0,            // search stage statistics flag
+        {'\0'},       // search stage statistics JSON file name
+        NULL,         // pointer to search stage statistics
+        0,            // matches to stop an input at (0 is unlimited)
+        0,            // quiet (exit status only) flag
+        {'\0'},       // demultiplexing barcode table file name
+        {'\0'},       // demultiplexing output file prefix
+        NULL,         // pointer to demultiplexing barcode table
+        0,            // compressed outputs flag
+        OUTPUT_GZIP_LEVEL, // compression level of the compressed outputs
+        1,            // read indexed inputs through their index
+        NULL,         // patterns to look up in the inputs' indexes
+        0,            // number of patterns to look up in the indexes
+        NULL,         // storage of their reverse complements
+        0,            // packed (2-bit) search flag
+        NULL,         // pointer to packed searcher
+        NULL,         // pointer to reverse complement packed searcher
+        0,            // substitutions allowed in packed search
+        0             // case sensitive packed search flag
     };
 
     opt_idx = process_options(argc, argv, &opts);
 
-    if (opt_idx >= argc) {
+    if (strlen(opts.input_r1) && opt_idx < argc) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] Paired-end input is only given via '-1' and "
+                        "'-2'!");
+        exit(EXIT_TROUBLE);
+    }
+    else if (!strlen(opts.input_r1) && opt_idx >= argc) {
         fprintf(stderr, "%s : %s\n",
                         PRG_NAME, "[err] specify FASTQ files to process!");
-        exit(1);
+        exit(EXIT_TROUBLE);
     }
 
-    /* setup and compile the tre regexp if needed */
-    if (opts.max_mismatches != 0 || opts.force_tre == 1) {
-        regex_t regxp;                    /* Compiled pattern to search for. */
-        regaparams_t match_params;        /* regexp matching parameters */
+    /* a '-p' pattern is searched with the engine libfqgrep would pick */
+    search_params(&opts, &params);
+    engine_select(&params, &engine);
 
-        setup_tre( &match_params, &regxp, &opts );
+    /* demultiplexing looks the reads' barcodes up, rather than searching */
+    if (strlen(opts.demux_file)) {
+        setup_demux(&opts);
+    }
+    /* adapter trimming aligns the adapter to one end of the reads */
+    else if (opts.trim) {
+        setup_trim(&opts, argv[opt_idx]);
+    }
+    /* substitutions at poor base calls cost less in a quality-aware search */
+    else if (opts.min_quality >= 0) {
+        setup_quality_search(&opts);
+    }
+    /* a pattern file is searched for with one aho-corasick automaton */
+    else if (opts.patterns != NULL && opts.max_mismatches == 0) {
+        setup_aho(&opts);
+    }
+    /* or approximately, seeded by the exact pieces of the patterns */
+    else if (opts.patterns != NULL) {
+        setup_pigeon(&opts);
+    }
+    /* substitutions only: the packed (2-bit) Hamming distance kernel */
+    else if (engine.engine == ENGINE_HAMMING) {
+        setup_hamming(&opts, engine.max_substitutions);
+    }
+    /*
+       plain DNA patterns can use the bit-parallel approximate matcher, and
+       so can IUPAC patterns (searched exactly with shift-and)
+    */
+    else if (engine.engine == ENGINE_MYERS) {
+        setup_myers(&opts, engine.max_edits);
+//        fprintf(stdout, "Using bit-parallel search, %d edits\n",
+//                        opts.myers_max_edits);
+    }
+    /* otherwise setup and compile the tre regexp if needed */
+    else if (engine.engine == ENGINE_TRE) {
+        setup_tre( &match_params, &regxp, &regxp_rc, &opts );
 
 //    fprintf(stdout, "TRE regex params setup:\n");
 //    fprintf(stdout, "\t%-12s : %4d\n", "cost_ins",   match_params.cost_ins);
@@ -176,27 +599,155 @@ int main(int argc, char *argv[]) {
 //    fprintf(stdout, "\t%-12s : %4d\n", "max_err",   match_params.max_err);
 //    fprintf(stdout, "\n\n");
     }
+    /* otherwise precompile the boyer-moore tables for the exact search */
+    else {
+        opts.bm_search = bm_searcher_create(opts.search_pattern,
+                                            strlen(opts.search_pattern));
+        if (opts.both_strands) {
+            opts.bm_search_rc =
+                bm_searcher_create(opts.search_pattern_rc,
+                                   strlen(opts.search_pattern_rc));
+        }
+        if (opts.bm_search == NULL ||
+            (opts.both_strands && opts.bm_search_rc == NULL)) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+    }
+
+    /* an exact search can also run over the reads packed 2 bits per base */
+    if (opts.packed && opts.bm_search != NULL) {
+        setup_packed_search(&opts);
+    }
+
+    /* inputs with a k-mer index are only read where the patterns may be */
+    if (opts.use_index) {
+        setup_index_search(&opts);
+    }
+
+    /* the stage timers run from here on */
+    if (opts.stats) {
+        opts.stats_report = stats_report_open(opts.stats_file);
+        if (opts.stats_report == NULL) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+    }
 
-    /* setup the appropriate output file pointer */
+    /* setup the appropriate output file descriptor */
     if ( !strlen(opts.output_fastq) ) {
-        out_fp = stdout;
+        out_fd = fileno(stdout);
     }
     else {
-        if ( (out_fp = fopen(opts.output_fastq, "w")) == NULL ) {
+        out_fd = open(opts.output_fastq, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (out_fd < 0) {
             fprintf(stderr, "%s : [err] Could not open '%s' for writing.\n",
                             PRG_NAME, opts.output_fastq);
-            exit(1);
+            exit(EXIT_TROUBLE);
+        }
+    }
+
+    out = outbuf_create(out_fd, OUTBUF_SIZE,
+                        output_level(&opts, opts.output_fastq),
+                        opts.num_threads);
+    if (out == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+
+    /* second mates go to their own file, or else interleaved with the first */
+    if ( strlen(opts.output_r2) ) {
+        out_r2_fd = open(opts.output_r2, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (out_r2_fd < 0) {
+            fprintf(stderr, "%s : [err] Could not open '%s' for writing.\n",
+                            PRG_NAME, opts.output_r2);
+            exit(EXIT_TROUBLE);
         }
+        out_r2 = outbuf_create(out_r2_fd, OUTBUF_SIZE,
+                               output_level(&opts, opts.output_r2),
+                               opts.num_threads);
+        if (out_r2 == NULL) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+    }
+
+    /* search the read pairs of '-1' and '-2' in lockstep */
+    if ( strlen(opts.input_r1) ) {
+        outbuf *outs[2];
+        outs[0] = out;
+        outs[1] = out_r2 != NULL ? out_r2 : out;
+        num_matched += search_paired_fastq_files(outs, opts);
     }
     
+    /* counts need only the sequences, so they skip the record parsing */
+    if ( count_only_search(&opts, (size_t) (argc - opt_idx)) ) {
+        num_matched += count_input_files(out, argv + opt_idx,
+                                         (size_t) (argc - opt_idx), &opts);
+        opt_idx = argc;
+    }
+
     /* the remaining command line arguments are FASTQ(s) to process */
     while (opt_idx < argc) {
+        /* '-q' has its answer at the first match */
+        if (opts.quiet && num_matched > 0)
+            break;
         strncpy(input_fastq, argv[opt_idx], FASTQ_FILENAME_MAX_LENGTH);
-        search_input_fastq_file(out_fp, input_fastq, opts);
+        num_matched += search_input_fastq_file(out, input_fastq, opts);
         opt_idx++;
     }
 
-    fclose(out_fp);
+    /* the reads per sample are the output of a demultiplexing run */
+    if (opts.demux != NULL) {
+        demux_write_counts(opts.demux, out);
+    }
+
+    if ( demux_close(opts.demux) != 0 ) {
+        fprintf(stderr, "%s : [err] Could not write the '--demux' outputs.\n",
+                        PRG_NAME);
+        exit(EXIT_TROUBLE);
+    }
+    if ( outbuf_close(out) != 0 ||
+         (out_r2 != NULL && outbuf_close(out_r2) != 0) ||
+         trim_report_close(opts.trim_report) != 0 ) {
+        fprintf(stderr, "%s : [err] Could not write the output.\n", PRG_NAME);
+        exit(EXIT_TROUBLE);
+    }
+    if ( stats_report_close(opts.stats_report) != 0 ) {
+        fprintf(stderr, "%s : [err] Could not write the '--stats' file '%s'.\n",
+                        PRG_NAME, opts.stats_file);
+        exit(EXIT_TROUBLE);
+    }
+    if (out_fd != fileno(stdout)) {
+        close(out_fd);
+    }
+    if (out_r2_fd >= 0) {
+        close(out_r2_fd);
+    }
+    bm_searcher_destroy(opts.bm_search);
+    bm_searcher_destroy(opts.bm_search_rc);
+    myers_pattern_destroy(opts.myers);
+    myers_pattern_destroy(opts.myers_rc);
+    myers_pattern_destroy(opts.trim_pattern);
+    destroy_quality_search(&opts);
+    aho_destroy(opts.aho);
+    pigeon_destroy(opts.pigeon);
+    free_pattern_set(opts.patterns);
+    free(opts.index_patterns);
+    free(opts.index_rc_storage);
+    pack_pattern_destroy(opts.pack);
+    pack_pattern_destroy(opts.pack_rc);
+
+    /*
+       as grep's '-q', the exit status tells whether anything matched (any
+       error has already exited with EXIT_TROUBLE)
+    */
+    if (opts.quiet && num_matched == 0)
+        return 1;
 
     return 0;
 }
@@ -209,6 +760,8 @@ help_message() {
     fprintf(stdout, "\t%-20s%-20s\n", "-h", "This help message");
     fprintf(stdout, "\t%-20s%-20s\n", "-V", "Program and version information");
     fprintf(stdout, "\t%-20s%-20s\n", "-p <STRING>", "Pattern of interest to grep [REQUIRED]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-P <FILE>", "File of patterns to grep for (instead of -p),");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "one per line, optionally as '<name>\\t<pattern>'");
     fprintf(stdout, "\t%-20s%-20s\n", "-v", "Invert match - show only sequences that ");
     fprintf(stdout, "\t%-20s%-20s\n", "", "DO NOT match the pattern");
     fprintf(stdout, "\t%-20s%-20s\n", "-a", "Show all records irregardless of match status");
@@ -237,8 +790,75 @@ help_message() {
     fprintf(stdout, "\t%-20s%-20s\n", "-e", "Force tre regexp engine usage");
     fprintf(stdout, "\t%-20s%-20s\n", "-C", "Display only a total count of matches");
     fprintf(stdout, "\t%-20s%-20s\n", "", "(per input FASTQ/FASTA file)");
+    fprintf(stdout, "\t%-20s%-20s\n", "-n <INT>", "Stop reading an input after INT matches");
+    fprintf(stdout, "\t%-20s%-20s\n", "--first", "Stop reading an input at its first match");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "(the same as '-n 1')");
+    fprintf(stdout, "\t%-20s%-20s\n", "-q", "Quiet - print nothing, but exit with status 0");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "at the first match, 1 if nothing matched, or 2");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "on an error (as for any run that fails)");
     fprintf(stdout, "\t%-20s%-20s\n", "-o <out_file>", "Desired output file.");
     fprintf(stdout, "\t%-20s%-20s\n", "", "If not specified, defaults to stdout");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "A name ending in '.gz' is BGZF compressed");
+    fprintf(stdout, "\t%-20s%-20s\n", "-z", "BGZF compress every output (stdout too)");
+    fprintf(stdout, "\t%-20s%-20s\n", "--gzip-level <INT>", "Compression level, 1 (fastest) to 9");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "[Default: 6]; -t threads compress");
+    fprintf(stdout, "\t%-20s%-20s\n", "-t <INT>", "Number of threads to search with [Default: 1]");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "Output is kept in the original input order");
+    fprintf(stdout, "\t%-20s%-20s\n", "--both-strands", "Also search for the reverse complement of");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "the pattern(s), in the same pass");
+    fprintf(stdout, "\t%-20s%-20s\n", "--n-wildcard", "Let an 'N' in a read match any base of an");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "(IUPAC) '-p' pattern [Default: mismatch]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-1 <FILE>", "Paired-end first mates (instead of input");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "files), searched in step with '-2'");
+    fprintf(stdout, "\t%-20s%-20s\n", "-2 <FILE>", "Paired-end second mates");
+    fprintf(stdout, "\t%-20s%-20s\n", "-O <out_file>", "Output file of the second mates of the");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "reported pairs. If not specified, they are");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "interleaved with the first mates' output");
+    fprintf(stdout, "\t%-20s%-20s\n", "--pair-match <MODE>", "When a read pair matches: 'any' mate,");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "'both' mates, or only 'r1' or 'r2'");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "[Default: any]");
+    fprintf(stdout, "\t%-20s%-20s\n", "--trim <SIDE>", "Trim the '-p' adapter off the 'left' (start)");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "or 'right' (end) of the reads, into");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "<prefix>.<m>.trim/.omit/.utrim files and the");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "<prefix>.rch.dat and <prefix>.rlh.dat tables");
+    fprintf(stdout, "\t%-20s%-20s\n", "--trim-levels <INT>", "Comma separated mismatch levels to trim");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "at, in one pass [Default: the -m value]");
+    fprintf(stdout, "\t%-20s%-20s\n", "--trim-prefix <STR>", "Prefix of the trimming output files");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "[Default: the first input's file name]");
+    fprintf(stdout, "\t%-20s%-20s\n", "--min-qual <INT>", "Quality-aware search: a substitution at a");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "base of a lower Phred score costs only");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "'--low-qual-cost'; -r adds the weighted cost");
+    fprintf(stdout, "\t%-20s\n", "--low-qual-cost <INT>");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "Cost of such substitutions [Default: 0]");
+    fprintf(stdout, "\t%-20s%-20s\n", "--demux <FILE>", "Split the reads into a file per sample by");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "the barcode at their start (instead of -p),");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "from '<sample>\\t<barcode>' lines, allowing");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "-m (at most 2) mismatches; the reads per");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "sample are the output ('-z' compresses the");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "per sample files only)");
+    fprintf(stdout, "\t%-20s\n", "--demux-prefix <STR>");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "Prefix of the per sample output files");
+    fprintf(stdout, "\t%-20s%-20s\n", "--stats[=FILE]", "Time the read, match and report stages and");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "count records, bytes and matches, into a");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "summary on stderr (or as JSON into FILE)");
+    fprintf(stdout, "\t%-20s%-20s\n", "--no-index", "Read every input in full, even one with a");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "k-mer index (see 'fqgrep index -h')");
+    fprintf(stdout, "\t%-20s%-20s\n", "--packed", "Pack the reads 2 bits per base, and search");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "them 32 bases per word (exact searches of");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "an upper case ACGT '-p' pattern)");
+}
+
+void
+index_help_message() {
+    fprintf(stdout, "Usage: %s %s %s\n",
+                    PRG_NAME, "index [options]", "<fastq_or_fasta_files>");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "Write a k-mer index <file>.fqi of each plain");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "or BGZF file; later searches of exact or");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "-m approximate patterns only read the blocks");
+    fprintf(stdout, "\t%-20s%-20s\n", "", "of records that may match");
+    fprintf(stdout, "\t%-20s%-20s\n", "-h", "This help message");
+    fprintf(stdout, "\t%-20s%-20s\n", "-k <INT>", "k-mer length, 8 to 12 [Default: 11]");
+    fprintf(stdout, "\t%-20s%-20s\n", "-b <INT>", "Records per index block [Default: 64]");
 }
 
 void
@@ -254,9 +874,30 @@ process_options(int argc, char *argv[], options *opts) {
     int c;
     char *opt_o_value = NULL;
     char *opt_p_value = NULL;
+    char *opt_P_value = NULL;
     char *opt_b_value = NULL;
+    static const struct option long_options[] = {
+        { "both-strands", no_argument, NULL, OPT_BOTH_STRANDS },
+        { "n-wildcard",   no_argument, NULL, OPT_N_WILDCARD   },
+        { "pair-match",   required_argument, NULL, OPT_PAIR_MATCH },
+        { "trim",         required_argument, NULL, OPT_TRIM       },
+        { "trim-levels",  required_argument, NULL, OPT_TRIM_LEVELS },
+        { "trim-prefix",  required_argument, NULL, OPT_TRIM_PREFIX },
+        { "min-qual",     required_argument, NULL, OPT_MIN_QUAL   },
+        { "low-qual-cost", required_argument, NULL, OPT_LOW_QUAL_COST },
+        { "stats",        optional_argument, NULL, OPT_STATS      },
+        { "first",        no_argument, NULL, OPT_FIRST        },
+        { "demux",        required_argument, NULL, OPT_DEMUX      },
+        { "demux-prefix", required_argument, NULL, OPT_DEMUX_PREFIX },
+        { "gzip-level",   required_argument, NULL, OPT_GZIP_LEVEL },
+        { "no-index",     no_argument, NULL, OPT_NO_INDEX     },
+        { "packed",       no_argument, NULL, OPT_PACKED       },
+        { NULL,           0,           NULL, 0                }
+    };
 
-    while( (c = getopt(argc, argv, "hVecfrvam:i:s:d:o:p:b:CD:I:S:")) != -1 ) {
+    while( (c = getopt_long(argc, argv,
+                            "hVecfrvam:i:s:d:o:p:P:b:CD:I:S:t:n:qz1:2:O:",
+                            long_options, NULL)) != -1 ) {
         switch(c) {
             case 'h':
                 help_message();
@@ -281,6 +922,9 @@ process_options(int argc, char *argv[], options *opts) {
             case 'p':
                 opt_p_value = optarg;
                 break;
+            case 'P':
+                opt_P_value = optarg;
+                break;
             case 'b':
                 opt_b_value = optarg;
                 break;
@@ -321,24 +965,281 @@ process_options(int argc, char *argv[], options *opts) {
             case 'C':
                 opts->count = 1;
                 break;
+            case 't':
+                opts->num_threads = atoi(optarg);
+                break;
+            case 'n':
+                opts->max_matches = atoi(optarg);
+                if (opts->max_matches < 1) {
+                    fprintf(stderr, "%s : %s\n", PRG_NAME,
+                                    "[err] The '-n' match limit must be at "
+                                    "least 1!");
+                    exit(EXIT_TROUBLE);
+                }
+                break;
+            case OPT_FIRST:
+                opts->max_matches = 1;
+                break;
+            case 'q':
+                opts->quiet = 1;
+                break;
+            case 'z':
+                opts->compress = 1;
+                break;
+            case OPT_NO_INDEX:
+                opts->use_index = 0;
+                break;
+            case OPT_PACKED:
+                opts->packed = 1;
+                break;
+            case OPT_GZIP_LEVEL:
+                opts->gzip_level = atoi(optarg);
+                if (opts->gzip_level < 1 || opts->gzip_level > 9) {
+                    fprintf(stderr, "%s : %s\n", PRG_NAME,
+                                    "[err] '--gzip-level' is from 1 to 9!");
+                    exit(EXIT_TROUBLE);
+                }
+                break;
+            case OPT_DEMUX:
+                strncpy(opts->demux_file, optarg,
+                        FASTQ_FILENAME_MAX_LENGTH - 1);
+                break;
+            case OPT_DEMUX_PREFIX:
+                strncpy(opts->demux_prefix, optarg,
+                        DEMUX_MAX_PREFIX_LENGTH - 1);
+                break;
+            case OPT_BOTH_STRANDS:
+                opts->both_strands = 1;
+                break;
+            case OPT_N_WILDCARD:
+                opts->n_wildcard = 1;
+                break;
+            case '1':
+                strncpy(opts->input_r1, optarg, FASTQ_FILENAME_MAX_LENGTH);
+                break;
+            case '2':
+                strncpy(opts->input_r2, optarg, FASTQ_FILENAME_MAX_LENGTH);
+                break;
+            case 'O':
+                strncpy(opts->output_r2, optarg, FASTQ_FILENAME_MAX_LENGTH);
+                break;
+            case OPT_PAIR_MATCH:
+                if ( strcmp(optarg, "any") == 0 ) {
+                    opts->pair_match = PAIR_MATCH_ANY;
+                }
+                else if ( strcmp(optarg, "both") == 0 ) {
+                    opts->pair_match = PAIR_MATCH_BOTH;
+                }
+                else if ( strcmp(optarg, "r1") == 0 ) {
+                    opts->pair_match = PAIR_MATCH_R1;
+                }
+                else if ( strcmp(optarg, "r2") == 0 ) {
+                    opts->pair_match = PAIR_MATCH_R2;
+                }
+                else {
+                    fprintf(stderr, "%s : %s\n", PRG_NAME,
+                                    "[err] '--pair-match' is one of 'any', "
+                                    "'both', 'r1' or 'r2'!");
+                    exit(EXIT_TROUBLE);
+                }
+                break;
+            case OPT_TRIM:
+                if ( strcmp(optarg, "left") == 0 ) {
+                    opts->trim = TRIM_LEFT;
+                }
+                else if ( strcmp(optarg, "right") == 0 ) {
+                    opts->trim = TRIM_RIGHT;
+                }
+                else {
+                    fprintf(stderr, "%s : %s\n", PRG_NAME,
+                                    "[err] '--trim' is either 'left' or "
+                                    "'right'!");
+                    exit(EXIT_TROUBLE);
+                }
+                break;
+            case OPT_TRIM_LEVELS:
+                opts->num_trim_levels =
+                    parse_trim_levels(optarg, opts->trim_levels);
+                break;
+            case OPT_TRIM_PREFIX:
+                strncpy(opts->trim_prefix, optarg, TRIM_MAX_PREFIX_LENGTH - 1);
+                break;
+            case OPT_MIN_QUAL:
+                opts->min_quality = atoi(optarg);
+                break;
+            case OPT_LOW_QUAL_COST:
+                opts->low_quality_cost = atoi(optarg);
+                break;
+            case OPT_STATS:
+                opts->stats = 1;
+                if (optarg != NULL)
+                    strncpy(opts->stats_file, optarg,
+                            FASTQ_FILENAME_MAX_LENGTH - 1);
+                break;
             case '?':
-                exit(1);
+                exit(EXIT_TROUBLE);
              default:
                 abort();
         }
     }
 
     /* ascertain whether a query pattern was given */
-    if ( opt_p_value == NULL ) {
+    if ( strlen(opts->demux_file) != 0 ) {
+        /* the barcode table takes the place of the pattern(s) */
+        if ( opt_p_value != NULL || opt_P_value != NULL ||
+             opts->invert_match || opts->show_all_records || opts->count ||
+             opts->quiet || opts->trim || opts->min_quality >= 0 ||
+             opts->both_strands || opts->force_tre ||
+             strlen(opts->input_r1) != 0 ) {
+            fprintf(stderr, "%s : %s\n", PRG_NAME,
+                            "[err] '--demux' routes every read by its barcode "
+                            "(without -p/-P, -v, -a, -C, -q, -e, -1/-2, "
+                            "'--both-strands', '--trim' or '--min-qual')!");
+            exit(EXIT_TROUBLE);
+        }
+        if ( opts->max_mismatches < 0 ||
+             opts->max_mismatches > DEMUX_MAX_MISMATCHES ) {
+            fprintf(stderr, "%s : [err] '--demux' allows at most %d "
+                            "mismatches (-m)!\n",
+                            PRG_NAME, DEMUX_MAX_MISMATCHES);
+            exit(EXIT_TROUBLE);
+        }
+    }
+    else if ( strlen(opts->demux_prefix) != 0 ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '--demux-prefix' goes with '--demux'!");
+        exit(EXIT_TROUBLE);
+    }
+    else if ( opt_p_value != NULL && opt_P_value != NULL ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] The '-p' and '-P' options are exclusive!");
+        exit(EXIT_TROUBLE);
+    }
+    else if ( opt_P_value != NULL ) {
+        strncpy(opts->pattern_file, opt_P_value, FASTQ_FILENAME_MAX_LENGTH);
+        opts->patterns = load_pattern_file(opts->pattern_file);
+    }
+    else if ( opt_p_value == NULL ) {
         fprintf(stderr, "%s : %s\n", PRG_NAME,
                         "[err] Specify a search pattern via the '-p' option!");
         fprintf(stderr, "Type '%s -h' for usage.\n", PRG_NAME);
-        exit(1);
+        exit(EXIT_TROUBLE);
     }
     else {
         strncpy(opts->search_pattern, opt_p_value, MAX_PATTERN_LENGTH);
     }
 
+    if ( opts->patterns != NULL && opts->force_tre == 1 ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] Patterns from '-P' can not use the tre engine!");
+        exit(EXIT_TROUBLE);
+    }
+
+    if ( opts->patterns != NULL && opts->n_wildcard ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '--n-wildcard' only applies to a '-p' pattern!");
+        exit(EXIT_TROUBLE);
+    }
+
+    /*
+       IUPAC degenerate codes in a '-p' pattern (or wildcard 'N's in the
+       reads) need the mask based matchers rather than a literal search
+    */
+    if (opts->patterns == NULL) {
+        fqgrep_params params;
+        search_params(opts, &params);
+        opts->iupac = engine_is_iupac(&params);
+    }
+
+    /* the reverse complement is only defined for sequences of bases */
+    if ( opts->both_strands ) {
+        int ok = 1;
+        if (opts->patterns != NULL) {
+            size_t i;
+            char rc[MAX_PATTERN_LENGTH];
+            for (i = 0; i < opts->patterns->num_patterns && ok; i++) {
+                ok = iupac_reverse_complement(opts->patterns->sequences[i],
+                                              opts->patterns->lengths[i],
+                                              rc);
+            }
+        }
+        else {
+            ok = iupac_reverse_complement(opts->search_pattern,
+                                          strlen(opts->search_pattern),
+                                          opts->search_pattern_rc);
+        }
+        if (!ok) {
+            fprintf(stderr, "%s : %s\n", PRG_NAME,
+                            "[err] '--both-strands' needs patterns made up "
+                            "of (IUPAC) base codes only!");
+            exit(EXIT_TROUBLE);
+        }
+    }
+
+    if ( strlen(opts->input_r1) != 0 && strlen(opts->input_r2) == 0 ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '-1' also needs the second mates via '-2'!");
+        exit(EXIT_TROUBLE);
+    }
+    if ( strlen(opts->input_r2) != 0 && strlen(opts->input_r1) == 0 ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '-2' also needs the first mates via '-1'!");
+        exit(EXIT_TROUBLE);
+    }
+    if ( strlen(opts->output_r2) != 0 && strlen(opts->input_r1) == 0 ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '-O' is only for paired-end ('-1'/'-2') input!");
+        exit(EXIT_TROUBLE);
+    }
+
+    if ( opts->trim &&
+         (opts->patterns != NULL || strlen(opts->input_r1) != 0 ||
+          opts->both_strands || opts->force_tre) ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '--trim' only trims a single '-p' adapter "
+                        "(without -P, -1/-2, -e or '--both-strands')!");
+        exit(EXIT_TROUBLE);
+    }
+    if ( !opts->trim &&
+         (opts->num_trim_levels != 0 || strlen(opts->trim_prefix) != 0) ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '--trim-levels' and '--trim-prefix' go with "
+                        "'--trim'!");
+        exit(EXIT_TROUBLE);
+    }
+
+    if ( opts->min_quality >= 0 &&
+         (opts->patterns != NULL || opts->force_tre || opts->trim) ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '--min-qual' searches a single '-p' pattern "
+                        "(without -P, -e or '--trim')!");
+        exit(EXIT_TROUBLE);
+    }
+    if ( opts->low_quality_cost < 0 ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '--low-qual-cost' can not be negative!");
+        exit(EXIT_TROUBLE);
+    }
+
+    if ( opts->trim && (opts->max_matches != 0 || opts->quiet) ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] '--trim' goes through every read, so it can "
+                        "not be limited by -n, -q or '--first'!");
+        exit(EXIT_TROUBLE);
+    }
+
+    /* '-q' only needs to see the first match, and prints nothing */
+    if ( opts->quiet ) {
+        opts->count       = 1;
+        opts->max_matches = 1;
+    }
+
+    if ( opts->num_threads < 1 ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] The '-t' thread count must be at least 1!");
+        exit(EXIT_TROUBLE);
+    }
+
     /* setup delimiter for stats report (if given) */
     if ( opt_b_value != NULL ) {
         strncpy(opts->delim, opt_b_value, MAX_DELIM_LENGTH);
@@ -352,475 +1253,2755 @@ process_options(int argc, char *argv[], options *opts) {
     return optind;
 }
 
-void
-search_input_fastq_file(FILE *out_fp, 
+/*
+   The compression level of an output file (empty for stdout): BGZF for
+   '-z', or a name ending in '.gz'.  '-q' leaves nothing to compress, and
+   with '--demux', '-z' is for the per sample files rather than the table
+   of counts.
+*/
+int
+output_level(const options *opts, const char *file) {
+    size_t len = strlen(file);
+
+    if (opts->quiet)
+        return OUTBUF_PLAIN;
+    if (opts->compress && strlen(opts->demux_file) == 0)
+        return opts->gzip_level;
+    if (len > 3 && strcmp(file + len - 3, ".gz") == 0)
+        return opts->gzip_level;
+    return OUTBUF_PLAIN;
+}
+
+int
+search_input_fastq_file(outbuf *out, 
                         const char *input_fastq,
                         const options opts) {
-    gzFile fp;
-    kseq_t *seq;
-    int l, match_counter = 0;
-    read_match match_info;
-
-    // open the file handler
-    if ( strcmp(input_fastq, "-") == 0 ) {
-        fp = gzdopen(fileno(stdin), "r");
-    }
-    else {
-        fp = gzopen(input_fastq, "r");
+    record_source source;
+    int match_counter = 0;
+    search_stats file_stats, *stats = NULL;
+    stats_ticks start = 0;
+    size_t out_start = 0;
+
+    if (opts.stats_report != NULL) {
+        stats = &file_stats;
+        stats_clear(stats, input_fastq);
+        start     = stats_now();
+        out_start = outbuf_tell(out);
     }
 
-    if ( (fp == NULL) && (strcmp(input_fastq, "-") != 0) ) {
-        fprintf(stderr, "%s : [err] Could not open FASTQ '%s' for reading.\n",
-                        PRG_NAME, input_fastq);
-        exit(1);
+    open_record_source(&source, input_fastq, &opts);
+
+    if (opts.patterns != NULL) {
+        memset(opts.patterns->match_counts, 0,
+               opts.patterns->num_patterns * sizeof(int));
     }
 
-    if ( (fp == NULL) && (strcmp(input_fastq, "-") == 0) ) {
-        fprintf(stderr, "%s : [err] Could not open stdin for reading.\n",
-                        PRG_NAME);
-        exit(1);
+    // read, match and report the sequences
+    if (opts.num_threads > 1) {
+        match_counter = search_records_threaded(&out, &source, 1, &opts,
+                                                stats);
+    }
+    else {
+        match_counter = search_records(&out, &source, 1, &opts, stats);
     }
 
-    // initialize seq
-    seq = kseq_init(fp);
+    if (stats != NULL)
+        record_source_stats(&source, stats);
+    close_record_source(&source);
 
-    // read sequence  
-    while ( (l = kseq_read(seq)) >= 0 ) {
-        if ( (strlen(seq->seq.s) < strlen(opts.search_pattern)) &&
-             (opts.max_mismatches == 0) &&
-             (opts.force_tre == 0) ) {
-            fprintf(stderr, "%s : %s '%s' %s (%zd) %s (%zd).\n",
-                            PRG_NAME,
-                            "[err] For sequence ",
-                            seq->name.s,
-                            "search pattern length",
-                            strlen(opts.search_pattern),
-                            "exceeds sequence length",
-                            strlen(seq->seq.s) );
-            exit(1);
-        }
-
-        /* initialize the match info structure */
-        match_info.sequence     = seq->seq.s;
-        match_info.substr_start = NULL;
-        match_info.substr_end   = NULL;
-        match_info.start_pos    = 0;
-        match_info.end_pos      = 0;
-
-        match_info.num_mismatches    = 0;
-        match_info.num_insertions    = 0;
-        match_info.num_deletions     = 0;
-        match_info.num_substitutions = 0;
-
-        if (opts.max_mismatches == 0 && opts.force_tre == 0) {
-//            fprintf(stdout, "Running boyer moore search\n");
-            match_info.substr_start =
-                (char *) boyermoore_search( seq->seq.s, opts.search_pattern );
-            if (match_info.substr_start != NULL) {
-                match_info.substr_end =
-                    match_info.substr_start + strlen(opts.search_pattern);
-                match_info.start_pos =
-                    (int) (match_info.substr_start - seq->seq.s);
-                match_info.end_pos =
-                    (int) ( match_info.start_pos + strlen(opts.search_pattern) );
-            }
-        }
-        else {
-//            fprintf(stdout, "Running TRE search\n");
-            approximate_regexp_search( &opts, &match_info );
-        }
+    //fprintf(stdout, "Mismatch param is %d\n", opts.max_mismatches);
+    report_match_counts(out, input_fastq, &opts, match_counter);
 
-        if ( match_info.substr_start != NULL && opts.invert_match == 0 ) {
-            match_counter++;
-            if (opts.count == 0)
-                report_read( out_fp, &opts, seq, &match_info );
-        }
+    if (stats != NULL) {
+        stats->matches    = (size_t) match_counter;
+        stats->bytes_out  = outbuf_tell(out) - out_start;
+        stats->wall_ticks = stats_now() - start;
+        add_search_stats(&opts, stats, 1);
+    }
 
-        else if ( match_info.substr_start == NULL && opts.invert_match == 1 ) {
-            match_counter++;
-            if (opts.count == 0)
-                report_read( out_fp, &opts, seq, &match_info );
-        }
+    return match_counter;
+}
 
-        else if ( opts.show_all_records == 1 ) {
-            match_counter++;
-            if (opts.count == 0)
-                report_read( out_fp, &opts, seq, &match_info );
-        }
+/*
+   Search the '-1' and '-2' files as one input of read pairs.  Both are
+   read in lockstep (each on its own decompression thread), and the
+   mates of a pair are reported to 'outs[0]' and 'outs[1]' together.
+*/
+int
+search_paired_fastq_files(outbuf **outs, const options opts) {
+    record_source sources[2];
+    char input_name[2 * FASTQ_FILENAME_MAX_LENGTH + 1];
+    int match_counter = 0;
+    search_stats pair_stats, *stats = NULL;
+    stats_ticks start = 0;
+    size_t out_start = 0;
+
+    snprintf(input_name, sizeof(input_name), "%s %s",
+             opts.input_r1, opts.input_r2);
+
+    if (opts.stats_report != NULL) {
+        stats = &pair_stats;
+        stats_clear(stats, input_name);
+        start     = stats_now();
+        out_start = outbuf_tell(outs[0]) +
+                    (outs[1] != outs[0] ? outbuf_tell(outs[1]) : 0);
     }
 
-    kseq_destroy(seq); // destroy seq  
-    gzclose(fp);       // close the file handler  
+    open_record_source(&sources[0], opts.input_r1, &opts);
+    open_record_source(&sources[1], opts.input_r2, &opts);
 
-    //fprintf(stdout, "Mismatch param is %d\n", opts.max_mismatches);
-    if (opts.count == 1) {
-        if (match_counter == 1) {
-            fprintf(out_fp, "%s : %d match\n", input_fastq, match_counter);
-        }
-        else {
-            fprintf(out_fp, "%s : %d matches\n", input_fastq, match_counter);
-        }
+    if (opts.patterns != NULL) {
+        memset(opts.patterns->match_counts, 0,
+               opts.patterns->num_patterns * sizeof(int));
     }
-}
 
-void
-report_read(FILE *out_fp,
-            const options *opts,
-            const kseq_t *seq,
-            const read_match *info) {
-    if (opts->report_fasta) {
-        report_fasta(out_fp, opts, seq, info);
-    }
-    else if (opts->report_stats) {
-        report_stats(out_fp, opts, seq, info);
+    if (opts.num_threads > 1) {
+        match_counter = search_records_threaded(outs, sources, 2, &opts,
+                                                stats);
     }
     else {
-        report_fastq(out_fp, opts, seq, info);
+        match_counter = search_records(outs, sources, 2, &opts, stats);
     }
-}
 
-void
-display_sequence(FILE *out_fp,
-                 const options *opts,
-                 const char *sequence,
-                 const char *substr_start,
-                 const char *substr_end,
-                 const int  start_pos,
-                 const int  end_pos) {
-    if (opts->color == 1) {
-        size_t start, length;
+    if (stats != NULL) {
+        record_source_stats(&sources[0], stats);
+        record_source_stats(&sources[1], stats);
+    }
+    close_record_source(&sources[0]);
+    close_record_source(&sources[1]);
+
+    report_match_counts(outs[0], input_name, &opts, match_counter);
+
+    if (stats != NULL) {
+        stats->matches    = (size_t) match_counter;
+        stats->bytes_out  = outbuf_tell(outs[0]) +
+                            (outs[1] != outs[0] ? outbuf_tell(outs[1]) : 0) -
+                            out_start;
+        stats->wall_ticks = stats_now() - start;
+        add_search_stats(&opts, stats, 2);
+    }
 
-        if (sequence == substr_start) {
-            char *highlight = 
-                substring( sequence, 0, substr_end - sequence );
+    return match_counter;
+}
 
-            start  = substr_end - substr_start;
-            length = strlen(sequence) -
-                     ( substr_end - substr_start );
+/*
+   A '-C' count of single-end input goes to the counting engine, unless
+   the search needs the qualities ('--min-qual') or trims.  With '-t', the
+   engine counts a file per thread, so it is only used when there are at
+   least as many files as threads; fewer files are left to the threaded
+   search, which spreads the matching of a file over all the threads.
+   So is '-q', which is done at the first match of any file.
+*/
+int
+count_only_search(const options *opts, size_t num_inputs) {
+    return opts->count == 1 &&
+           num_inputs > 0 &&
+           opts->trim_pattern == NULL &&
+           opts->qual_match == NULL &&
+           ( opts->num_threads == 1 ||
+             (opts->quiet == 0 &&
+              num_inputs >= (size_t) opts->num_threads) );
+}
 
-            char *remainder =
-                substring( sequence, start, length );
+/*
+   Count the matches of every input file with the sequence-only scanner
+   ('seqscan_next'), which skips the names and qualities rather than
+   parsing whole records.  With '-t', the files are counted side by side,
+   one per thread; the counts are still reported in the input order.
+   Returns the total of the counts.
+*/
+int
+count_input_files(outbuf *out,
+                  char **inputs,
+                  size_t num_inputs,
+                  const options *opts) {
+    options file_opts = *opts;
+    count_pool pool;
+    pthread_t *threads;
+    size_t i, num_threads = (size_t) opts->num_threads;
+    int num_matched = 0;
+
+    /* every file's decompression already runs on its own thread */
+    file_opts.num_threads = 1;
+
+    pool.jobs     = calloc(num_inputs, sizeof(count_job));
+    pool.num_jobs = num_inputs;
+    pool.next_job = 0;
+    if (pool.jobs == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
 
-            fprintf(out_fp, "\033[31m%s\033[0m%s", highlight, remainder);
-            free(highlight);
-            free(remainder);
+    for (i = 0; i < num_inputs; i++) {
+        pool.jobs[i].input = inputs[i];
+        pool.jobs[i].opts  = &file_opts;
+        if (opts->patterns != NULL) {
+            pool.jobs[i].pattern_counts =
+                calloc(opts->patterns->num_patterns, sizeof(int));
+            if (pool.jobs[i].pattern_counts == NULL) {
+                fprintf(stderr, "%s : %s\n",
+                                PRG_NAME, "Trouble with malloc. Out of memory!");
+                exit(EXIT_TROUBLE);
+            }
         }
-        else if (substr_start != NULL) {
-            start  = 0;
-            length = substr_start - sequence;
-            char *begin = substring( sequence, start, length );
-
-            start  = start + length;
-            length = (size_t) (end_pos - start_pos);
-            char *highlight = substring( sequence, start, length );
+    }
 
-            start  = start + length;
-            length = strlen(sequence) - start;
-            char *end = substring( sequence, start, length );
+    if (num_threads == 1) {
+        for (i = 0; i < num_inputs && !(opts->quiet && num_matched); i++) {
+            count_input_file(&pool.jobs[i]);
+            report_count_job(out, &pool.jobs[i], opts);
+            num_matched += pool.jobs[i].match_counter;
+        }
+    }
+    else {
+        if ( (threads = malloc(num_threads * sizeof(pthread_t))) == NULL ) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
 
-            fprintf(out_fp, "%s\033[31m%s\033[0m%s", begin, highlight, end);
-            free(begin);
-            free(highlight);
-            free(end);
+        pthread_mutex_init(&pool.lock, NULL);
+        for (i = 0; i < num_threads; i++) {
+            if ( pthread_create(&threads[i], NULL,
+                                count_worker_thread, &pool) != 0 ) {
+                fprintf(stderr, "%s : [err] Could not start a search thread.\n",
+                                PRG_NAME);
+                exit(EXIT_TROUBLE);
+            }
         }
-        else {
-            fprintf(out_fp, "%s", sequence);
+        for (i = 0; i < num_threads; i++)
+            pthread_join(threads[i], NULL);
+        pthread_mutex_destroy(&pool.lock);
+        free(threads);
+
+        for (i = 0; i < num_inputs; i++) {
+            report_count_job(out, &pool.jobs[i], opts);
+            num_matched += pool.jobs[i].match_counter;
         }
     }
-    else {
-        fprintf(out_fp, "%s", sequence);
+
+    for (i = 0; i < num_inputs; i++) {
+        free(pool.jobs[i].pattern_counts);
+        free(pool.jobs[i].short_read);
     }
+    free(pool.jobs);
+
+    return num_matched;
 }
 
-void
-report_stats(FILE *out_fp,
-             const options *opts,
-             const kseq_t *seq,
-             const read_match *info) {
+void*
+count_worker_thread(void *arg) {
+    count_pool *pool = arg;
 
-    static int header_flag = 0;
-    char *match = NULL;
-    char read_comment[MAX_READ_COMMENT_LENGTH] = "-";
+    for (;;) {
+        count_job *job = NULL;
 
-    /*
-       stat report columns are
-         1. read_name
-         2. read_comments
-         3. mismatches
-         4. num_ins
-         5. num_del
-         6. num_subst
-         7. start_position
-         8. end_position
-         9. match string
-        10. sequence string
-        11. quality string (if available)
-     */
+        pthread_mutex_lock(&pool->lock);
+        if (pool->next_job < pool->num_jobs)
+            job = &pool->jobs[pool->next_job++];
+        pthread_mutex_unlock(&pool->lock);
 
-    if (header_flag == 0) {
-        fprintf(out_fp, "%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s",
-                "read name",
-                opts->delim,
-                "read comments",
-                opts->delim,
-                "total mismatches",
-                opts->delim,
-                "# insertions",
-                opts->delim,
-                "# deletions",
-                opts->delim,
-                "# substitutions",
-                opts->delim,
-                "start position",
-                opts->delim,
-                "end position",
-                opts->delim,
-                "match string",
-                opts->delim,
-                "sequence"
-        );
+        if (job == NULL)
+            break;
+        count_input_file(job);
+    }
 
-         /* quality string portion of header */
-        if (seq->qual.l) {
-            fprintf(out_fp, "%s", opts->delim);
-            fprintf(out_fp, "%s", "quality");
-        }
-        fprintf(out_fp, "\n");
-        header_flag = 1;
-    }
-
-    if (seq->comment.l) {
-        strncpy(read_comment, seq->comment.s, MAX_READ_COMMENT_LENGTH-1);
-    }
-
-    fprintf(out_fp, "%s%s%s%s%d%s%d%s%d%s%d%s%d%s%d%s",
-            seq->name.s,
-            opts->delim,
-            read_comment,
-            opts->delim,
-            info->num_mismatches,
-            opts->delim,
-            info->num_insertions,
-            opts->delim,
-            info->num_deletions,
-            opts->delim,
-            info->num_substitutions,
-            opts->delim,
-            info->start_pos,
-            opts->delim,
-            info->end_pos,
-            opts->delim
-    );
+    return NULL;
+}
 
-    /* match string portion of stats report */
-    size_t start, length;
+/*
+   Count the records of an input that 'process_record' would count.  A
+   read shorter than a '-p' pattern is an error of the full search, which
+   'report_count_job' raises once the counts of the inputs before this one
+   are out.
+*/
+void
+count_input_file(count_job *job) {
+    const options *opts = job->opts;
+    search_stats *stats = NULL;
+    record_source source;
+    seqscan *scan;
+    fastq_record rec;
+    read_match info;
+    pack_seq packed;
+    pack_arena pack = { NULL, 0, 0 };
+    stats_ticks start = 0, t0 = 0, t1 = 0;
+    int matched, transient, ret = 0;
+
+    if (opts->stats_report != NULL) {
+        stats = &job->stats;
+        stats_clear(stats, job->input);
+        start = stats_now();
+    }
 
-    start  = (size_t) info->start_pos;
-    length = (size_t) (info->end_pos - info->start_pos);
+    open_record_source(&source, job->input, opts);
 
-    /* if there is no match -- via the invert_match option */
-    if (info->substr_start == NULL) {
-        fprintf(out_fp, "%s%s", "*", opts->delim);
-    }
-    /* otherwise there is a matching substring to report */
-    else {
-        match = substring( seq->seq.s, start, length );
-        fprintf(out_fp, "%s%s", match, opts->delim);
-        free(match);
+    /* an indexed input's candidate records are read whole */
+    if (source.index != NULL)
+        scan = NULL;
+    else if (source.mapped != NULL)
+        scan = seqscan_open_mapped(source.mapped->data, source.mapped->len);
+    else
+        scan = seqscan_open_stream(source.fp);
+
+    if (scan == NULL && source.index == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
     }
 
-    /* sequence portion of stats report */
-    display_sequence (out_fp,
-                      opts,
-                      seq->seq.s,
-                      info->substr_start,
-                      info->substr_end,
-                      info->start_pos,
-                      info->end_pos);
+    memset(&rec, 0, sizeof(fastq_record));
+
+    while ( !match_limit_reached(opts, job->match_counter) ) {
+        if (stats != NULL)
+            t0 = stats_now();
+        if (scan != NULL)
+            ret = seqscan_next(scan, &rec.seq, &rec.seq_l);
+        else
+            ret = next_record(&source, &rec, &transient);
+        if (ret <= 0)
+            break;
+        if (stats != NULL) {
+            t1 = stats_now();
+            stats->read_ticks += t1 - t0;
+            stats->bases      += rec.seq_l;
+            stats->records++;
+        }
 
-    /* quality string portion of stats report */
-    if (seq->qual.l) {
-        fprintf(out_fp, "%s", opts->delim);
-        fprintf(out_fp, "%s", seq->qual.s);
+        if ( (opts->bm_search != NULL) &&
+             (rec.seq_l < opts->bm_search->needle_len) ) {
+            const char *header = scan ? scan->header : rec.name;
+            size_t header_l = scan ? scan->header_l : rec.name_l;
+            size_t name_l = 0;
+            while ( name_l < header_l &&
+                    !isspace((unsigned char) header[name_l]) )
+                name_l++;
+            job->short_read   = stringn_duplicate(header, name_l);
+            job->short_read_l = rec.seq_l;
+            break;
+        }
+
+        if (opts->pack != NULL)
+            pack_records(opts, &pack, &rec, &packed, 1);
+        match_record(opts, &rec, &info);
+        matched = info.substr_start != NULL;
+
+        if ( (matched && opts->invert_match == 0) ||
+             (!matched && opts->invert_match == 1) ||
+             (opts->show_all_records == 1) ) {
+            job->match_counter++;
+            if (job->pattern_counts != NULL && info.pattern_idx >= 0)
+                job->pattern_counts[info.pattern_idx]++;
+        }
+
+        if (stats != NULL)
+            stats->match_ticks += stats_now() - t1;
     }
 
-    /* termination of record line */
-    fprintf(out_fp, "\n");
+    if (ret == -1) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+    if (ret == -2) {
+        fprintf(stderr, "%s : [err] Could not decompress the input.\n",
+                        PRG_NAME);
+        exit(EXIT_TROUBLE);
+    }
+
+    if (stats != NULL) {
+        if (ret == 0)
+            stats->read_ticks += stats_now() - t0;
+        record_source_stats(&source, stats);
+    }
+    seqscan_close(scan);
+    close_record_source(&source);
+    pack_arena_free(&pack);
+
+    if (stats != NULL)
+        stats->wall_ticks = stats_now() - start;
 }
 
+/* report a counted input, as 'search_input_fastq_file' reports it */
 void
-report_fasta(FILE *out_fp,
-             const options *opts,
-             const kseq_t *seq,
-             const read_match *info) {
-    /* header portion of FASTA read record */
-    if (seq->comment.l) {
-        fprintf(out_fp, ">%s %s\n", seq->name.s, seq->comment.s);
+report_count_job(outbuf *out, count_job *job, const options *opts) {
+    size_t out_start = outbuf_tell(out);
+
+    if (job->short_read != NULL) {
+        outbuf_flush(out);
+        fprintf(stderr, "%s : %s '%s' %s (%zd) %s (%zd).\n",
+                        PRG_NAME,
+                        "[err] For sequence ",
+                        job->short_read,
+                        "search pattern length",
+                        opts->bm_search->needle_len,
+                        "exceeds sequence length",
+                        job->short_read_l );
+        exit(EXIT_TROUBLE);
     }
-    else {
-        fprintf(out_fp, ">%s\n", seq->name.s);
+
+    if (opts->patterns != NULL) {
+        memcpy(opts->patterns->match_counts, job->pattern_counts,
+               opts->patterns->num_patterns * sizeof(int));
     }
 
-    /* sequence portion of FASTA read record */
-    display_sequence (out_fp,
-                      opts,
-                      seq->seq.s,
-                      info->substr_start,
-                      info->substr_end,
-                      info->start_pos,
-                      info->end_pos);
-    fprintf(out_fp, "\n");
+    report_match_counts(out, job->input, opts, job->match_counter);
+
+    if (opts->stats_report != NULL) {
+        job->stats.matches   = (size_t) job->match_counter;
+        job->stats.bytes_out = outbuf_tell(out) - out_start;
+        add_search_stats(opts, &job->stats, 1);
+    }
 }
 
 void
-report_fastq(FILE *out_fp,
-             const options *opts,
-             const kseq_t *seq,
-             const read_match *info) {
+open_record_source(record_source *source,
+                   const char *input_fastq,
+                   const options *opts) {
+    source->seq    = NULL;
+    source->mapped = NULL;
+    source->index  = NULL;
+    source->fp     = NULL;
 
-    /* header portion of FASTQ read record */
-    if (seq->comment.l) {
-        fprintf(out_fp, "@%s %s\n", seq->name.s, seq->comment.s);
+    // open the file handler
+    if ( strcmp(input_fastq, "-") == 0 ) {
+        source->fd = fileno(stdin);
     }
     else {
-        fprintf(out_fp, "@%s\n", seq->name.s);
+        source->fd = open(input_fastq, O_RDONLY);
     }
 
-    /* sequence portion of FASTQ read record */
-    display_sequence (out_fp,
-                      opts,
-                      seq->seq.s,
-                      info->substr_start,
-                      info->substr_end,
-                      info->start_pos,
-                      info->end_pos);
-    fprintf(out_fp, "\n");
+    if ( (source->fd < 0) && (strcmp(input_fastq, "-") != 0) ) {
+        fprintf(stderr, "%s : [err] Could not open FASTQ '%s' for reading.\n",
+                        PRG_NAME, input_fastq);
+        exit(EXIT_TROUBLE);
+    }
 
-    /* comment portion of FASTQ read record */
-    fprintf(out_fp, "+\n");
+    if ( (source->fd < 0) && (strcmp(input_fastq, "-") == 0) ) {
+        fprintf(stderr, "%s : [err] Could not open stdin for reading.\n",
+                        PRG_NAME);
+        exit(EXIT_TROUBLE);
+    }
 
-    /* quality portion of FASTQ read record */
-    if (seq->qual.l) {
-        fprintf(out_fp, "%s\n", seq->qual.s);
+    /*
+       an indexed input is read only where the patterns may be, unless
+       the search stops at a read shorter than the pattern
+    */
+    if ( opts->num_index_patterns > 0 && strcmp(input_fastq, "-") != 0 &&
+         (source->index = fqindex_open(input_fastq, source->fd)) != NULL ) {
+        if ( (opts->bm_search == NULL ||
+              source->index->header->min_seq_length >=
+                  opts->bm_search->needle_len) &&
+             fqindex_select(source->index,
+                            opts->index_patterns,
+                            opts->num_index_patterns,
+                            opts->max_mismatches) )
+            return;
+        fqindex_close(source->index);
+        source->index = NULL;
+    }
+
+    // map plain files, otherwise decompress in the background
+    if ( strcmp(input_fastq, "-") != 0 ) {
+        source->mapped = mapfq_open(source->fd);
+    }
+
+    if (source->mapped == NULL) {
+        source->fp = pgz_open(source->fd, opts->num_threads);
+        if (source->fp == NULL) {
+            fprintf(stderr, "%s : [err] Could not start reading '%s'.\n",
+                            PRG_NAME, input_fastq);
+            exit(EXIT_TROUBLE);
+        }
+
+        // initialize seq
+        source->seq = kseq_init(source->fp);
+    }
+}
+
+void
+close_record_source(record_source *source) {
+    if (source->index != NULL) {
+        fqindex_close(source->index);
+    }
+    else if (source->mapped != NULL) {
+        mapfq_close(source->mapped);
     }
     else {
-        fprintf(out_fp, "\n");
+        kseq_destroy(source->seq); // destroy seq  
+        pgz_close(source->fp);     // stop the decompression threads  
+    }
+    if (source->fd != fileno(stdin)) {
+        close(source->fd);         // close the file handler  
     }
 }
 
+/* the '-C' totals of an input */
 void
-setup_tre(regaparams_t *params, regex_t *regexp, options *opts) {
-    /* Step 1: setup the TRE regexp matching parameters */
+report_match_counts(outbuf *out,
+                    const char *input_name,
+                    const options *opts,
+                    int match_counter) {
+    if (opts->quiet)
+        return;
 
-    /* setup the default match parameters */
-    tre_regaparams_default(params);
+    if (opts->count == 1) {
+        outbuf_puts(out, input_name);
+        outbuf_puts(out, " : ");
+        outbuf_put_int(out, match_counter);
+        outbuf_puts(out, match_counter == 1 ? " match\n" : " matches\n");
+    }
 
-    /* Set the maximum number of errors allowed for a record to match. */
-    params->max_cost = opts->max_mismatches;
+    /* the per pattern totals of a pattern file search */
+    if (opts->count == 1 && opts->patterns != NULL) {
+        size_t i;
+        for (i = 0; i < opts->patterns->num_patterns; i++) {
+            int count = opts->patterns->match_counts[i];
+            outbuf_puts(out, input_name);
+            outbuf_puts(out, " : ");
+            outbuf_puts(out, opts->patterns->names[i]);
+            outbuf_puts(out, " : ");
+            outbuf_put_int(out, count);
+            outbuf_puts(out, count == 1 ? " match\n" : " matches\n");
+        }
+    }
+}
 
-    /* Set the insertion, deletion, substitution costs. */
-    params->cost_ins = opts->cost_insertions;
-    params->cost_del = opts->cost_deletions;
-    params->cost_subst = opts->cost_substitutions;
+/* how an input was read, and what it took; before the input is closed */
+void
+record_source_stats(record_source *source, search_stats *stats) {
+    const char *format = "plain (mapped)";
+
+    if (source->index != NULL) {
+        format = source->index->header->bgzf ? "bgzf (indexed)"
+                                             : "plain (indexed)";
+        stats->bytes_in           += source->index->bytes_in;
+        stats->bytes_decompressed += source->index->bytes_out;
+    }
+    else if (source->mapped != NULL) {
+        stats->bytes_in           += source->mapped->len;
+        stats->bytes_decompressed += source->mapped->len;
+    }
+    else {
+        size_t bytes_in, bytes_out;
+        double wait;
 
-    /* Set the max insertion, deletion, substitution allowances. */
-    params->max_ins = opts->max_insertions;
-    params->max_del = opts->max_deletions;
-    params->max_subst = opts->max_substitutions;
+        switch (pgz_format(source->fp)) {
+            case PGZ_BGZF:
+                format = "bgzf";
+                break;
+            case PGZ_GZIP:
+                format = "gzip";
+                break;
+            default:
+                format = "plain";
+        }
 
-    /* Step 2: compile the regex */
+        pgz_stats(source->fp, &bytes_in, &bytes_out, &wait);
+        stats->bytes_in           += bytes_in;
+        stats->bytes_decompressed += bytes_out;
+        stats->inflate_wait       += wait;
+    }
 
-    /*
-       always allowing for POSIX extended regular expression syntax
-       (REG_EXTENDED)
-       always being case insenstive with the regular expression
-       (REG_ICASE)
-    */
-    int errcode;
-    int comp_flags  = REG_EXTENDED | REG_ICASE ;
-    errcode = tre_regcomp(regexp, opts->search_pattern, comp_flags);
-    if (errcode) {
-        char errbuf[256];
-        tre_regerror(errcode, regexp, errbuf, sizeof(errbuf));
-        fprintf(stderr, "%s: %s: -- %s -- %s\n",
-          PRG_NAME,
-              "Error in compiling search pattern",
-              opts->search_pattern,
-              errbuf
-        );
-        exit(1);
+    /* the mates of a pair may be stored differently */
+    if ( strcmp(stats->format, "-") == 0 || strcmp(stats->format, format) == 0 )
+        stats->format = format;
+    else
+        stats->format = "mixed";
+}
+
+/* the search engine picked in 'main' */
+const char*
+matcher_name(const options *opts) {
+    if (opts->demux != NULL)
+        return "barcode table";
+    if (opts->trim_pattern != NULL)
+        return "anchored bit-parallel (trim)";
+    if (opts->qual_match != NULL)
+        return "quality-aware";
+    if (opts->aho != NULL)
+        return "aho-corasick";
+    if (opts->pigeon != NULL)
+        return "pigeonhole";
+    if (opts->pack != NULL)
+        return opts->pack_match_case ? "packed 2-bit" : "hamming (packed 2-bit)";
+    if (opts->bm_search != NULL)
+        return "boyer-moore";
+    if (opts->myers != NULL)
+        return opts->myers_max_edits == 0 ? "shift-and" : "bit-parallel";
+    return "tre";
+}
+
+void
+add_search_stats(const options *opts, search_stats *stats, size_t num_mates) {
+    /* a mate that the '--pair-match' policy ignores is not searched */
+    size_t searched = num_mates;
+    if ( num_mates == 2 &&
+         (opts->pair_match == PAIR_MATCH_R1 ||
+          opts->pair_match == PAIR_MATCH_R2) )
+        searched = 1;
+
+    stats->matcher  = matcher_name(opts);
+    stats->searches = stats->records / num_mates * searched;
+
+    if ( !stats_report_add(opts->stats_report, stats) ) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
     }
+}
 
-    /* Step 3: assign to opts hash */
-    opts->tre_regex = regexp;
-    opts->tre_regex_match_params = params;
+/* the read() function for kseq; corrupt or truncated input is fatal */
+int
+read_input(pgz_reader *fp, void *buf, unsigned int len) {
+    int n = pgz_read(fp, buf, len);
+
+    if (n < 0) {
+        fprintf(stderr, "%s : [err] Could not decompress the input.\n",
+                        PRG_NAME);
+        exit(EXIT_TROUBLE);
+    }
+
+    return n;
+}
+
+/* true once an input has had all of the '-n' matches */
+int
+match_limit_reached(const options *opts, int match_counter) {
+    return opts->max_matches > 0 && match_counter >= opts->max_matches;
+}
+
+int
+search_records(outbuf **outs,
+               record_source *sources,
+               size_t num_mates,
+               const options *opts,
+               search_stats *stats) {
+    int transient[2], match_counter = 0;
+    fastq_record records[2];
+    read_match match_info[2];
+    pack_seq packed[2];
+    pack_arena pack = { NULL, 0, 0 };
+    stats_ticks t0, t1, t2, t3;
+    size_t i;
+
+    if (stats == NULL) {
+        while ( !match_limit_reached(opts, match_counter) &&
+                next_records(sources, num_mates, records, transient) ) {
+            if (opts->pack != NULL)
+                pack_records(opts, &pack, records, packed, num_mates);
+            match_records(opts, records, match_info, num_mates);
+            match_counter += process_record(outs, opts,
+                                            records, match_info, num_mates);
+        }
+        pack_arena_free(&pack);
+        return match_counter;
+    }
+
+    /* the same, with every stage timed */
+    while ( !match_limit_reached(opts, match_counter) ) {
+        t0 = stats_now();
+        if ( !next_records(sources, num_mates, records, transient) ) {
+            stats->read_ticks += stats_now() - t0;
+            break;
+        }
+        t1 = stats_now();
+        if (opts->pack != NULL)
+            pack_records(opts, &pack, records, packed, num_mates);
+        match_records(opts, records, match_info, num_mates);
+        t2 = stats_now();
+        match_counter += process_record(outs, opts,
+                                        records, match_info, num_mates);
+        t3 = stats_now();
+
+        stats->read_ticks   += t1 - t0;
+        stats->match_ticks  += t2 - t1;
+        stats->report_ticks += t3 - t2;
+        for (i = 0; i < num_mates; i++)
+            stats->bases += records[i].seq_l;
+        stats->records += num_mates;
+    }
+
+    pack_arena_free(&pack);
+    return match_counter;
+}
+
+/*
+   Read the next record of the input into 'rec'.  Returns 0 at the end of
+   the input.  'transient' is set if the record's fields are only valid
+   until the next call (rather than for as long as the input is open).
+*/
+int
+next_record(record_source *source, fastq_record *rec, int *transient) {
+    if (source->index != NULL) {
+        mapfq_record mrec;
+        int ret = fqindex_read(source->index, &mrec);
+
+        if (ret == -1) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+        if (ret == -2) {
+            fprintf(stderr, "%s : [err] Could not read the input at the "
+                            "offsets of its index.\n", PRG_NAME);
+            exit(EXIT_TROUBLE);
+        }
+        if (ret == 0)
+            return 0;
+
+        mapfq_to_record(&mrec, rec);
+        *transient = mrec.transient;
+        return 1;
+    }
+
+    if (source->mapped != NULL) {
+        mapfq_record mrec;
+        int ret = mapfq_read(source->mapped, &mrec);
+
+        if (ret < 0) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+        if (ret == 0)
+            return 0;
+
+        mapfq_to_record(&mrec, rec);
+        *transient = mrec.transient;
+        return 1;
+    }
+
+    if (kseq_read(source->seq) < 0)
+        return 0;
+
+    kseq_to_record(source->seq, rec);
+    *transient = 1;
+    return 1;
+}
+
+/*
+   Read the next record of each mate's input.  Returns 0 at the end of
+   the input(s); the mates' inputs have to end together, and the names of
+   the mates of a pair have to agree.
+*/
+int
+next_records(record_source *sources,
+             size_t num_mates,
+             fastq_record *recs,
+             int *transient) {
+    int more;
+
+    more = next_record(&sources[0], &recs[0], &transient[0]);
+    if (num_mates == 1)
+        return more;
+
+    if ( more != next_record(&sources[1], &recs[1], &transient[1]) ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] The '-1' and '-2' inputs hold different "
+                        "numbers of reads!");
+        exit(EXIT_TROUBLE);
+    }
+
+    if ( more && !mate_names_agree(&recs[0], &recs[1]) ) {
+        fprintf(stderr, "%s : [err] Reads '%.*s' and '%.*s' of the '-1' and "
+                        "'-2' inputs are not mates!\n",
+                        PRG_NAME,
+                        (int) recs[0].name_l, recs[0].name,
+                        (int) recs[1].name_l, recs[1].name);
+        exit(EXIT_TROUBLE);
+    }
+
+    return more;
+}
+
+/* mates share a name, apart from an optional '/1' and '/2' suffix */
+int
+mate_names_agree(const fastq_record *r1, const fastq_record *r2) {
+    size_t l1 = r1->name_l;
+    size_t l2 = r2->name_l;
+
+    if ( l1 >= 2 && r1->name[l1 - 2] == '/' && r1->name[l1 - 1] == '1' &&
+         l2 >= 2 && r2->name[l2 - 2] == '/' && r2->name[l2 - 1] == '2' ) {
+        l1 -= 2;
+        l2 -= 2;
+    }
+
+    return l1 == l2 && memcmp(r1->name, r2->name, l1) == 0;
 }
 
 void
-approximate_regexp_search(const options *opts, read_match *info) {
-    int errcode;
-    regmatch_t pmatch = { 0, 0 };     /* matched pattern structure */
-    regamatch_t match;                /* overall match structure */
+kseq_to_record(const kseq_t *seq, fastq_record *rec) {
+    rec->name      = seq->name.s;
+    rec->name_l    = seq->name.l;
+    rec->comment   = seq->comment.s;
+    rec->comment_l = seq->comment.l;
+    rec->seq       = seq->seq.s;
+    rec->seq_l     = seq->seq.l;
+    rec->qual      = seq->qual.s;
+    rec->qual_l    = seq->qual.l;
+    rec->raw       = NULL;
+    rec->raw_l     = 0;
+    rec->packed    = NULL;
+}
 
-    /* initialize the overall match struct */
-    memset(&match, 0, sizeof(match));
-    /* assign default pattern structure */
-    match.pmatch = &pmatch;
-    /* initialization of pmatch array */
-    match.nmatch = 1;
+void
+mapfq_to_record(const mapfq_record *mrec, fastq_record *rec) {
+    rec->name      = mrec->name;
+    rec->name_l    = mrec->name_l;
+    rec->comment   = mrec->comment;
+    rec->comment_l = mrec->comment_l;
+    rec->seq       = mrec->seq;
+    rec->seq_l     = mrec->seq_l;
+    rec->qual      = mrec->qual;
+    rec->qual_l    = mrec->qual_l;
+    rec->raw       = mrec->raw;
+    rec->raw_l     = mrec->raw_l;
+    rec->packed    = NULL;
+}
 
-    /* perform the regexp search on the sequence string */
-    errcode = tre_regaexec(
-            opts->tre_regex,
-            info->sequence,
-            &match,
-            *(opts->tre_regex_match_params),
-            0
-    );
+void
+clear_match(const fastq_record *rec, read_match *info) {
+    info->sequence     = (char *) rec->seq;
+    info->substr_start = NULL;
+    info->substr_end   = NULL;
+    info->start_pos    = 0;
+    info->end_pos      = 0;
+
+    info->num_mismatches    = 0;
+    info->num_insertions    = 0;
+    info->num_deletions     = 0;
+    info->num_substitutions = 0;
+    info->pattern_idx       = -1;
+    info->strand            = '+';
+    info->weighted_cost     = 0;
+}
 
-    if (errcode != REG_OK) {
-//        fprintf(stdout, "Found no matches!\n");
-//        fprintf(stdout, "%6s : %s\n", "regexp", opts->search_pattern);
-//        fprintf(stdout, "%6s : %s\n", "record", sequence);
-        return;
+void
+match_record(const options *opts, const fastq_record *rec, read_match *info) {
+    /* initialize the match info structure */
+    clear_match(rec, info);
+
+    if (opts->demux != NULL) {
+        demux_search( opts, info, rec->seq_l );
+    }
+    else if (opts->trim_pattern != NULL) {
+        anchored_adapter_search( opts, info, rec->seq_l );
+    }
+    else if (opts->qual_match != NULL) {
+        quality_aware_search( opts, info, rec );
+    }
+    else if (opts->aho != NULL) {
+        multi_pattern_search( opts, info, rec->seq_l );
+    }
+    else if (opts->pigeon != NULL) {
+        approximate_multi_pattern_search( opts, info, rec->seq_l );
     }
+    else if (opts->pack != NULL) {
+        packed_search( opts, info, rec );
+    }
+    else if (opts->bm_search != NULL) {
+//        fprintf(stdout, "Running boyer moore search\n");
+        if (opts->bm_search_rc != NULL) {
+            int which;
+            info->substr_start =
+                (char *) bm_searcher_search_either( opts->bm_search,
+                                                    opts->bm_search_rc,
+                                                    rec->seq,
+                                                    rec->seq_l,
+                                                    &which );
+            if (which == 1)
+                info->strand = '-';
+        }
+        else {
+            info->substr_start =
+                (char *) bm_searcher_search( opts->bm_search,
+                                             rec->seq,
+                                             rec->seq_l );
+        }
+        if (info->substr_start != NULL) {
+            info->substr_end =
+                info->substr_start + opts->bm_search->needle_len;
+            info->start_pos =
+                (int) (info->substr_start - rec->seq);
+            info->end_pos =
+                (int) ( info->start_pos + opts->bm_search->needle_len );
+        }
+    }
+    else if (opts->myers != NULL) {
+        approximate_myers_search( opts, info, rec->seq_l );
+    }
+    else {
+//        fprintf(stdout, "Running TRE search\n");
+        approximate_regexp_search( opts, info, rec->seq_l );
+    }
+}
 
-    /* found a match! */
+/*
+   Match the mates of a read pair (or just the one record), leaving out
+   a mate that the '--pair-match' policy pays no attention to.
+*/
+void
+match_records(const options *opts,
+              const fastq_record *recs,
+              read_match *infos,
+              size_t num_mates) {
+    size_t i;
+
+    for (i = 0; i < num_mates; i++) {
+        if ( num_mates == 2 &&
+             ( (i == 0 && opts->pair_match == PAIR_MATCH_R2) ||
+               (i == 1 && opts->pair_match == PAIR_MATCH_R1) ) )
+            clear_match(&recs[i], &infos[i]);
+        else
+            match_record(opts, &recs[i], &infos[i]);
+    }
+}
 
-    info->num_mismatches    = match.cost;
-    info->num_insertions    = match.num_ins;
-    info->num_deletions     = match.num_del;
-    info->num_substitutions = match.num_subst;
-    info->start_pos         = pmatch.rm_so;
-    info->end_pos           = pmatch.rm_eo;
+/* true if the record (pair) matches, as per the '--pair-match' policy */
+int
+records_match(const options *opts, const read_match *infos, size_t num_mates) {
+    int r1 = infos[0].substr_start != NULL;
+    int r2;
+
+    if (num_mates == 1)
+        return r1;
+
+    r2 = infos[1].substr_start != NULL;
+    switch (opts->pair_match) {
+        case PAIR_MATCH_BOTH:
+            return r1 && r2;
+        case PAIR_MATCH_R1:
+            return r1;
+        case PAIR_MATCH_R2:
+            return r2;
+        default:
+            return r1 || r2;
+    }
+}
 
-    info->substr_start      = info->sequence + (size_t) info->start_pos;
-    info->substr_end        = info->substr_start + (size_t) info->end_pos;
+/*
+   'process_record' is run on every record (or read pair), in input
+   order, after it has been matched.  It returns 1 if the record counts
+   towards the match total (and reports it if needed), otherwise 0.  The
+   mates of a pair are reported to their own outputs.
+*/
+int
+process_record(outbuf **outs,
+               const options *opts,
+               const fastq_record *recs,
+               const read_match *infos,
+               size_t num_mates) {
+    int matched;
+    size_t i;
+
+    for (i = 0; i < num_mates; i++) {
+        const fastq_record *rec = &recs[i];
+
+        if ( (opts->bm_search != NULL) &&
+             (rec->seq_l < opts->bm_search->needle_len) ) {
+            outbuf_flush(outs[0]);
+            outbuf_flush(outs[num_mates - 1]);
+            fprintf(stderr, "%s : %s '%.*s' %s (%zd) %s (%zd).\n",
+                            PRG_NAME,
+                            "[err] For sequence ",
+                            (int) rec->name_l,
+                            rec->name,
+                            "search pattern length",
+                            opts->bm_search->needle_len,
+                            "exceeds sequence length",
+                            rec->seq_l );
+            exit(EXIT_TROUBLE);
+        }
+    }
 
-//    fprintf(stdout, "Found match!\n");
-//    fprintf(stdout, "\t%10s : %s\n", "record", info->sequence);
-//    fprintf(stdout, "\t%10s : %s\n", "pattern", opts->search_pattern);
-//    fprintf(stdout, "\t%10s : %4d\n", "cost", match.cost);
-//    fprintf(stdout, "\t%10s : %4d\n", "num_ins", match.num_ins);
-//    fprintf(stdout, "\t%10s : %4d\n", "num_del", match.num_del);
-//    fprintf(stdout, "\t%10s : %4d\n", "num_subst", match.num_subst);
-//    fprintf(stdout, "\t%10s : %2d - %2d\n", "char pos",
-//                                            pmatch.rm_so, pmatch.rm_eo);
+    matched = records_match(opts, infos, num_mates);
+
+    /* adapter trimming routes every read to the trimming outputs instead */
+    if (opts->trim_report != NULL) {
+        trim_record(opts, &recs[0], &infos[0]);
+        return matched;
+    }
+
+    /* and demultiplexing to the output of its sample */
+    if (opts->demux != NULL) {
+        demux_record(opts, &recs[0], &infos[0]);
+        return matched;
+    }
 
+    if ( (matched && opts->invert_match == 0) ||
+         (!matched && opts->invert_match == 1) ||
+         (opts->show_all_records == 1) ) {
+        for (i = 0; i < num_mates && opts->count == 0; i++)
+            report_read( outs[i], opts, &recs[i], &infos[i] );
+
+        /* a pair counts towards the pattern its first matching mate hit */
+        for (i = 0; i < num_mates && opts->patterns != NULL; i++) {
+            if (infos[i].pattern_idx >= 0) {
+                opts->patterns->match_counts[infos[i].pattern_idx]++;
+                break;
+            }
+        }
+        return 1;
+    }
+
+    return 0;
 }
 
-char* 
-substring(const char *str, size_t start, size_t len) {
-    char *substr;
+/*
+   The threaded search is a three stage pipeline:
+
+     reader  -- parses records into a record batch ('fill_record_batch');
+                 records that only live until the next read (all of
+                 kseq's) are copied into the batch's own buffer
+     workers -- run the matcher over every record of a filled batch
+     writer  -- the calling thread; takes matched batches back in their
+                 original input order and reports them
+
+   A fixed pool of batches is recycled between the stages, which bounds
+   the memory in use and throttles the reader when the workers or the
+   writer fall behind.  Because the writer consumes batches strictly by
+   sequence number, the output is identical to the serial search.
+
+   Once the writer has reported the '-n' matches, it marks the pipeline
+   as stopped: the reader reads no further batch, and the workers pass
+   the batches left in flight along unmatched, so the search (and the
+   decompression behind it) ends within a batch.
+*/
+void
+batch_queue_init(batch_queue *queue, size_t capacity) {
+    queue->items = malloc(capacity * sizeof(record_batch *));
+    if (queue->items == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+    queue->capacity = capacity;
+    queue->head     = 0;
+    queue->count    = 0;
+    queue->closed   = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+}
 
-    if (str == NULL 
-        || strlen(str) == 0 
-        || strlen(str) < start 
-        || strlen(str) < (start+len))
-    return NULL;
+void
+batch_queue_destroy(batch_queue *queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+    free(queue->items);
+}
+
+/* the queues are sized to hold every batch so a push never blocks */
+void
+batch_queue_push(batch_queue *queue, record_batch *batch) {
+    pthread_mutex_lock(&queue->lock);
+    queue->items[(queue->head + queue->count) % queue->capacity] = batch;
+    queue->count++;
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* returns NULL once the queue is closed and drained */
+record_batch*
+batch_queue_pop(batch_queue *queue) {
+    record_batch *batch = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed)
+        pthread_cond_wait(&queue->cond, &queue->lock);
+
+    if (queue->count > 0) {
+        batch = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return batch;
+}
+
+void
+batch_queue_close(batch_queue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+size_t
+batch_arena_append(record_batch *batch, const char *str, size_t len) {
+    size_t offset = batch->arena_len;
+
+    if (batch->arena_len + len + 1 > batch->arena_cap) {
+        size_t cap = batch->arena_cap ? batch->arena_cap : 65536;
+        while (batch->arena_len + len + 1 > cap)
+            cap *= 2;
+        if ( (batch->arena = realloc(batch->arena, cap)) == NULL ) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+        batch->arena_cap = cap;
+    }
+
+    if (len)
+        memcpy(batch->arena + offset, str, len);
+    batch->arena[offset + len] = '\0';
+    batch->arena_len += len + 1;
+
+    return offset;
+}
+
+/*
+   Returns 0 once the input is exhausted.  The mates of a read pair are
+   stored one after the other.
+*/
+int
+fill_record_batch(record_source *sources,
+                  size_t num_mates,
+                  record_batch *batch) {
+    size_t i, mate;
+    size_t offsets[RECORD_BATCH_SIZE][4];
+    int copied[RECORD_BATCH_SIZE];
+
+    batch->num_records = 0;
+    batch->arena_len   = 0;
+
+    while ( batch->num_records + num_mates <= RECORD_BATCH_SIZE &&
+            next_records(sources, num_mates,
+                         &batch->records[batch->num_records],
+                         &copied[batch->num_records]) ) {
+        for (mate = 0; mate < num_mates; mate++) {
+            fastq_record *rec = &batch->records[batch->num_records];
+
+            if (copied[batch->num_records]) {
+                /* the arena may move while filling, so only note offsets */
+                offsets[batch->num_records][0] =
+                    batch_arena_append(batch, rec->name, rec->name_l);
+                offsets[batch->num_records][1] =
+                    batch_arena_append(batch, rec->comment, rec->comment_l);
+                offsets[batch->num_records][2] =
+                    batch_arena_append(batch, rec->seq, rec->seq_l);
+                offsets[batch->num_records][3] =
+                    batch_arena_append(batch, rec->qual, rec->qual_l);
+                rec->raw = NULL;
+            }
+            batch->num_records++;
+        }
+    }
+
+    for (i = 0; i < batch->num_records; i++) {
+        fastq_record *rec = &batch->records[i];
+        if (!copied[i])
+            continue;
+        rec->name    = batch->arena + offsets[i][0];
+        rec->comment = batch->arena + offsets[i][1];
+        rec->seq     = batch->arena + offsets[i][2];
+        rec->qual    = batch->arena + offsets[i][3];
+    }
+
+    return batch->num_records + num_mates > RECORD_BATCH_SIZE;
+}
+
+int
+search_stopped(search_pipeline *pipeline) {
+    int stopped;
+
+    pthread_mutex_lock(&pipeline->done_lock);
+    stopped = pipeline->stopped;
+    pthread_mutex_unlock(&pipeline->done_lock);
+
+    return stopped;
+}
+
+void*
+search_reader_thread(void *arg) {
+    search_pipeline *pipeline = arg;
+    record_batch *batch;
+    size_t seqno = 0;
+    int more = 1;
+
+    while ( more && (batch = batch_queue_pop(&pipeline->free_batches)) ) {
+        stats_ticks t0 = pipeline->stats ? stats_now() : 0;
+
+        if (search_stopped(pipeline))
+            break;
+
+        more = fill_record_batch(pipeline->sources, pipeline->num_mates,
+                                 batch);
+
+        /* only the reader thread touches the read counters */
+        if (pipeline->stats != NULL) {
+            size_t i;
+            pipeline->stats->read_ticks += stats_now() - t0;
+            pipeline->stats->records    += batch->num_records;
+            for (i = 0; i < batch->num_records; i++)
+                pipeline->stats->bases += batch->records[i].seq_l;
+        }
+
+        if (batch->num_records == 0) {
+            batch_queue_push(&pipeline->free_batches, batch);
+            break;
+        }
+        batch->seqno = seqno++;
+        batch_queue_push(&pipeline->filled_batches, batch);
+    }
+
+    /* let the writer know how many batches to expect */
+    pthread_mutex_lock(&pipeline->done_lock);
+    pipeline->total_batches = seqno;
+    pthread_cond_broadcast(&pipeline->done_cond);
+    pthread_mutex_unlock(&pipeline->done_lock);
+
+    batch_queue_close(&pipeline->filled_batches);
+    return NULL;
+}
+
+void*
+search_worker_thread(void *arg) {
+    search_pipeline *pipeline = arg;
+    record_batch *batch;
+    size_t i;
+
+    while ( (batch = batch_queue_pop(&pipeline->filled_batches)) ) {
+        stats_ticks t0 = pipeline->stats ? stats_now() : 0;
+        size_t num_records = search_stopped(pipeline) ? 0 : batch->num_records;
+
+        if (pipeline->opts->pack != NULL)
+            pack_records(pipeline->opts, &batch->pack,
+                         batch->records, batch->packed, num_records);
+
+        for (i = 0; i < num_records; i += pipeline->num_mates) {
+            match_records(pipeline->opts,
+                          &batch->records[i],
+                          &batch->matches[i],
+                          pipeline->num_mates);
+        }
+
+        pthread_mutex_lock(&pipeline->done_lock);
+        if (pipeline->stats != NULL)
+            pipeline->stats->match_ticks += stats_now() - t0;
+        pipeline->done[batch->seqno % pipeline->num_batches] = batch;
+        pthread_cond_broadcast(&pipeline->done_cond);
+        pthread_mutex_unlock(&pipeline->done_lock);
+    }
+
+    return NULL;
+}
+
+int
+search_records_threaded(outbuf **outs,
+                        record_source *sources,
+                        size_t num_mates,
+                        const options *opts,
+                        search_stats *stats) {
+    search_pipeline pipeline;
+    pthread_t reader;
+    pthread_t *workers;
+    record_batch *batch;
+    size_t i, next, slot;
+    int match_counter = 0;
+    stats_ticks t0;
+
+    pipeline.sources       = sources;
+    pipeline.num_mates     = num_mates;
+    pipeline.opts          = opts;
+    pipeline.num_batches   = 4 * (size_t) opts->num_threads;
+    pipeline.total_batches = SIZE_MAX;
+    pipeline.stopped       = 0;
+    pipeline.stats         = stats;
+    pipeline.batches = calloc(pipeline.num_batches, sizeof(record_batch));
+    pipeline.done    = calloc(pipeline.num_batches, sizeof(record_batch *));
+    workers = malloc(opts->num_threads * sizeof(pthread_t));
+    if (pipeline.batches == NULL || pipeline.done == NULL || workers == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+
+    batch_queue_init(&pipeline.free_batches, pipeline.num_batches);
+    batch_queue_init(&pipeline.filled_batches, pipeline.num_batches);
+    pthread_mutex_init(&pipeline.done_lock, NULL);
+    pthread_cond_init(&pipeline.done_cond, NULL);
+
+    for (i = 0; i < pipeline.num_batches; i++)
+        batch_queue_push(&pipeline.free_batches, &pipeline.batches[i]);
+
+    if (pthread_create(&reader, NULL, search_reader_thread, &pipeline) != 0) {
+        fprintf(stderr, "%s : [err] Could not create reader thread.\n",
+                        PRG_NAME);
+        exit(EXIT_TROUBLE);
+    }
+    for (i = 0; i < (size_t) opts->num_threads; i++) {
+        if (pthread_create(&workers[i], NULL,
+                           search_worker_thread, &pipeline) != 0) {
+            fprintf(stderr, "%s : [err] Could not create worker thread.\n",
+                            PRG_NAME);
+            exit(EXIT_TROUBLE);
+        }
+    }
+
+    /* writer: report the matched batches in their original input order */
+    for (next = 0; ; next++) {
+        slot = next % pipeline.num_batches;
+
+        pthread_mutex_lock(&pipeline.done_lock);
+        while (pipeline.done[slot] == NULL && next < pipeline.total_batches)
+            pthread_cond_wait(&pipeline.done_cond, &pipeline.done_lock);
+        batch = pipeline.done[slot];
+        pipeline.done[slot] = NULL;
+        pthread_mutex_unlock(&pipeline.done_lock);
+
+        if (batch == NULL)
+            break;
+
+        t0 = stats ? stats_now() : 0;
+        for (i = 0; i < batch->num_records &&
+                    !match_limit_reached(opts, match_counter); i += num_mates) {
+            match_counter += process_record(outs, opts,
+                                            &batch->records[i],
+                                            &batch->matches[i],
+                                            num_mates);
+        }
+        if (stats != NULL)
+            stats->report_ticks += stats_now() - t0;
+
+        batch_queue_push(&pipeline.free_batches, batch);
+
+        if (match_limit_reached(opts, match_counter)) {
+            pthread_mutex_lock(&pipeline.done_lock);
+            pipeline.stopped = 1;
+            pthread_mutex_unlock(&pipeline.done_lock);
+            break;
+        }
+    }
+
+    batch_queue_close(&pipeline.free_batches);
+    pthread_join(reader, NULL);
+    for (i = 0; i < (size_t) opts->num_threads; i++)
+        pthread_join(workers[i], NULL);
+
+    for (i = 0; i < pipeline.num_batches; i++) {
+        free(pipeline.batches[i].arena);
+        pack_arena_free(&pipeline.batches[i].pack);
+    }
+    free(pipeline.batches);
+    free(pipeline.done);
+    free(workers);
+    batch_queue_destroy(&pipeline.free_batches);
+    batch_queue_destroy(&pipeline.filled_batches);
+    pthread_mutex_destroy(&pipeline.done_lock);
+    pthread_cond_destroy(&pipeline.done_cond);
+
+    return match_counter;
+}
+
+void
+report_read(outbuf *out,
+            const options *opts,
+            const fastq_record *rec,
+            const read_match *info) {
+    if (opts->report_fasta) {
+        report_fasta(out, opts, rec, info);
+    }
+    else if (opts->report_stats) {
+        report_stats(out, opts, rec, info);
+    }
+    else {
+        report_fastq(out, opts, rec, info);
+    }
+}
+
+/*
+   Write the sequence, with the matched span wrapped in ANSI colour codes
+   if highlighting.  The pieces are written straight from the sequence by
+   their offsets, so nothing is copied or allocated.
+*/
+void
+display_sequence(outbuf *out,
+                 const options *opts,
+                 const char *sequence,
+                 size_t     sequence_len,
+                 const char *substr_start,
+                 const char *substr_end) {
+    if (opts->color == 1 && substr_start != NULL) {
+        size_t start = (size_t) (substr_start - sequence);
+        size_t end   = (size_t) (substr_end - sequence);
+
+        outbuf_write(out, sequence, start);
+        outbuf_write(out, "\033[31m", 5);
+        outbuf_write(out, substr_start, end - start);
+        outbuf_write(out, "\033[0m", 4);
+        outbuf_write(out, substr_end, sequence_len - end);
+    }
+    else {
+        outbuf_write(out, sequence, sequence_len);
+    }
+}
+
+void
+report_stats(outbuf *out,
+             const options *opts,
+             const fastq_record *rec,
+             const read_match *info) {
+
+    static const outbuf *headed[2];   /* outputs given a header so far */
+    static const char *header[] = {
+        "read name",
+        "read comments",
+        "total mismatches",
+        "# insertions",
+        "# deletions",
+        "# substitutions",
+        "start position",
+        "end position",
+        "match string",
+        "sequence"
+    };
+    const size_t delim_l = strlen(opts->delim);
+    size_t i;
+
+    /*
+       stat report columns are
+         1. read_name
+         2. read_comments
+         3. mismatches
+         4. num_ins
+         5. num_del
+         6. num_subst
+         7. start_position
+         8. end_position
+         9. match string
+        10. sequence string
+        11. quality string (if available)
+        12. matching pattern name (if searching a '-P' pattern file)
+        13. strand of the match (if searching with '--both-strands')
+        14. quality weighted cost (if searching with '--min-qual')
+     */
+
+    if (headed[0] != out && headed[1] != out) {
+        for (i = 0; i < sizeof(header) / sizeof(header[0]); i++) {
+            if (i > 0)
+                outbuf_write(out, opts->delim, delim_l);
+            outbuf_puts(out, header[i]);
+        }
+
+         /* quality string portion of header */
+        if (rec->qual_l) {
+            outbuf_write(out, opts->delim, delim_l);
+            outbuf_puts(out, "quality");
+        }
+
+        /* pattern file portion of header */
+        if (opts->patterns != NULL) {
+            outbuf_write(out, opts->delim, delim_l);
+            outbuf_puts(out, "pattern");
+        }
+
+        /* strand portion of header */
+        if (opts->both_strands) {
+            outbuf_write(out, opts->delim, delim_l);
+            outbuf_puts(out, "strand");
+        }
+
+        /* weighted cost portion of header */
+        if (opts->min_quality >= 0) {
+            outbuf_write(out, opts->delim, delim_l);
+            outbuf_puts(out, "weighted cost");
+        }
+        outbuf_putc(out, '\n');
+        headed[headed[0] == NULL ? 0 : 1] = out;
+    }
+
+    outbuf_write(out, rec->name, rec->name_l);
+    outbuf_write(out, opts->delim, delim_l);
+
+    /* the comment column is cut short at MAX_READ_COMMENT_LENGTH-1 chars */
+    if (rec->comment_l) {
+        outbuf_write(out, rec->comment,
+                     rec->comment_l < MAX_READ_COMMENT_LENGTH-1 ?
+                         rec->comment_l : MAX_READ_COMMENT_LENGTH-1);
+    }
+    else {
+        outbuf_putc(out, '-');
+    }
+    outbuf_write(out, opts->delim, delim_l);
+
+    outbuf_put_int(out, info->num_mismatches);
+    outbuf_write(out, opts->delim, delim_l);
+    outbuf_put_int(out, info->num_insertions);
+    outbuf_write(out, opts->delim, delim_l);
+    outbuf_put_int(out, info->num_deletions);
+    outbuf_write(out, opts->delim, delim_l);
+    outbuf_put_int(out, info->num_substitutions);
+    outbuf_write(out, opts->delim, delim_l);
+    outbuf_put_int(out, info->start_pos);
+    outbuf_write(out, opts->delim, delim_l);
+    outbuf_put_int(out, info->end_pos);
+    outbuf_write(out, opts->delim, delim_l);
+
+    /* match string portion of stats report */
+
+    /* if there is no match -- via the invert_match option */
+    if (info->substr_start == NULL) {
+        outbuf_putc(out, '*');
+        outbuf_write(out, opts->delim, delim_l);
+    }
+    /* otherwise there is a matching substring to report */
+    else {
+        outbuf_write(out, info->substr_start,
+                     (size_t) (info->substr_end - info->substr_start));
+        outbuf_write(out, opts->delim, delim_l);
+    }
+
+    /* sequence portion of stats report */
+    display_sequence (out,
+                      opts,
+                      rec->seq,
+                      rec->seq_l,
+                      info->substr_start,
+                      info->substr_end);
+
+    /* quality string portion of stats report */
+    if (rec->qual_l) {
+        outbuf_write(out, opts->delim, delim_l);
+        outbuf_write(out, rec->qual, rec->qual_l);
+    }
+
+    /* matching pattern portion of stats report */
+    if (opts->patterns != NULL) {
+        outbuf_write(out, opts->delim, delim_l);
+        if (info->pattern_idx < 0) {
+            outbuf_putc(out, '*');
+        }
+        else {
+            outbuf_puts(out, opts->patterns->names[info->pattern_idx]);
+        }
+    }
+
+    /* strand portion of stats report */
+    if (opts->both_strands) {
+        outbuf_write(out, opts->delim, delim_l);
+        outbuf_putc(out, info->substr_start == NULL ? '*' : info->strand);
+    }
+
+    /* weighted cost portion of stats report */
+    if (opts->min_quality >= 0) {
+        outbuf_write(out, opts->delim, delim_l);
+        outbuf_put_int(out, info->weighted_cost);
+    }
+
+    /* termination of record line */
+    outbuf_putc(out, '\n');
+}
+
+void
+report_fasta(outbuf *out,
+             const options *opts,
+             const fastq_record *rec,
+             const read_match *info) {
+    /* header portion of FASTA read record */
+    outbuf_putc(out, '>');
+    outbuf_write(out, rec->name, rec->name_l);
+    if (rec->comment_l) {
+        outbuf_putc(out, ' ');
+        outbuf_write(out, rec->comment, rec->comment_l);
+    }
+    outbuf_putc(out, '\n');
+
+    /* sequence portion of FASTA read record */
+    display_sequence (out,
+                      opts,
+                      rec->seq,
+                      rec->seq_l,
+                      info->substr_start,
+                      info->substr_end);
+    outbuf_putc(out, '\n');
+}
+
+void
+report_fastq(outbuf *out,
+             const options *opts,
+             const fastq_record *rec,
+             const read_match *info) {
+
+    /* an unhighlighted record can go out just as it was read */
+    if (rec->raw != NULL &&
+        (opts->color == 0 || info->substr_start == NULL)) {
+        outbuf_write(out, rec->raw, rec->raw_l);
+        return;
+    }
+
+    /* header portion of FASTQ read record */
+    outbuf_putc(out, '@');
+    outbuf_write(out, rec->name, rec->name_l);
+    if (rec->comment_l) {
+        outbuf_putc(out, ' ');
+        outbuf_write(out, rec->comment, rec->comment_l);
+    }
+    outbuf_putc(out, '\n');
+
+    /* sequence portion of FASTQ read record */
+    display_sequence (out,
+                      opts,
+                      rec->seq,
+                      rec->seq_l,
+                      info->substr_start,
+                      info->substr_end);
+    outbuf_putc(out, '\n');
+
+    /* comment portion of FASTQ read record */
+    outbuf_write(out, "+\n", 2);
+
+    /* quality portion of FASTQ read record */
+    outbuf_write(out, rec->qual, rec->qual_l);
+    outbuf_putc(out, '\n');
+}
+
+void
+setup_tre(regaparams_t *params,
+          regex_t *regexp,
+          regex_t *regexp_rc,
+          options *opts) {
+    /* Step 1: setup the TRE regexp matching parameters */
+
+    /* setup the default match parameters */
+    tre_regaparams_default(params);
+
+    /* Set the maximum number of errors allowed for a record to match. */
+    params->max_cost = opts->max_mismatches;
+
+    /* Set the insertion, deletion, substitution costs. */
+    params->cost_ins = opts->cost_insertions;
+    params->cost_del = opts->cost_deletions;
+    params->cost_subst = opts->cost_substitutions;
+
+    /* Set the max insertion, deletion, substitution allowances. */
+    params->max_ins = opts->max_insertions;
+    params->max_del = opts->max_deletions;
+    params->max_subst = opts->max_substitutions;
+
+    /*
+       Step 2: compile the regex (and its reverse complement); IUPAC
+       patterns are written out with character classes
+    */
+    if (opts->iupac) {
+        char *regex = iupac_to_regex(opts->search_pattern, opts->n_wildcard);
+        char *regex_rc = NULL;
+        if (opts->both_strands)
+            regex_rc = iupac_to_regex(opts->search_pattern_rc,
+                                      opts->n_wildcard);
+        if (regex == NULL || (opts->both_strands && regex_rc == NULL)) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+        compile_tre_regexp(regexp, regex);
+        if (opts->both_strands)
+            compile_tre_regexp(regexp_rc, regex_rc);
+        free(regex);
+        free(regex_rc);
+    }
+    else {
+        compile_tre_regexp(regexp, opts->search_pattern);
+        if (opts->both_strands)
+            compile_tre_regexp(regexp_rc, opts->search_pattern_rc);
+    }
+
+    /* Step 3: assign to opts hash */
+    opts->tre_regex = regexp;
+    opts->tre_regex_match_params = params;
+    if (opts->both_strands)
+        opts->tre_regex_rc = regexp_rc;
+}
+
+void
+compile_tre_regexp(regex_t *regexp, const char *pattern) {
+    /*
+       always allowing for POSIX extended regular expression syntax
+       (REG_EXTENDED)
+       always being case insenstive with the regular expression
+       (REG_ICASE)
+    */
+    int errcode;
+    int comp_flags  = REG_EXTENDED | REG_ICASE ;
+    errcode = tre_regcomp(regexp, pattern, comp_flags);
+    if (errcode) {
+        char errbuf[256];
+        tre_regerror(errcode, regexp, errbuf, sizeof(errbuf));
+        fprintf(stderr, "%s: %s: -- %s -- %s\n",
+          PRG_NAME,
+              "Error in compiling search pattern",
+              pattern,
+              errbuf
+        );
+        exit(EXIT_TROUBLE);
+    }
+}
+
+void
+approximate_regexp_search(const options *opts,
+                          read_match *info,
+                          size_t seq_len) {
+    int errcode;
+    regmatch_t pmatch = { 0, 0 };     /* matched pattern structure */
+    regamatch_t match;                /* overall match structure */
+
+    /* initialize the overall match struct */
+    memset(&match, 0, sizeof(match));
+    /* assign default pattern structure */
+    match.pmatch = &pmatch;
+    /* initialization of pmatch array */
+    match.nmatch = 1;
+
+    /* perform the regexp search on the sequence string */
+    errcode = tre_reganexec(
+            opts->tre_regex,
+            info->sequence,
+            seq_len,
+            &match,
+            *(opts->tre_regex_match_params),
+            0
+    );
+
+    /*
+       with '--both-strands' the reverse complement wins if it matches at a
+       lower cost, or at the same cost but ending earlier
+    */
+    if (opts->tre_regex_rc != NULL) {
+        regmatch_t pmatch_rc = { 0, 0 };
+        regamatch_t match_rc;
+
+        memset(&match_rc, 0, sizeof(match_rc));
+        match_rc.pmatch = &pmatch_rc;
+        match_rc.nmatch = 1;
+
+        if ( tre_reganexec(opts->tre_regex_rc,
+                           info->sequence,
+                           seq_len,
+                           &match_rc,
+                           *(opts->tre_regex_match_params),
+                           0) == REG_OK &&
+             ( errcode != REG_OK ||
+               match_rc.cost < match.cost ||
+               (match_rc.cost == match.cost &&
+                pmatch_rc.rm_eo < pmatch.rm_eo) ) ) {
+            errcode = REG_OK;
+            match   = match_rc;
+            pmatch  = pmatch_rc;
+            info->strand = '-';
+        }
+    }
+
+    if (errcode != REG_OK) {
+//        fprintf(stdout, "Found no matches!\n");
+//        fprintf(stdout, "%6s : %s\n", "regexp", opts->search_pattern);
+//        fprintf(stdout, "%6s : %s\n", "record", sequence);
+        return;
+    }
+
+    /* found a match! */
+
+    info->num_mismatches    = match.cost;
+    info->num_insertions    = match.num_ins;
+    info->num_deletions     = match.num_del;
+    info->num_substitutions = match.num_subst;
+    info->start_pos         = pmatch.rm_so;
+    info->end_pos           = pmatch.rm_eo;
+
+    info->substr_start      = info->sequence + (size_t) info->start_pos;
+    info->substr_end        = info->sequence + (size_t) info->end_pos;
+
+//    fprintf(stdout, "Found match!\n");
+//    fprintf(stdout, "\t%10s : %s\n", "record", info->sequence);
+//    fprintf(stdout, "\t%10s : %s\n", "pattern", opts->search_pattern);
+//    fprintf(stdout, "\t%10s : %4d\n", "cost", match.cost);
+//    fprintf(stdout, "\t%10s : %4d\n", "num_ins", match.num_ins);
+//    fprintf(stdout, "\t%10s : %4d\n", "num_del", match.num_del);
+//    fprintf(stdout, "\t%10s : %4d\n", "num_subst", match.num_subst);
+//    fprintf(stdout, "\t%10s : %2d - %2d\n", "char pos",
+//                                            pmatch.rm_so, pmatch.rm_eo);
+
+}
+
+/* the search settings, in the form engine.h and libfqgrep.h take them */
+void
+search_params(const options *opts, fqgrep_params *params) {
+    params->pattern            = opts->search_pattern;
+    params->max_mismatches     = opts->max_mismatches;
+    params->cost_insertions    = opts->cost_insertions;
+    params->cost_deletions     = opts->cost_deletions;
+    params->cost_substitutions = opts->cost_substitutions;
+    params->max_insertions     = opts->max_insertions;
+    params->max_deletions      = opts->max_deletions;
+    params->max_substitutions  = opts->max_substitutions;
+    params->both_strands       = opts->both_strands;
+    params->n_wildcard         = opts->n_wildcard;
+    params->force_tre          = opts->force_tre;
+}
+
+/* see 'engine_unit_cost_edits' */
+int
+unit_cost_edits(const options *opts, int *max_edits) {
+    fqgrep_params params;
+
+    search_params(opts, &params);
+    return engine_unit_cost_edits(&params, max_edits);
+}
+
+/*
+   The bit-parallel matcher only handles unit edit costs, so it is used
+   when the pattern is a plain (ACGT) or IUPAC string of at most 64 bases,
+   the insertion, deletion and substitution costs are all equal, and none
+   of the per-type thresholds can come into play (see engine.h).
+*/
+void
+setup_myers(options *opts, int max_edits) {
+    opts->myers = create_myers_pattern(opts, opts->search_pattern);
+    if (opts->myers == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+    if (opts->both_strands) {
+        opts->myers_rc = create_myers_pattern(opts, opts->search_pattern_rc);
+        if (opts->myers_rc == NULL) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+    }
+    opts->myers_max_edits = max_edits;
+}
+
+myers_pattern*
+create_myers_pattern(const options *opts, const char *pattern) {
+    if (opts->iupac)
+        return myers_pattern_create_iupac(pattern,
+                                          strlen(pattern),
+                                          opts->n_wildcard);
+
+    return myers_pattern_create(pattern, strlen(pattern));
+}
+
+/* exact (IUPAC) searches only need the shift-and scan */
+int
+bit_parallel_search(const options *opts,
+                    const myers_pattern *mp,
+                    const char *sequence,
+                    size_t seq_len,
+                    myers_match *match) {
+    if (opts->myers_max_edits == 0)
+        return myers_exact_search(mp, sequence, seq_len, match);
+
+    return myers_search(mp, sequence, seq_len, opts->myers_max_edits, match);
+}
+
+void
+approximate_myers_search(const options *opts,
+                         read_match *info,
+                         size_t seq_len) {
+    myers_match match, match_rc;
+    int found;
+
+    found = bit_parallel_search(opts,
+                                opts->myers,
+                                info->sequence,
+                                seq_len,
+                                &match);
+
+    /* the reverse complement wins with fewer edits, or an earlier end */
+    if ( opts->myers_rc != NULL &&
+         bit_parallel_search(opts,
+                             opts->myers_rc,
+                             info->sequence,
+                             seq_len,
+                             &match_rc) &&
+         ( !found ||
+           match_rc.edits < match.edits ||
+           (match_rc.edits == match.edits && match_rc.end < match.end) ) ) {
+        found = 1;
+        match = match_rc;
+        info->strand = '-';
+    }
+
+    if (!found)
+        return;
+
+    /* found a match! */
+
+    /* report costs in the same units as TRE would */
+    info->num_mismatches    = match.edits * opts->cost_substitutions;
+    info->num_insertions    = match.insertions;
+    info->num_deletions     = match.deletions;
+    info->num_substitutions = match.substitutions;
+    info->start_pos         = (int) match.start;
+    info->end_pos           = (int) match.end;
+
+    info->substr_start      = info->sequence + match.start;
+    info->substr_end        = info->sequence + match.end;
+}
+
+/*
+   With no insertions or deletions allowed ('-i 0 -d 0'), a match is the
+   pattern's alignment with the fewest substitutions, so a plain (ACGT)
+   pattern is searched with the packed Hamming distance kernel rather than
+   TRE's edit distance automaton.  Like TRE, the search is case
+   insensitive, and at equal cost the leftmost alignment wins.
+*/
+void
+setup_hamming(options *opts, int max_substitutions) {
+    opts->pack_max_substitutions = max_substitutions;
+    opts->pack_match_case        = 0;
+    opts->pack = pack_pattern_create(opts->search_pattern,
+                                     strlen(opts->search_pattern), 0);
+    if (opts->both_strands)
+        opts->pack_rc = pack_pattern_create(opts->search_pattern_rc,
+                                            strlen(opts->search_pattern_rc),
+                                            0);
+    if (opts->pack == NULL || (opts->both_strands && opts->pack_rc == NULL)) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+}
+
+/*
+   With '--packed', an exact search of an upper case ACGT pattern runs
+   over the reads packed 2 bits per base (see pack.h), 32 bases to a
+   comparison.  It is case sensitive, as the Boyer-Moore search it stands
+   in for, which any other pattern keeps.
+*/
+void
+setup_packed_search(options *opts) {
+    const char *pattern = opts->search_pattern;
+
+    if ( strspn(pattern, "ACGT") != strlen(pattern) )
+        return;
+
+    opts->pack_max_substitutions = 0;
+    opts->pack_match_case        = 1;
+    opts->pack = pack_pattern_create(pattern, strlen(pattern), 1);
+    if (opts->both_strands)
+        opts->pack_rc = pack_pattern_create(opts->search_pattern_rc,
+                                            strlen(opts->search_pattern_rc),
+                                            1);
+    if (opts->pack == NULL || (opts->both_strands && opts->pack_rc == NULL)) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+}
+
+/* pack the sequences of a group of records (a batch, or a pair) at once */
+void
+pack_records(const options *opts,
+             pack_arena *arena,
+             fastq_record *recs,
+             pack_seq *packed,
+             size_t num_records) {
+    size_t num_bases = 0, i;
+
+    for (i = 0; i < num_records; i++)
+        num_bases += recs[i].seq_l;
+
+    if ( !pack_arena_reserve(arena, num_bases, num_records) ) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+
+    for (i = 0; i < num_records; i++) {
+        pack_arena_add(arena, recs[i].seq, recs[i].seq_l,
+                       opts->pack_match_case, &packed[i]);
+        recs[i].packed = &packed[i];
+    }
+}
+
+void
+packed_search(const options *opts,
+              read_match *info,
+              const fastq_record *rec) {
+    pack_match match, match_rc;
+    int found;
+
+    found = pack_search(opts->pack, rec->packed,
+                        opts->pack_max_substitutions, &match);
+
+    /* the reverse complement wins with fewer substitutions, or further left */
+    if ( opts->pack_rc != NULL &&
+         pack_search(opts->pack_rc, rec->packed,
+                     opts->pack_max_substitutions, &match_rc) &&
+         ( !found ||
+           match_rc.substitutions < match.substitutions ||
+           (match_rc.substitutions == match.substitutions &&
+            match_rc.start < match.start) ) ) {
+        found = 1;
+        match = match_rc;
+        info->strand = '-';
+    }
+
+    if (!found)
+        return;
+
+    info->num_mismatches    = match.substitutions * opts->cost_substitutions;
+    info->num_substitutions = match.substitutions;
+    info->start_pos         = (int) match.start;
+    info->end_pos           = (int) match.end;
+
+    info->substr_start      = info->sequence + match.start;
+    info->substr_end        = info->sequence + match.end;
+}
+
+/*
+   Read a '-P' pattern file.  Each non-empty line (not starting with '#')
+   is either just a pattern, or a name and the pattern separated by a
+   tab.  The name (or else the pattern itself) is what gets reported.
+*/
+pattern_set*
+load_pattern_file(const char *pattern_file) {
+    FILE *fp;
+    pattern_set *patterns;
+    char *line = NULL;
+    size_t line_cap = 0, cap = 0;
+    ssize_t len;
+
+    if ( (fp = fopen(pattern_file, "r")) == NULL ) {
+        fprintf(stderr, "%s : [err] Could not open pattern file '%s'.\n",
+                        PRG_NAME, pattern_file);
+        exit(EXIT_TROUBLE);
+    }
+
+    if ( (patterns = calloc(1, sizeof(pattern_set))) == NULL ) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+
+    while ( (len = getline(&line, &line_cap, fp)) != -1 ) {
+        char *name, *sequence, *tab;
+
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+            line[--len] = '\0';
+        if (len == 0 || line[0] == '#')
+            continue;
+
+        if ( (tab = strchr(line, '\t')) != NULL ) {
+            *tab = '\0';
+            name = line;
+            sequence = tab + 1;
+        }
+        else {
+            name = line;
+            sequence = line;
+        }
+
+        if (strlen(sequence) == 0 || strlen(sequence) >= MAX_PATTERN_LENGTH) {
+            fprintf(stderr, "%s : [err] Invalid pattern '%s' in '%s'.\n",
+                            PRG_NAME, name, pattern_file);
+            exit(EXIT_TROUBLE);
+        }
+
+        if (patterns->num_patterns == cap) {
+            cap = cap ? 2 * cap : 64;
+            patterns->names     = realloc(patterns->names, cap * sizeof(char *));
+            patterns->sequences = realloc(patterns->sequences, cap * sizeof(char *));
+            patterns->lengths   = realloc(patterns->lengths, cap * sizeof(size_t));
+            if (patterns->names == NULL || patterns->sequences == NULL ||
+                patterns->lengths == NULL) {
+                fprintf(stderr, "%s : %s\n",
+                                PRG_NAME, "Trouble with malloc. Out of memory!");
+                exit(EXIT_TROUBLE);
+            }
+        }
+
+        patterns->names[patterns->num_patterns] =
+            stringn_duplicate(name, strlen(name));
+        patterns->sequences[patterns->num_patterns] =
+            stringn_duplicate(sequence, strlen(sequence));
+        patterns->lengths[patterns->num_patterns] = strlen(sequence);
+        patterns->num_patterns++;
+    }
+
+    free(line);
+    fclose(fp);
+
+    if (patterns->num_patterns == 0) {
+        fprintf(stderr, "%s : [err] No patterns found in '%s'.\n",
+                        PRG_NAME, pattern_file);
+        exit(EXIT_TROUBLE);
+    }
+
+    patterns->match_counts = calloc(patterns->num_patterns, sizeof(int));
+    if (patterns->match_counts == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+
+    return patterns;
+}
+
+void
+free_pattern_set(pattern_set *patterns) {
+    size_t i;
+
+    if (patterns == NULL)
+        return;
+
+    for (i = 0; i < patterns->num_patterns; i++) {
+        free(patterns->names[i]);
+        free(patterns->sequences[i]);
+    }
+    free(patterns->names);
+    free(patterns->sequences);
+    free(patterns->lengths);
+    free(patterns->match_counts);
+    free(patterns);
+}
+
+/*
+   The patterns the multi-pattern matchers are built from: those of the
+   pattern file, followed (with '--both-strands') by their reverse
+   complements, so that matcher pattern 'i + num_patterns' is the reverse
+   complement of pattern 'i'.  The arrays (and 'rc_storage') are to be
+   freed once the matcher is built.
+*/
+size_t
+matcher_patterns(const options *opts,
+                 const char ***sequences,
+                 size_t **lengths,
+                 char **rc_storage) {
+    const pattern_set *patterns = opts->patterns;
+    size_t n = patterns->num_patterns;
+    size_t total = opts->both_strands ? 2 * n : n;
+    size_t i, offset = 0;
+
+    *sequences  = malloc(total * sizeof(char *));
+    *lengths    = malloc(total * sizeof(size_t));
+    *rc_storage = NULL;
+
+    if (opts->both_strands) {
+        for (i = 0; i < n; i++)
+            offset += patterns->lengths[i] + 1;
+        *rc_storage = malloc(offset);
+    }
+
+    if ( *sequences == NULL || *lengths == NULL ||
+         (opts->both_strands && *rc_storage == NULL) ) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+
+    for (i = 0, offset = 0; i < n; i++) {
+        (*sequences)[i] = patterns->sequences[i];
+        (*lengths)[i]   = patterns->lengths[i];
+        if (opts->both_strands) {
+            char *rc = *rc_storage + offset;
+            iupac_reverse_complement(patterns->sequences[i],
+                                     patterns->lengths[i],
+                                     rc);
+            (*sequences)[n + i] = rc;
+            (*lengths)[n + i]   = patterns->lengths[i];
+            offset += patterns->lengths[i] + 1;
+        }
+    }
+
+    return total;
+}
+
+void
+setup_aho(options *opts) {
+    const char **sequences;
+    size_t *lengths;
+    char *rc_storage;
+    size_t num = matcher_patterns(opts, &sequences, &lengths, &rc_storage);
+
+    opts->aho = aho_build( sequences, lengths, num, 0 );
+    free(sequences);
+    free(lengths);
+    free(rc_storage);
+    if (opts->aho == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+}
+
+void
+multi_pattern_search(const options *opts,
+                     read_match *info,
+                     size_t seq_len) {
+    aho_match match;
+
+    if ( !aho_search(opts->aho, info->sequence, seq_len, &match) )
+        return;
+
+    /* found a match! */
+    info->pattern_idx  = (int) match.pattern;
+    if (match.pattern >= opts->patterns->num_patterns) {
+        info->pattern_idx -= (int) opts->patterns->num_patterns;
+        info->strand       = '-';
+    }
+    info->start_pos    = (int) match.start;
+    info->end_pos      = (int) match.end;
+    info->substr_start = info->sequence + match.start;
+    info->substr_end   = info->sequence + match.end;
+}
+
+/*
+   Approximate matching of a pattern file's patterns is limited to what
+   the bit-parallel verifier handles: patterns of up to 64 characters and
+   a plain edit distance threshold.
+*/
+void
+setup_pigeon(options *opts) {
+    size_t i, num;
+    int max_edits;
+    const char **sequences;
+    size_t *lengths;
+    char *rc_storage;
+
+    if ( !unit_cost_edits(opts, &max_edits) ) {
+        fprintf(stderr, "%s : %s\n", PRG_NAME,
+                        "[err] Approximate '-P' searches need equal -S/-I/-D "
+                        "costs and no -s/-i/-d thresholds!");
+        exit(EXIT_TROUBLE);
+    }
+
+    for (i = 0; i < opts->patterns->num_patterns; i++) {
+        if (opts->patterns->lengths[i] > MYERS_MAX_PATTERN_LENGTH) {
+            fprintf(stderr, "%s : [err] Pattern '%s' is longer than %d "
+                            "bases, the approximate '-P' search limit.\n",
+                            PRG_NAME,
+                            opts->patterns->names[i],
+                            MYERS_MAX_PATTERN_LENGTH);
+            exit(EXIT_TROUBLE);
+        }
+    }
+
+    opts->myers_max_edits = max_edits;
+    num = matcher_patterns(opts, &sequences, &lengths, &rc_storage);
+    opts->pigeon = pigeon_create( sequences, lengths, num, max_edits );
+    free(sequences);
+    free(lengths);
+    free(rc_storage);
+    if (opts->pigeon == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+}
+
+void
+approximate_multi_pattern_search(const options *opts,
+                                 read_match *info,
+                                 size_t seq_len) {
+    pigeon_match match;
+
+    if ( !pigeon_search(opts->pigeon, info->sequence, seq_len, &match) )
+        return;
+
+    /* found a match! */
+    info->pattern_idx       = (int) match.pattern;
+    if (match.pattern >= opts->patterns->num_patterns) {
+        info->pattern_idx  -= (int) opts->patterns->num_patterns;
+        info->strand        = '-';
+    }
+    info->num_mismatches    = match.match.edits * opts->cost_substitutions;
+    info->num_insertions    = match.match.insertions;
+    info->num_deletions     = match.match.deletions;
+    info->num_substitutions = match.match.substitutions;
+    info->start_pos         = (int) match.match.start;
+    info->end_pos           = (int) match.match.end;
+    info->substr_start      = info->sequence + match.match.start;
+    info->substr_end        = info->sequence + match.match.end;
+}
+
+/*
+   The quality-aware search takes the -m threshold and the -S/-I/-D costs
+   (which have to be positive) as they are, and needs a plain (or IUPAC)
+   pattern of at most 64 bases; the per-type -s/-i/-d thresholds are not
+   supported.
+*/
+void
+setup_quality_search(options *opts) {
+    if ( !(opts->iupac || myers_is_dna_literal(opts->search_pattern)) ||
+         strlen(opts->search_pattern) > MYERS_MAX_PATTERN_LENGTH ||
+         opts->cost_insertions <= 0 || opts->cost_deletions <= 0 ||
+         opts->cost_substitutions <= 0 ||
+         opts->max_insertions != INT_MAX || opts->max_deletions != INT_MAX ||
+         opts->max_substitutions != INT_MAX ) {
+        fprintf(stderr, "%s : [err] '--min-qual' needs an (IUPAC) pattern of "
+                        "at most %d bases, positive -S/-I/-D costs and no "
+                        "-s/-i/-d thresholds!\n",
+                        PRG_NAME, MYERS_MAX_PATTERN_LENGTH);
+        exit(EXIT_TROUBLE);
+    }
+
+    opts->qual_match = create_qual_matcher(opts, opts->search_pattern);
+    if (opts->both_strands)
+        opts->qual_match_rc = create_qual_matcher(opts,
+                                                  opts->search_pattern_rc);
+}
+
+qual_matcher*
+create_qual_matcher(const options *opts, const char *pattern) {
+    qual_matcher *qm = malloc(sizeof(qual_matcher));
+    myers_pattern *mp = create_myers_pattern(opts, pattern);
+
+    if (qm == NULL || mp == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+
+    qm->mp                 = mp;
+    qm->cost_insertions    = opts->cost_insertions;
+    qm->cost_deletions     = opts->cost_deletions;
+    qm->cost_substitutions = opts->cost_substitutions;
+    qm->low_quality_cost   = opts->low_quality_cost;
+    qm->min_quality        = opts->min_quality;
+    qm->max_cost           = opts->max_mismatches;
+
+    return qm;
+}
+
+void
+destroy_quality_search(options *opts) {
+    if (opts->qual_match != NULL) {
+        myers_pattern_destroy((myers_pattern *) opts->qual_match->mp);
+        free(opts->qual_match);
+    }
+    if (opts->qual_match_rc != NULL) {
+        myers_pattern_destroy((myers_pattern *) opts->qual_match_rc->mp);
+        free(opts->qual_match_rc);
+    }
+}
+
+void
+quality_aware_search(const options *opts,
+                     read_match *info,
+                     const fastq_record *rec) {
+    const char *qual = rec->qual_l == rec->seq_l ? rec->qual : NULL;
+    qual_match match, match_rc;
+    int found;
+
+    found = qual_search(opts->qual_match, rec->seq, qual, rec->seq_l, &match);
+
+    /* the reverse complement wins at a lower cost, or an earlier end */
+    if ( opts->qual_match_rc != NULL &&
+         qual_search(opts->qual_match_rc,
+                     rec->seq,
+                     qual,
+                     rec->seq_l,
+                     &match_rc) &&
+         ( !found ||
+           match_rc.cost < match.cost ||
+           (match_rc.cost == match.cost && match_rc.end < match.end) ) ) {
+        found = 1;
+        match = match_rc;
+        info->strand = '-';
+    }
+
+    if (!found)
+        return;
+
+    /* found a match! */
+
+    /* the unweighted cost, as TRE would report it */
+    info->num_mismatches    = match.insertions * opts->cost_insertions +
+                              match.deletions * opts->cost_deletions +
+                              match.substitutions * opts->cost_substitutions;
+    info->num_insertions    = match.insertions;
+    info->num_deletions     = match.deletions;
+    info->num_substitutions = match.substitutions;
+    info->weighted_cost     = match.cost;
+    info->start_pos         = (int) match.start;
+    info->end_pos           = (int) match.end;
+
+    info->substr_start      = info->sequence + match.start;
+    info->substr_end        = info->sequence + match.end;
+}
+
+/*
+   Parse the comma separated '--trim-levels' list into 'levels' (at most
+   TRIM_MAX_LEVELS of them, in increasing order).  Returns their number.
+*/
+size_t
+parse_trim_levels(const char *list, int *levels) {
+    size_t num_levels = 0;
+    const char *p = list;
+
+    while (*p) {
+        char *end;
+        long level = strtol(p, &end, 10);
+        size_t i;
+
+        if ( end == p || level < 0 || level > INT_MAX ||
+             (*end != ',' && *end != '\0') ||
+             num_levels == TRIM_MAX_LEVELS ) {
+            fprintf(stderr, "%s : [err] '--trim-levels' takes up to %d "
+                            "comma separated mismatch counts, not '%s'!\n",
+                            PRG_NAME, TRIM_MAX_LEVELS, list);
+            exit(EXIT_TROUBLE);
+        }
+
+        /* keep the levels sorted, and drop repeats */
+        for (i = num_levels; i > 0 && levels[i - 1] > (int) level; i--)
+            levels[i] = levels[i - 1];
+        if (i == 0 || levels[i - 1] != (int) level) {
+            levels[i] = (int) level;
+            num_levels++;
+        }
+        else {
+            memmove(&levels[i], &levels[i + 1],
+                    (num_levels - i) * sizeof(int));
+        }
+
+        p = (*end == ',') ? end + 1 : end;
+    }
+
+    return num_levels;
+}
+
+/*
+   The adapter is aligned to the start ('left') or the end ('right') of
+   each read by the anchored bit-parallel matcher, which like the other
+   bit-parallel searches needs a plain (or IUPAC) adapter of at most 64
+   bases and unit edit costs.  It allows for the highest mismatch level;
+   the trimming report sorts the reads out per level.
+*/
+void
+setup_trim(options *opts, const char *first_input) {
+    char adapter[MAX_PATTERN_LENGTH];
+    size_t i, len = strlen(opts->search_pattern);
+    int max_edits;
+
+    if (opts->num_trim_levels == 0) {
+        opts->trim_levels[0]  = opts->max_mismatches;
+        opts->num_trim_levels = 1;
+    }
+    opts->max_mismatches = opts->trim_levels[opts->num_trim_levels - 1];
+
+    if ( !(opts->iupac || myers_is_dna_literal(opts->search_pattern)) ||
+         len > MYERS_MAX_PATTERN_LENGTH ||
+         !unit_cost_edits(opts, &max_edits) ) {
+        fprintf(stderr, "%s : [err] '--trim' needs an (IUPAC) adapter of at "
+                        "most %d bases, and equal -S/-I/-D costs with no "
+                        "-s/-i/-d thresholds!\n",
+                        PRG_NAME, MYERS_MAX_PATTERN_LENGTH);
+        exit(EXIT_TROUBLE);
+    }
+
+    /* a right side adapter is matched backwards from the end of the read */
+    for (i = 0; i < len; i++) {
+        adapter[i] = (opts->trim == TRIM_RIGHT) ?
+                     opts->search_pattern[len - 1 - i] :
+                     opts->search_pattern[i];
+    }
+    adapter[len] = '\0';
+
+    opts->trim_pattern = create_myers_pattern(opts, adapter);
+    if (opts->trim_pattern == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+    opts->myers_max_edits = max_edits;
+
+    /* the outputs are named after the (first) input file by default */
+    if ( strlen(opts->trim_prefix) == 0 ) {
+        const char *base = strrchr(first_input, '/');
+        strncpy(opts->trim_prefix,
+                base != NULL ? base + 1 : first_input,
+                TRIM_MAX_PREFIX_LENGTH - 1);
+    }
+
+    opts->trim_report = trim_report_open(opts->trim_prefix,
+                                         opts->trim,
+                                         opts->report_fasta,
+                                         opts->trim_levels,
+                                         opts->num_trim_levels);
+    if (opts->trim_report == NULL) {
+        fprintf(stderr, "%s : [err] Could not open the '%s' trimming "
+                        "outputs for writing.\n",
+                        PRG_NAME, opts->trim_prefix);
+        exit(EXIT_TROUBLE);
+    }
+}
+
+void
+anchored_adapter_search(const options *opts,
+                        read_match *info,
+                        size_t seq_len) {
+    myers_match match;
+
+    if ( !myers_anchored_search(opts->trim_pattern,
+                                info->sequence,
+                                seq_len,
+                                opts->myers_max_edits,
+                                opts->trim == TRIM_RIGHT,
+                                &match) )
+        return;
+
+    /* found a match! */
+
+    /* report costs in the same units as TRE would */
+    info->num_mismatches    = match.edits * opts->cost_substitutions;
+    info->num_insertions    = match.insertions;
+    info->num_deletions     = match.deletions;
+    info->num_substitutions = match.substitutions;
+    info->start_pos         = (int) match.start;
+    info->end_pos           = (int) match.end;
+
+    info->substr_start      = info->sequence + match.start;
+    info->substr_end        = info->sequence + match.end;
+}
+
+void
+trim_record(const options *opts,
+            const fastq_record *rec,
+            const read_match *info) {
+    trim_read read;
+
+    read.name      = rec->name;
+    read.name_l    = rec->name_l;
+    read.comment   = rec->comment;
+    read.comment_l = rec->comment_l;
+    read.seq       = rec->seq;
+    read.seq_l     = rec->seq_l;
+    read.qual      = rec->qual;
+    read.qual_l    = rec->qual_l;
+
+    if ( !trim_report_add(opts->trim_report,
+                          &read,
+                          info->substr_start != NULL,
+                          info->num_mismatches,
+                          (size_t) info->start_pos,
+                          (size_t) info->end_pos) ) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+}
+
+/*
+   Load the '--demux' barcode table, which is laid out as a '-P' pattern
+   file ('<sample>\t<barcode>' lines), and open the per sample outputs.
+*/
+void
+setup_demux(options *opts) {
+    pattern_set *barcodes = load_pattern_file(opts->demux_file);
+    const char *suffix;
+    size_t i, j;
+
+    for (i = 0; i < barcodes->num_patterns; i++) {
+        if ( barcodes->lengths[i] != barcodes->lengths[0] ||
+             barcodes->lengths[i] > DEMUX_MAX_BARCODE_LENGTH ||
+             strspn(barcodes->sequences[i], "ACGT") != barcodes->lengths[i] ) {
+            fprintf(stderr, "%s : [err] The barcodes in '%s' must all be "
+                            "of the same length (at most %d), and made up "
+                            "of A, C, G and T ('%s')!\n",
+                            PRG_NAME, opts->demux_file,
+                            DEMUX_MAX_BARCODE_LENGTH,
+                            barcodes->names[i]);
+            exit(EXIT_TROUBLE);
+        }
+        /* a sample's name is part of its output file's name */
+        if ( strcmp(barcodes->names[i], DEMUX_UNDETERMINED_NAME) == 0 ||
+             strchr(barcodes->names[i], '/') != NULL ) {
+            fprintf(stderr, "%s : [err] Sample '%s' in '%s' can not be "
+                            "named '%s', or have a '/' in its name!\n",
+                            PRG_NAME, barcodes->names[i], opts->demux_file,
+                            DEMUX_UNDETERMINED_NAME);
+            exit(EXIT_TROUBLE);
+        }
+        for (j = 0; j < i; j++) {
+            if ( strcmp(barcodes->sequences[i],
+                        barcodes->sequences[j]) == 0 ||
+                 strcmp(barcodes->names[i], barcodes->names[j]) == 0 ) {
+                fprintf(stderr, "%s : [err] Samples '%s' and '%s' in '%s' "
+                                "share a name or barcode!\n",
+                                PRG_NAME, barcodes->names[j],
+                                barcodes->names[i], opts->demux_file);
+                exit(EXIT_TROUBLE);
+            }
+        }
+    }
+
+    opts->demux = demux_create(barcodes->names,
+                               barcodes->sequences,
+                               barcodes->num_patterns,
+                               opts->max_mismatches);
+    if (opts->demux == NULL) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "Trouble with malloc. Out of memory!");
+        exit(EXIT_TROUBLE);
+    }
+    free_pattern_set(barcodes);
+
+    if (opts->report_stats)
+        suffix = opts->compress ? ".txt.gz" : ".txt";
+    else if (opts->report_fasta)
+        suffix = opts->compress ? ".fa.gz" : ".fa";
+    else
+        suffix = opts->compress ? ".fq.gz" : ".fq";
+
+    if ( demux_open_outputs(opts->demux,
+                            opts->demux_prefix,
+                            suffix,
+                            opts->compress ? opts->gzip_level
+                                           : OUTBUF_PLAIN) != 0 ) {
+        fprintf(stderr, "%s : [err] Could not open the '--demux' outputs "
+                        "'%s<sample>%s' for writing.\n",
+                        PRG_NAME, opts->demux_prefix, suffix);
+        exit(EXIT_TROUBLE);
+    }
+}
+
+/* the read's barcode is its prefix; 'pattern_idx' is the sample (or -1) */
+void
+demux_search(const options *opts, read_match *info, size_t seq_len) {
+    int mismatches;
+    int sample = demux_lookup(opts->demux, info->sequence, seq_len,
+                              &mismatches);
+
+    if (sample == DEMUX_UNDETERMINED)
+        return;
+
+    info->pattern_idx       = sample;
+    info->num_mismatches    = mismatches;
+    info->num_substitutions = mismatches;
+    info->start_pos         = 0;
+    info->end_pos           = (int) opts->demux->barcode_l;
+    info->substr_start      = info->sequence;
+    info->substr_end        = info->sequence + opts->demux->barcode_l;
+}
+
+void
+demux_record(const options *opts,
+             const fastq_record *rec,
+             const read_match *info) {
+    outbuf *out = demux_add(opts->demux,
+                            info->pattern_idx,
+                            info->num_substitutions);
+
+    report_read(out, opts, rec, info);
+}
+
+/*
+   'fqgrep index [-k <INT>] [-b <INT>] <files>': write the k-mer index
+   sidecar '<file>.fqi' of every file (see fqindex.h).
+*/
+int
+index_files(int argc, char *argv[]) {
+    int c, i, ret;
+    int k = FQINDEX_DEFAULT_K;
+    int records_per_block = FQINDEX_DEFAULT_BLOCK;
+
+    while( (c = getopt(argc, argv, "hk:b:")) != -1 ) {
+        switch(c) {
+            case 'h':
+                index_help_message();
+                exit(0);
+                break;
+            case 'k':
+                k = atoi(optarg);
+                if (k < FQINDEX_MIN_K || k > FQINDEX_MAX_K) {
+                    fprintf(stderr, "%s : [err] The k-mer length (-k) is "
+                                    "from %d to %d!\n",
+                                    PRG_NAME, FQINDEX_MIN_K, FQINDEX_MAX_K);
+                    exit(EXIT_TROUBLE);
+                }
+                break;
+            case 'b':
+                records_per_block = atoi(optarg);
+                if (records_per_block < 1 ||
+                    records_per_block > FQINDEX_MAX_BLOCK) {
+                    fprintf(stderr, "%s : [err] The records per block (-b) "
+                                    "are from 1 to %d!\n",
+                                    PRG_NAME, FQINDEX_MAX_BLOCK);
+                    exit(EXIT_TROUBLE);
+                }
+                break;
+            case '?':
+                exit(EXIT_TROUBLE);
+             default:
+                abort();
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "%s : %s\n",
+                        PRG_NAME, "[err] specify FASTQ files to index!");
+        exit(EXIT_TROUBLE);
+    }
+
+    for (i = optind; i < argc; i++) {
+        if ( (ret = fqindex_build(argv[i], k, records_per_block)) != 0 ) {
+            fprintf(stderr, "%s : [err] Could not index '%s': %s\n",
+                            PRG_NAME, argv[i], fqindex_strerror(ret));
+            exit(EXIT_TROUBLE);
+        }
+    }
+
+    return 0;
+}
+
+/*
+   The patterns (and with '--both-strands' their reverse complements) to
+   look the inputs up by in their indexes.  An index only narrows down
+   searches that report the matching reads of single-end input, for plain
+   base patterns, and edits that cost at least 1 each (so '-m' bounds
+   their number); otherwise there are none, and every input is read in
+   full.
+*/
+void
+setup_index_search(options *opts) {
+    const char **sequences;
+    size_t *lengths = NULL;
+    size_t num, i, j;
+
+    if ( opts->invert_match || opts->show_all_records || opts->n_wildcard ||
+         opts->iupac || opts->trim_pattern != NULL ||
+         opts->qual_match != NULL || opts->demux != NULL ||
+         strlen(opts->input_r1) != 0 || opts->cost_insertions < 1 ||
+         opts->cost_deletions < 1 || opts->cost_substitutions < 1 )
+        return;
+
+    if (opts->patterns != NULL) {
+        num = matcher_patterns(opts, &sequences, &lengths,
+                               &opts->index_rc_storage);
+        free(lengths);
+    }
+    else {
+        num = opts->both_strands ? 2 : 1;
+        if ( (sequences = malloc(2 * sizeof(char *))) == NULL ) {
+            fprintf(stderr, "%s : %s\n",
+                            PRG_NAME, "Trouble with malloc. Out of memory!");
+            exit(EXIT_TROUBLE);
+        }
+        sequences[0] = opts->search_pattern;
+        sequences[1] = opts->search_pattern_rc;
+    }
+
+    /* a regexp (or any other symbol) could match what the k-mers miss */
+    for (i = 0; i < num; i++) {
+        for (j = 0; sequences[i][j] != '\0'; j++) {
+            if ( strchr("ACGTacgt", sequences[i][j]) == NULL ) {
+                free(sequences);
+                free(opts->index_rc_storage);
+                opts->index_rc_storage = NULL;
+                return;
+            }
+        }
+    }
 
-    substr = stringn_duplicate(str + start, len);
-    return substr;
+    opts->index_patterns     = sequences;
+    opts->num_index_patterns = num;
 }
 
 /*
@@ -844,7 +4025,7 @@ stringn_duplicate(const char *str, size_t n) {
     if ( ( copy = malloc(len + 1) ) == NULL ) {
         fprintf(stderr, "%s : %s\n",
                         PRG_NAME, "Trouble with malloc. Out of memory!");
-        exit(1);
+        exit(EXIT_TROUBLE);
     }
 
     memcpy(copy, str, len);
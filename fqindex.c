@@ -0,0 +1,1027 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* k-mer index sidecars for repeated searches of the same input
+
+   See fqindex.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "fqindex.h"
+
+/* D E F I N E S *************************************************************/
+#define FQINDEX_BGZF_BLOCK 65536          /* at most, either way */
+#define FQINDEX_WINDOW (4 << 20)          /* BGZF data parsed at a time */
+#define FQINDEX_NO_BLOCK UINT32_MAX
+
+/* the nanoseconds of a modification time */
+#ifdef __APPLE__
+#define FQINDEX_MTIME_NSEC(st) ((int64_t) (st)->st_mtimespec.tv_nsec)
+#else
+#define FQINDEX_MTIME_NSEC(st) ((int64_t) (st)->st_mtim.tv_nsec)
+#endif
+
+/* D A T A    S T R U C T U R E S ********************************************/
+/* the state of an index build, over both of its passes */
+typedef struct {
+    int           k;
+    uint64_t      mask;
+    uint32_t      records_per_block;
+    int           second_pass;        /* postings are written, not sized */
+    uint32_t      *last_block;        /* per k-mer, the block last seen in */
+    uint64_t      *directory;
+    unsigned char *postings;
+    uint64_t      *blocks;
+    size_t        num_blocks;
+    size_t        blocks_cap;
+    uint64_t      num_records;
+    uint32_t      min_seq_length;
+} fqindex_builder;
+
+/* P R O T O T Y P E S *******************************************************/
+static int    fqindex_code(int c);
+static int    fqindex_input_check(int fd,
+                                  const struct stat *st,
+                                  uint32_t *check);
+static size_t fqindex_put_varint(unsigned char *p, uint64_t v);
+static size_t fqindex_varint_len(uint64_t v);
+static int    fqindex_bgzf_block(int fd,
+                                 uint64_t *coffset,
+                                 unsigned char *cbuf,
+                                 z_stream *zs,
+                                 char *out,
+                                 size_t *out_len);
+static int    fqindex_add_record(fqindex_builder *b,
+                                 uint64_t offset,
+                                 const char *seq,
+                                 size_t seq_l);
+static int    fqindex_scan_plain(fqindex_builder *b,
+                                 const char *data,
+                                 size_t len);
+static int    fqindex_scan_bgzf(fqindex_builder *b, int fd);
+static int    fqindex_write(fqindex_builder *b,
+                            uint32_t check,
+                            const char *input,
+                            const struct stat *st,
+                            int bgzf);
+static void   fqindex_list(const fqindex *index,
+                           uint64_t kmer,
+                           const unsigned char **list,
+                           size_t *len);
+static size_t fqindex_decode(const unsigned char *p,
+                             const unsigned char *end,
+                             uint32_t *out);
+static int    fqindex_fetch(fqindex *index, uint64_t start, uint64_t end);
+
+/* F U N C T I O N S *********************************************************/
+
+/* 2-bit code of a base plus 1, or 0 for anything else */
+static int
+fqindex_code(int c) {
+    switch (c) {
+        case 'A': case 'a': return 1;
+        case 'C': case 'c': return 2;
+        case 'G': case 'g': return 3;
+        case 'T': case 't': return 4;
+        default:            return 0;
+    }
+}
+
+static size_t
+fqindex_put_varint(unsigned char *p, uint64_t v) {
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char) v;
+    return n;
+}
+
+static size_t
+fqindex_varint_len(uint64_t v) {
+    size_t n = 1;
+
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+/*
+   Inflate the BGZF block at '*coffset' into 'out' (of FQINDEX_BGZF_BLOCK
+   bytes) and move '*coffset' on to the next block.  Returns 1, 0 at the
+   end of the file, or -1 if the input is not BGZF (or is corrupt).
+*/
+static int
+fqindex_bgzf_block(int fd,
+                   uint64_t *coffset,
+                   unsigned char *cbuf,
+                   z_stream *zs,
+                   char *out,
+                   size_t *out_len) {
+    ssize_t n = pread(fd, cbuf, FQINDEX_BGZF_BLOCK, (off_t) *coffset);
+    size_t xlen, bsize = 0, i;
+
+    if (n == 0)
+        return 0;
+    if (n < 18 || cbuf[0] != 0x1f || cbuf[1] != 0x8b || cbuf[2] != 8 ||
+        !(cbuf[3] & 4))
+        return -1;
+
+    /* the 'BC' extra subfield holds the block size, less 1 */
+    xlen = (size_t) cbuf[10] | ((size_t) cbuf[11] << 8);
+    for (i = 12; i + 4 <= 12 + xlen && i + 4 <= (size_t) n; ) {
+        size_t slen = (size_t) cbuf[i + 2] | ((size_t) cbuf[i + 3] << 8);
+        if (cbuf[i] == 'B' && cbuf[i + 1] == 'C' && slen == 2 &&
+            i + 6 <= (size_t) n)
+            bsize = ((size_t) cbuf[i + 4] | ((size_t) cbuf[i + 5] << 8)) + 1;
+        i += 4 + slen;
+    }
+    if (bsize == 0 || bsize > (size_t) n || bsize < 12 + xlen + 8)
+        return -1;
+
+    inflateReset(zs);
+    zs->next_in   = cbuf + 12 + xlen;
+    zs->avail_in  = (uInt) (bsize - 12 - xlen - 8);
+    zs->next_out  = (Bytef *) out;
+    zs->avail_out = FQINDEX_BGZF_BLOCK;
+    if (inflate(zs, Z_FINISH) != Z_STREAM_END)
+        return -1;
+
+    *out_len  = FQINDEX_BGZF_BLOCK - zs->avail_out;
+    *coffset += bsize;
+    return 1;
+}
+
+/* note a record's k-mers; returns 0 if out of memory */
+static int
+fqindex_add_record(fqindex_builder *b,
+                   uint64_t offset,
+                   const char *seq,
+                   size_t seq_l) {
+    uint32_t block = (uint32_t) (b->num_records / b->records_per_block);
+    uint64_t kmer = 0;
+    size_t i;
+    int valid = 0;
+
+    if (!b->second_pass && b->num_records % b->records_per_block == 0) {
+        if (b->num_blocks + 1 >= b->blocks_cap) {
+            size_t cap = b->blocks_cap ? 2 * b->blocks_cap : 1024;
+            uint64_t *blocks = realloc(b->blocks, cap * sizeof(uint64_t));
+            if (blocks == NULL)
+                return 0;
+            b->blocks     = blocks;
+            b->blocks_cap = cap;
+        }
+        b->blocks[b->num_blocks++] = offset;
+    }
+    b->num_records++;
+    if (seq_l < b->min_seq_length)
+        b->min_seq_length = (uint32_t) seq_l;
+
+    for (i = 0; i < seq_l; i++) {
+        int code = fqindex_code((unsigned char) seq[i]);
+        uint64_t gap;
+
+        if (code == 0) {
+            valid = 0;
+            continue;
+        }
+        kmer = ((kmer << 2) | (uint64_t) (code - 1)) & b->mask;
+        if (valid < b->k)
+            valid++;
+        if (valid < b->k || b->last_block[kmer] == block)
+            continue;
+
+        /* an unseen k-mer's last block is FQINDEX_NO_BLOCK, i.e. -1 */
+        gap = (uint64_t) (uint32_t) (block - b->last_block[kmer] - 1);
+        b->last_block[kmer] = block;
+        if (b->second_pass)
+            b->directory[kmer] +=
+                fqindex_put_varint(b->postings + b->directory[kmer], gap);
+        else
+            b->directory[kmer] += fqindex_varint_len(gap);
+    }
+
+    return 1;
+}
+
+/* returns FQINDEX_OK or FQINDEX_ENOMEM */
+static int
+fqindex_scan_plain(fqindex_builder *b, const char *data, size_t len) {
+    mapfq_reader *reader;
+    mapfq_record rec;
+    int ret = FQINDEX_OK;
+
+    if ( (reader = mapfq_open_buffer(data, len)) == NULL )
+        return FQINDEX_ENOMEM;
+
+    for (;;) {
+        uint64_t offset = mapfq_tell(reader);
+        int more = mapfq_read(reader, &rec);
+        if (more <= 0) {
+            if (more < 0)
+                ret = FQINDEX_ENOMEM;
+            break;
+        }
+        if ( !fqindex_add_record(b, offset, rec.seq, rec.seq_l) ) {
+            ret = FQINDEX_ENOMEM;
+            break;
+        }
+    }
+
+    if (!b->second_pass)
+        b->blocks[b->num_blocks] = len;
+
+    mapfq_close(reader);
+    return ret;
+}
+
+/*
+   Parse a BGZF input through a window of its decompressed blocks.  A
+   record running past the end of the window is parsed again once more
+   blocks are in; the window holds the records' virtual offsets by the
+   compressed offset of every block in it.
+*/
+static int
+fqindex_scan_bgzf(fqindex_builder *b, int fd) {
+    mapfq_reader *reader;
+    mapfq_record rec;
+    unsigned char *cbuf;
+    z_stream zs;
+    char *win = NULL;
+    size_t win_len = 0, win_cap = 0, parse_from = 0, want = FQINDEX_WINDOW;
+    size_t *starts = NULL, num_starts = 0, starts_cap = 0;
+    uint64_t *coffsets = NULL, coffset = 0;
+    int final = 0, ret = FQINDEX_OK;
+
+    memset(&zs, 0, sizeof(z_stream));
+    reader = mapfq_open_buffer(NULL, 0);
+    cbuf   = malloc(FQINDEX_BGZF_BLOCK);
+    if (reader == NULL || cbuf == NULL || inflateInit2(&zs, -15) != Z_OK) {
+        mapfq_close(reader);
+        free(cbuf);
+        return FQINDEX_ENOMEM;
+    }
+
+    for (;;) {
+        uint64_t offset;
+        size_t pos, lo, hi;
+        int more;
+
+        /* top the window up, dropping the blocks already parsed */
+        if (!final && win_len - parse_from < want) {
+            if (num_starts > 0) {
+                size_t drop, i = 0;
+
+                while (i + 1 < num_starts && starts[i + 1] <= parse_from)
+                    i++;
+                drop = starts[i];
+                memmove(win, win + drop, win_len - drop);
+                memmove(starts, starts + i, (num_starts - i) * sizeof(size_t));
+                memmove(coffsets, coffsets + i,
+                        (num_starts - i) * sizeof(uint64_t));
+                num_starts -= i;
+                for (i = 0; i < num_starts; i++)
+                    starts[i] -= drop;
+                win_len    -= drop;
+                parse_from -= drop;
+            }
+
+            while (!final && win_len - parse_from < want) {
+                uint64_t block_coffset = coffset;
+                size_t n;
+                int got;
+
+                if (win_len + FQINDEX_BGZF_BLOCK > win_cap) {
+                    size_t cap = win_cap ? 2 * win_cap : 2 * FQINDEX_WINDOW;
+                    char *w = realloc(win, cap);
+                    if (w == NULL) {
+                        ret = FQINDEX_ENOMEM;
+                        goto done;
+                    }
+                    win     = w;
+                    win_cap = cap;
+                }
+                if (num_starts == starts_cap) {
+                    size_t cap = starts_cap ? 2 * starts_cap : 256;
+                    size_t *s = realloc(starts, cap * sizeof(size_t));
+                    uint64_t *c;
+                    if (s != NULL)
+                        starts = s;
+                    c = realloc(coffsets, cap * sizeof(uint64_t));
+                    if (s == NULL || c == NULL) {
+                        ret = FQINDEX_ENOMEM;
+                        goto done;
+                    }
+                    coffsets   = c;
+                    starts_cap = cap;
+                }
+
+                got = fqindex_bgzf_block(fd, &coffset, cbuf, &zs,
+                                         win + win_len, &n);
+                if (got < 0) {
+                    ret = FQINDEX_EREAD;
+                    goto done;
+                }
+                if (got == 0) {
+                    final = 1;
+                    break;
+                }
+                starts[num_starts]     = win_len;
+                coffsets[num_starts++] = block_coffset;
+                win_len += n;
+            }
+
+            want = FQINDEX_WINDOW;
+            mapfq_reset(reader, win, win_len);
+            reader->pos = parse_from;
+        }
+
+        pos  = mapfq_tell(reader);
+        more = mapfq_read(reader, &rec);
+        if (more < 0) {
+            ret = FQINDEX_ENOMEM;
+            break;
+        }
+
+        /* a record is whole once the next one (or its '+' line) is seen */
+        if ( !final &&
+             (more == 0 || (reader->done && reader->last_char == 0)) ) {
+            parse_from = pos;
+            want = 2 * (win_len - parse_from) + FQINDEX_BGZF_BLOCK;
+            continue;
+        }
+        if (more == 0)
+            break;
+
+        /* the last block starting at or before the record */
+        lo = 0;
+        hi = num_starts;
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (starts[mid] <= pos)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        offset = (coffsets[lo] << 16) | (uint64_t) (pos - starts[lo]);
+
+        if ( !fqindex_add_record(b, offset, rec.seq, rec.seq_l) ) {
+            ret = FQINDEX_ENOMEM;
+            break;
+        }
+        parse_from = mapfq_tell(reader);
+    }
+
+    if (ret == FQINDEX_OK && !b->second_pass)
+        b->blocks[b->num_blocks] = coffset << 16;
+
+done:
+    inflateEnd(&zs);
+    mapfq_close(reader);
+    free(cbuf);
+    free(win);
+    free(starts);
+    free(coffsets);
+    return ret;
+}
+
+/* write the index next to its input (by way of a temporary file) */
+static int
+fqindex_write(fqindex_builder *b,
+              uint32_t check,
+              const char *input,
+              const struct stat *st,
+              int bgzf) {
+    fqindex_header header;
+    size_t path_len = strlen(input) + sizeof(FQINDEX_SUFFIX) + 4;
+    size_t num_kmers = (size_t) b->mask + 1;
+    size_t num_found = 0, i;
+    uint64_t *offsets;
+    uint32_t *kmers;
+    char *path, *tmp_path;
+    FILE *fp = NULL;
+    int ok;
+
+    /* the directory holds the k-mers found only */
+    for (i = 0; i < num_kmers; i++)
+        num_found += b->directory[i + 1] > b->directory[i];
+
+    path     = malloc(path_len);
+    tmp_path = malloc(path_len);
+    offsets  = malloc((num_found + 1) * sizeof(uint64_t));
+    kmers    = malloc((num_found + 1) * sizeof(uint32_t));
+    if (path == NULL || tmp_path == NULL || offsets == NULL || kmers == NULL) {
+        free(path);
+        free(tmp_path);
+        free(offsets);
+        free(kmers);
+        return FQINDEX_ENOMEM;
+    }
+
+    for (i = 0, num_found = 0; i < num_kmers; i++) {
+        if (b->directory[i + 1] > b->directory[i]) {
+            kmers[num_found]     = (uint32_t) i;
+            offsets[num_found++] = b->directory[i];
+        }
+    }
+    offsets[num_found] = b->directory[num_kmers];
+    snprintf(path, path_len, "%s%s", input, FQINDEX_SUFFIX);
+    snprintf(tmp_path, path_len, "%s%s.tmp", input, FQINDEX_SUFFIX);
+
+    memset(&header, 0, sizeof(fqindex_header));
+    memcpy(header.magic, FQINDEX_MAGIC, sizeof(header.magic));
+    header.k                 = (uint32_t) b->k;
+    header.records_per_block = b->records_per_block;
+    header.bgzf              = (uint32_t) bgzf;
+    header.min_seq_length    = b->min_seq_length;
+    header.input_size        = (uint64_t) st->st_size;
+    header.input_mtime       = (int64_t) st->st_mtime;
+    header.input_mtime_nsec  = FQINDEX_MTIME_NSEC(st);
+    header.input_check       = check;
+    header.num_records       = b->num_records;
+    header.num_blocks        = b->num_blocks;
+    header.num_kmers         = num_found;
+    header.postings_len      = b->directory[num_kmers];
+
+    ok = (fp = fopen(tmp_path, "wb")) != NULL &&
+         fwrite(&header, sizeof(header), 1, fp) == 1 &&
+         fwrite(b->blocks, sizeof(uint64_t), b->num_blocks + 1, fp) ==
+             b->num_blocks + 1 &&
+         fwrite(offsets, sizeof(uint64_t), num_found + 1, fp) ==
+             num_found + 1 &&
+         fwrite(kmers, sizeof(uint32_t), num_found, fp) == num_found &&
+         fwrite(b->postings, 1, header.postings_len, fp) ==
+             header.postings_len;
+    if (fp != NULL)
+        ok = (fclose(fp) == 0) && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok)
+        unlink(tmp_path);
+
+    free(path);
+    free(tmp_path);
+    free(offsets);
+    free(kmers);
+    return ok ? FQINDEX_OK : FQINDEX_EWRITE;
+}
+
+/*
+   Index the plain or BGZF file 'input' into '<input>.fqi', by k-mers of
+   'k' bases and blocks of 'records_per_block' records.  The input is read
+   twice: once to size the posting lists, and once to fill them in.
+   Returns one of the FQINDEX_* codes.
+*/
+int
+fqindex_build(const char *input, int k, int records_per_block) {
+    fqindex_builder b;
+    struct stat st;
+    unsigned char magic[2] = { 0, 0 };
+    void *data = NULL;
+    size_t num_kmers, i;
+    uint64_t total;
+    uint32_t check;
+    int fd, bgzf, pass, ret = FQINDEX_OK;
+
+    if ( (fd = open(input, O_RDONLY)) < 0 )
+        return FQINDEX_EREAD;
+    if ( fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+         fqindex_input_check(fd, &st, &check) != 0 ) {
+        close(fd);
+        return FQINDEX_EREAD;
+    }
+
+    bgzf = pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+    if (!bgzf && st.st_size > 0) {
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return FQINDEX_EREAD;
+        }
+        madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+    }
+
+    memset(&b, 0, sizeof(fqindex_builder));
+    num_kmers           = (size_t) 1 << (2 * k);
+    b.k                 = k;
+    b.mask              = (uint64_t) num_kmers - 1;
+    b.records_per_block = (uint32_t) records_per_block;
+    b.last_block        = malloc(num_kmers * sizeof(uint32_t));
+    b.directory         = calloc(num_kmers + 1, sizeof(uint64_t));
+    b.blocks            = malloc(1024 * sizeof(uint64_t));
+    b.blocks_cap        = 1024;
+    b.min_seq_length    = UINT32_MAX;
+    if (b.last_block == NULL || b.directory == NULL || b.blocks == NULL) {
+        ret = FQINDEX_ENOMEM;
+        goto done;
+    }
+
+    for (pass = 0; pass < 2 && ret == FQINDEX_OK; pass++) {
+        memset(b.last_block, 0xff, num_kmers * sizeof(uint32_t));
+        b.num_records = 0;
+
+        if (bgzf)
+            ret = fqindex_scan_bgzf(&b, fd);
+        else
+            ret = fqindex_scan_plain(&b, data, (size_t) st.st_size);
+
+        /* gzip that is not BGZF cannot be read from an offset */
+        if (ret == FQINDEX_EREAD && bgzf && b.num_records == 0)
+            ret = FQINDEX_EFORMAT;
+
+        if (pass == 0 && ret == FQINDEX_OK) {
+            /* the sizes of the posting lists, turned into their offsets */
+            for (i = 0, total = 0; i < num_kmers; i++) {
+                uint64_t n = b.directory[i];
+                b.directory[i] = total;
+                total += n;
+            }
+            b.directory[num_kmers] = total;
+            if ( (b.postings = malloc(total ? total : 1)) == NULL )
+                ret = FQINDEX_ENOMEM;
+            b.second_pass = 1;
+        }
+    }
+
+    if (ret == FQINDEX_OK) {
+        /* every list was written up to where the next one starts */
+        memmove(b.directory + 1, b.directory, num_kmers * sizeof(uint64_t));
+        b.directory[0] = 0;
+        ret = fqindex_write(&b, check, input, &st, bgzf);
+    }
+
+done:
+    if (data != NULL)
+        munmap(data, (size_t) st.st_size);
+    close(fd);
+    free(b.last_block);
+    free(b.directory);
+    free(b.postings);
+    free(b.blocks);
+    return ret;
+}
+
+/*
+   The crc32 of the first and the last FQINDEX_CHECK_SIZE bytes of the
+   input (all of it, if it is smaller), which tells an input rewritten
+   at the same size and time apart.  Returns 0, or -1 if it could not be
+   read.
+*/
+static int
+fqindex_input_check(int fd, const struct stat *st, uint32_t *check) {
+    uint64_t size = (uint64_t) st->st_size;
+    uint64_t head = size < FQINDEX_CHECK_SIZE ? size : FQINDEX_CHECK_SIZE;
+    uint64_t tail = size - head < FQINDEX_CHECK_SIZE ? size - head
+                                                     : FQINDEX_CHECK_SIZE;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    unsigned char *buf;
+    int ret = 0;
+
+    if ( (buf = malloc(FQINDEX_CHECK_SIZE)) == NULL )
+        return -1;
+
+    if ( pread(fd, buf, (size_t) head, 0) == (ssize_t) head ) {
+        crc = crc32(crc, buf, (uInt) head);
+        if ( pread(fd, buf, (size_t) tail, (off_t) (size - tail)) ==
+             (ssize_t) tail )
+            crc = crc32(crc, buf, (uInt) tail);
+        else
+            ret = -1;
+    }
+    else {
+        ret = -1;
+    }
+
+    free(buf);
+    *check = (uint32_t) crc;
+    return ret;
+}
+
+/*
+   The index of 'input' (open as 'fd'), or NULL if it has none, or its
+   index is out of date, unreadable or out of memory.
+*/
+fqindex*
+fqindex_open(const char *input, int fd) {
+    fqindex *index;
+    const fqindex_header *header;
+    struct stat st, ist;
+    size_t path_len = strlen(input) + sizeof(FQINDEX_SUFFIX);
+    char *path;
+    void *map;
+    uint32_t check;
+    int ifd;
+
+    if ( (path = malloc(path_len)) == NULL )
+        return NULL;
+    snprintf(path, path_len, "%s%s", input, FQINDEX_SUFFIX);
+    ifd = open(path, O_RDONLY);
+    free(path);
+    if (ifd < 0)
+        return NULL;
+
+    if ( fstat(fd, &st) != 0 || fstat(ifd, &ist) != 0 ||
+         (size_t) ist.st_size < sizeof(fqindex_header) ) {
+        close(ifd);
+        return NULL;
+    }
+
+    map = mmap(NULL, (size_t) ist.st_size, PROT_READ, MAP_PRIVATE, ifd, 0);
+    close(ifd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    /* the index has to be whole, and of this very input */
+    header = map;
+    if ( memcmp(header->magic, FQINDEX_MAGIC, sizeof(header->magic)) != 0 ||
+         header->k < FQINDEX_MIN_K || header->k > FQINDEX_MAX_K ||
+         header->records_per_block == 0 ||
+         header->num_kmers > ((uint64_t) 1 << (2 * header->k)) ||
+         header->input_size != (uint64_t) st.st_size ||
+         header->input_mtime != (int64_t) st.st_mtime ||
+         header->input_mtime_nsec != FQINDEX_MTIME_NSEC(&st) ||
+         fqindex_input_check(fd, &st, &check) != 0 ||
+         header->input_check != check ||
+         (uint64_t) ist.st_size !=
+             sizeof(fqindex_header) +
+             (header->num_blocks + 1 + header->num_kmers + 1) *
+                 sizeof(uint64_t) +
+             header->num_kmers * sizeof(uint32_t) + header->postings_len ) {
+        munmap(map, (size_t) ist.st_size);
+        return NULL;
+    }
+
+    if ( (index = calloc(1, sizeof(fqindex))) == NULL ) {
+        munmap(map, (size_t) ist.st_size);
+        return NULL;
+    }
+
+    index->header    = header;
+    index->index_len = (size_t) ist.st_size;
+    index->blocks    = (const uint64_t *) (header + 1);
+    index->offsets   = index->blocks + header->num_blocks + 1;
+    index->kmers     = (const uint32_t *) (index->offsets +
+                                           header->num_kmers + 1);
+    index->postings  = (const unsigned char *) (index->kmers +
+                                                header->num_kmers);
+    index->fd        = fd;
+    index->reader    = mapfq_open_buffer(NULL, 0);
+    if (index->reader == NULL)
+        goto fail;
+
+    if (header->bgzf) {
+        index->cbuf = malloc(FQINDEX_BGZF_BLOCK);
+        if (index->cbuf == NULL || inflateInit2(&index->zs, -15) != Z_OK) {
+            free(index->cbuf);
+            index->cbuf = NULL;
+            goto fail;
+        }
+    }
+    else if (st.st_size > 0) {
+        map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            goto fail;
+        index->data     = map;
+        index->data_len = (size_t) st.st_size;
+    }
+
+    return index;
+
+fail:
+    fqindex_close(index);
+    return NULL;
+}
+
+/* the posting list of a k-mer, by a binary search of the directory */
+static void
+fqindex_list(const fqindex *index,
+             uint64_t kmer,
+             const unsigned char **list,
+             size_t *len) {
+    size_t lo = 0, hi = (size_t) index->header->num_kmers;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->kmers[mid] < kmer)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *list = index->postings;
+    *len  = 0;
+    if (lo < index->header->num_kmers && index->kmers[lo] == kmer) {
+        *list = index->postings + index->offsets[lo];
+        *len  = (size_t) (index->offsets[lo + 1] - index->offsets[lo]);
+    }
+}
+
+/* a posting list's block numbers; returns how many there are */
+static size_t
+fqindex_decode(const unsigned char *p, const unsigned char *end, uint32_t *out) {
+    uint64_t next = 0;
+    size_t n = 0;
+
+    while (p < end) {
+        uint64_t gap = 0;
+        int shift = 0;
+
+        do {
+            gap |= (uint64_t) (*p & 0x7f) << shift;
+            shift += 7;
+        } while (*p++ & 0x80 && p < end);
+
+        next += gap;
+        out[n++] = (uint32_t) next++;
+    }
+
+    return n;
+}
+
+/*
+   Pick the blocks that may hold matches of the (plain base) patterns,
+   searched with up to 'max_edits' edits.  Returns 1 if the index narrows
+   the search down, or 0 if the input has to be read in full.
+*/
+int
+fqindex_select(fqindex *index,
+               const char *const *patterns,
+               size_t num_patterns,
+               int max_edits) {
+    uint64_t num_blocks = index->header->num_blocks;
+    size_t k = index->header->k;
+    size_t words = (size_t) (num_blocks + 63) / 64;
+    uint64_t *candidates;
+    uint32_t *list = NULL, *other = NULL;
+    size_t list_cap = 0, i, j, w;
+    uint64_t count = 0;
+    int ok = 1;
+
+    if (max_edits < 0 || num_blocks == 0)
+        return 0;
+    if ( (candidates = calloc(words, sizeof(uint64_t))) == NULL )
+        return 0;
+
+    for (i = 0; i < num_patterns && ok; i++) {
+        const char *pattern = patterns[i];
+        size_t len = strlen(pattern);
+        size_t parts = (size_t) max_edits + 1, part;
+
+        if (len / parts < k) {
+            ok = 0;
+            break;
+        }
+        for (j = 0; j < len; j++)
+            if (fqindex_code((unsigned char) pattern[j]) == 0)
+                ok = 0;
+
+        for (part = 0; part < parts && ok; part++) {
+            size_t start = part * len / parts, end = (part + 1) * len / parts;
+            const unsigned char *lists[FQINDEX_MAX_LISTS];
+            size_t sizes[FQINDEX_MAX_LISTS];
+            size_t num_kmers = 0, n, m;
+
+            /* the part's k-mers with the shortest posting lists */
+            for (w = start; w + k <= end; w++) {
+                const unsigned char *list_start;
+                uint64_t kmer = 0;
+                size_t size, slot;
+
+                for (j = 0; j < k; j++)
+                    kmer = (kmer << 2) |
+                           (uint64_t) (fqindex_code((unsigned char)
+                                                    pattern[w + j]) - 1);
+                fqindex_list(index, kmer, &list_start, &size);
+
+                for (slot = num_kmers; slot > 0 && sizes[slot - 1] > size;
+                     slot--) {
+                    if (slot < FQINDEX_MAX_LISTS) {
+                        sizes[slot] = sizes[slot - 1];
+                        lists[slot] = lists[slot - 1];
+                    }
+                }
+                if (slot < FQINDEX_MAX_LISTS) {
+                    sizes[slot] = size;
+                    lists[slot] = list_start;
+                    if (num_kmers < FQINDEX_MAX_LISTS)
+                        num_kmers++;
+                }
+            }
+
+            /* a k-mer that is nowhere rules the part out */
+            if (sizes[0] == 0)
+                continue;
+
+            /* a list has at most as many entries as it has bytes */
+            if (sizes[num_kmers - 1] > list_cap) {
+                uint32_t *l, *o;
+                list_cap = sizes[num_kmers - 1];
+                l = realloc(list, list_cap * sizeof(uint32_t));
+                if (l != NULL)
+                    list = l;
+                o = realloc(other, list_cap * sizeof(uint32_t));
+                if (l == NULL || o == NULL) {
+                    ok = 0;
+                    break;
+                }
+                other = o;
+            }
+
+            n = fqindex_decode(lists[0], lists[0] + sizes[0], list);
+            for (j = 1; j < num_kmers && n > 0; j++) {
+                size_t a = 0, b = 0, kept = 0;
+                m = fqindex_decode(lists[j], lists[j] + sizes[j], other);
+                while (a < n && b < m) {
+                    if (list[a] < other[b])
+                        a++;
+                    else if (list[a] > other[b])
+                        b++;
+                    else {
+                        list[kept++] = list[a++];
+                        b++;
+                    }
+                }
+                n = kept;
+            }
+
+            for (j = 0; j < n; j++)
+                candidates[list[j] / 64] |= (uint64_t) 1 << (list[j] % 64);
+        }
+    }
+
+    free(list);
+    free(other);
+
+    for (w = 0; w < words && ok; w++)
+        count += (uint64_t) __builtin_popcountll(candidates[w]);
+
+    if (!ok || count * FQINDEX_MAX_SHARE > num_blocks) {
+        free(candidates);
+        return 0;
+    }
+
+    free(index->candidates);
+    index->candidates     = candidates;
+    index->num_candidates = count;
+    index->next_block     = 0;
+    return 1;
+}
+
+/*
+   Inflate the BGZF blocks holding the records from virtual offset 'start'
+   up to 'end', and parse them from there.  Returns 0, or -1 if the input
+   is corrupt (or out of memory).
+*/
+static int
+fqindex_fetch(fqindex *index, uint64_t start, uint64_t end) {
+    uint64_t coffset = start >> 16;
+    size_t len = 0, skip = (size_t) (start & 0xffff);
+
+    while ( coffset < (end >> 16) ||
+            (coffset == (end >> 16) && (end & 0xffff) != 0) ) {
+        uint64_t block_coffset = coffset;
+        size_t n;
+        int got;
+
+        if (len + FQINDEX_BGZF_BLOCK > index->buf_cap) {
+            size_t cap = index->buf_cap ? 2 * index->buf_cap
+                                        : 4 * FQINDEX_BGZF_BLOCK;
+            char *buf = realloc(index->buf, cap);
+            if (buf == NULL)
+                return -1;
+            index->buf     = buf;
+            index->buf_cap = cap;
+        }
+
+        got = fqindex_bgzf_block(index->fd, &coffset, index->cbuf,
+                                 &index->zs, index->buf + len, &n);
+        if (got < 0)
+            return -1;
+        if (got == 0)
+            break;
+        index->bytes_in += (size_t) (coffset - block_coffset);
+
+        if (block_coffset == (end >> 16)) {
+            len += (size_t) (end & 0xffff);
+            break;
+        }
+        len += n;
+    }
+
+    if (skip > len)
+        return -1;
+
+    mapfq_reset(index->reader, index->buf + skip, len - skip);
+    index->bytes_out += len - skip;
+    return 0;
+}
+
+/*
+   The next record of the candidate blocks.  Returns 1, 0 at the end of
+   them, -1 if out of memory or -2 if the input could not be read.
+*/
+int
+fqindex_read(fqindex *index, mapfq_record *rec) {
+    uint64_t num_blocks = index->header->num_blocks;
+
+    for (;;) {
+        uint64_t block, start, end;
+        int ret = mapfq_read(index->reader, rec);
+
+        if (ret != 0) {
+            /* the blocks of a BGZF input go through the one buffer */
+            if (index->cbuf != NULL)
+                rec->transient = 1;
+            return ret;
+        }
+
+        while ( index->next_block < num_blocks &&
+                !(index->candidates[index->next_block / 64] >>
+                  (index->next_block % 64) & 1) )
+            index->next_block++;
+        if (index->next_block >= num_blocks)
+            return 0;
+
+        block = index->next_block++;
+        start = index->blocks[block];
+        end   = index->blocks[block + 1];
+
+        if (index->cbuf != NULL) {
+            if (fqindex_fetch(index, start, end) < 0)
+                return -2;
+        }
+        else {
+            if (start > end || end > index->data_len)
+                return -2;
+            mapfq_reset(index->reader, index->data + start,
+                        (size_t) (end - start));
+            index->bytes_in  += (size_t) (end - start);
+            index->bytes_out += (size_t) (end - start);
+        }
+    }
+}
+
+/* the input's file descriptor is left open */
+void
+fqindex_close(fqindex *index) {
+    if (index == NULL)
+        return;
+
+    if (index->cbuf != NULL)
+        inflateEnd(&index->zs);
+    if (index->data != NULL)
+        munmap((void *) index->data, index->data_len);
+    munmap((void *) index->header, index->index_len);
+    mapfq_close(index->reader);
+    free(index->cbuf);
+    free(index->buf);
+    free(index->candidates);
+    free(index);
+}
+
+const char*
+fqindex_strerror(int code) {
+    switch (code) {
+        case FQINDEX_OK:
+            return "Success";
+        case FQINDEX_EREAD:
+            return "The input could not be read (or is corrupt)";
+        case FQINDEX_EFORMAT:
+            return "Only plain or BGZF (not gzip) input can be indexed";
+        case FQINDEX_ENOMEM:
+            return "Trouble with malloc. Out of memory!";
+        case FQINDEX_EWRITE:
+            return "The index could not be written";
+        default:
+            return "Unknown error";
+    }
+}
@@ -0,0 +1,155 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* k-mer index sidecars for repeated searches of the same input
+
+   'fqgrep index' writes '<input>.fqi' next to a plain or BGZF FASTQ/FASTA
+   file.  The records are taken in blocks of 'records_per_block', and the
+   index lists, for every k-mer of 'k' bases (A, C, G and T only, in any
+   case), the blocks whose sequences hold it:
+
+     header     -- FQINDEX_MAGIC, k, the block size, and the size,
+                   modification time (to the nanosecond) and a checksum
+                   of the first and last FQINDEX_CHECK_SIZE bytes of the
+                   input it was built from
+     blocks     -- num_blocks + 1 offsets: where each block of records
+                   starts (and the last one ends) in the input; byte
+                   offsets of a plain file, or BGZF virtual offsets
+                   (compressed block offset << 16 | offset within it)
+     directory  -- the k-mers found (of the 4^k), in ascending order,
+                   and where each one's posting list starts (and the
+                   last one ends)
+     postings   -- each k-mer's ascending block numbers, as the varint
+                   (LEB128) coded gaps between them
+
+   A search of an indexed input reads only the candidate blocks.  For a
+   pattern searched with up to 'max_edits' edits (of a cost of at least
+   1 each), it is cut into max_edits + 1 parts, one of which has to turn
+   up unchanged in a matching read (the pigeonhole principle).  The
+   candidates of a part are the blocks holding all of (the least common
+   few of) its k-mers, and those of the search are the union over the
+   parts and patterns.  The matchers still check every record read, so
+   the index only has to be a superset of the blocks with matches.
+
+   A pattern that cannot be cut into parts of at least 'k' plain bases, or
+   candidates that make up more than 1/FQINDEX_MAX_SHARE of the blocks,
+   leave the input to be read in full.  So does an index that is older than
+   its input, or built from a different file: one whose size, modification
+   time or checksum differ (an input rewritten within the same second, at
+   the same size, is told apart by the latter two).
+
+   The length of the shortest sequence is kept, for searches that stop at
+   a read shorter than the pattern.
+
+   The candidates' records are parsed by mapfq, with the same record
+   boundaries as the index was built with.
+*/
+
+#ifndef _FQINDEX_H_
+#define _FQINDEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "mapfq.h"
+
+/* D E F I N E S *************************************************************/
+#define FQINDEX_SUFFIX ".fqi"
+#define FQINDEX_MAGIC "FQGRPIX2"
+#define FQINDEX_DEFAULT_K 11
+#define FQINDEX_MIN_K 8
+#define FQINDEX_MAX_K 12
+#define FQINDEX_DEFAULT_BLOCK 64          /* records per block */
+#define FQINDEX_MAX_BLOCK 65536
+#define FQINDEX_MAX_SHARE 2               /* candidates at most 1/2 */
+#define FQINDEX_MAX_LISTS 4               /* k-mers intersected per part */
+#define FQINDEX_CHECK_SIZE 65536          /* input bytes checksummed, per end */
+
+#define FQINDEX_OK       0
+#define FQINDEX_EREAD   -1                /* the input could not be read */
+#define FQINDEX_EFORMAT -2                /* gzip input that is not BGZF */
+#define FQINDEX_ENOMEM  -3
+#define FQINDEX_EWRITE  -4                /* the index could not be written */
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    char     magic[8];
+    uint32_t k;
+    uint32_t records_per_block;
+    uint32_t bgzf;                        /* virtual offsets (or bytes) */
+    uint32_t min_seq_length;              /* of the shortest sequence */
+    uint64_t input_size;
+    int64_t  input_mtime;                 /* seconds */
+    int64_t  input_mtime_nsec;
+    uint32_t input_check;                 /* crc32 of its first, last bytes */
+    uint32_t reserved;
+    uint64_t num_records;
+    uint64_t num_blocks;
+    uint64_t num_kmers;                   /* in the directory */
+    uint64_t postings_len;
+} fqindex_header;
+
+typedef struct {
+    const fqindex_header *header;         /* the mapped index */
+    size_t         index_len;
+    const uint64_t *blocks;
+    const uint64_t *offsets;              /* the directory */
+    const uint32_t *kmers;
+    const unsigned char *postings;
+
+    int            fd;                    /* the input */
+    const char     *data;                 /* a plain input, mapped */
+    size_t         data_len;
+    unsigned char  *cbuf;                 /* a BGZF input's block */
+    char           *buf;                  /* its candidate records */
+    size_t         buf_cap;
+    z_stream       zs;
+
+    uint64_t       *candidates;           /* bitmap of the blocks to read */
+    uint64_t       num_candidates;
+    uint64_t       next_block;
+    mapfq_reader   *reader;               /* over the current block */
+    size_t         bytes_in;              /* read from the input */
+    size_t         bytes_out;             /* of records parsed */
+} fqindex;
+
+/* P R O T O T Y P E S *******************************************************/
+int fqindex_build(const char *input, int k, int records_per_block);
+fqindex* fqindex_open(const char *input, int fd);
+int fqindex_select(fqindex *index,
+                   const char *const *patterns,
+                   size_t num_patterns,
+                   int max_edits);
+int fqindex_read(fqindex *index, mapfq_record *rec);
+void fqindex_close(fqindex *index);
+const char* fqindex_strerror(int code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FQINDEX_H */
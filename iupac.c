@@ -0,0 +1,202 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* IUPAC degenerate base codes
+
+   See iupac.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "iupac.h"
+
+/* F U N C T I O N S *********************************************************/
+
+/* the base set of an IUPAC code (of either case), or 0 for anything else */
+int
+iupac_base_mask(char c) {
+    switch (toupper((unsigned char) c)) {
+        case 'A': return IUPAC_A;
+        case 'C': return IUPAC_C;
+        case 'G': return IUPAC_G;
+        case 'T': return IUPAC_T;
+        case 'U': return IUPAC_T;
+        case 'R': return IUPAC_A | IUPAC_G;
+        case 'Y': return IUPAC_C | IUPAC_T;
+        case 'K': return IUPAC_G | IUPAC_T;
+        case 'M': return IUPAC_A | IUPAC_C;
+        case 'S': return IUPAC_C | IUPAC_G;
+        case 'W': return IUPAC_A | IUPAC_T;
+        case 'B': return IUPAC_C | IUPAC_G | IUPAC_T;
+        case 'D': return IUPAC_A | IUPAC_G | IUPAC_T;
+        case 'H': return IUPAC_A | IUPAC_C | IUPAC_T;
+        case 'V': return IUPAC_A | IUPAC_C | IUPAC_G;
+        case 'N': return IUPAC_N;
+        default:  return 0;
+    }
+}
+
+/* true if the pattern only consists of IUPAC codes */
+int
+iupac_is_pattern(const char *pattern) {
+    if (*pattern == '\0')
+        return 0;
+
+    for ( ; *pattern; pattern++) {
+        if (iupac_base_mask(*pattern) == 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* true if the pattern has a code standing for more than one base */
+int
+iupac_is_degenerate(const char *pattern) {
+    for ( ; *pattern; pattern++) {
+        int mask = iupac_base_mask(*pattern);
+        if (mask != 0 && (mask & (mask - 1)) != 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+   Fill in the MYERS_ALPHABET_SIZE entry 'peq' table of a pattern of (at
+   most 64) IUPAC codes.
+*/
+void
+iupac_fill_peq(const char *pattern,
+               size_t pattern_len,
+               int read_n_wildcard,
+               uint64_t *peq) {
+    uint64_t any = 0;
+    size_t i;
+    int c;
+
+    memset(peq, 0, (1 << CHAR_BIT) * sizeof(uint64_t));
+
+    for (i = 0; i < pattern_len; i++) {
+        int mask = iupac_base_mask(pattern[i]);
+        const uint64_t bit = 1ULL << i;
+
+        if (mask == IUPAC_N)
+            any |= bit;
+        if (mask & IUPAC_A)
+            peq['A'] |= bit;
+        if (mask & IUPAC_C)
+            peq['C'] |= bit;
+        if (mask & IUPAC_G)
+            peq['G'] |= bit;
+        if (mask & IUPAC_T)
+            peq['T'] |= bit;
+    }
+
+    peq['U'] = peq['T'];
+    if (read_n_wildcard)
+        peq['N'] = ~0ULL;
+
+    for (c = 0; c < (1 << CHAR_BIT); c++) {
+        if (isupper(c))
+            peq[c] |= any;
+    }
+    for (c = 0; c < (1 << CHAR_BIT); c++) {
+        if (islower(c))
+            peq[c] = peq[toupper(c)];
+        else if (!isupper(c))
+            peq[c] = any;
+    }
+}
+
+/*
+   Write out a pattern of IUPAC codes as a (case insensitive) regular
+   expression that matches the same reads.  Returns a newly allocated
+   string, or NULL if out of memory.
+*/
+char*
+iupac_to_regex(const char *pattern, int read_n_wildcard) {
+    char *regex, *p;
+
+    regex = malloc(strlen(pattern) * IUPAC_REGEX_EXPANSION + 1);
+    if (regex == NULL)
+        return NULL;
+
+    for (p = regex; *pattern; pattern++) {
+        int mask = iupac_base_mask(*pattern);
+        char *class_start = p;
+
+        if (mask == IUPAC_N) {
+            *p++ = '.';
+            continue;
+        }
+
+        *p++ = '[';
+        if (mask & IUPAC_A)
+            *p++ = 'A';
+        if (mask & IUPAC_C)
+            *p++ = 'C';
+        if (mask & IUPAC_G)
+            *p++ = 'G';
+        if (mask & IUPAC_T) {
+            *p++ = 'T';
+            *p++ = 'U';
+        }
+        if (read_n_wildcard)
+            *p++ = 'N';
+        *p++ = ']';
+
+        /* a single base needs no class */
+        if (p - class_start == 3) {
+            class_start[0] = class_start[1];
+            p = class_start + 1;
+        }
+    }
+    *p = '\0';
+
+    return regex;
+}
+
+/*
+   Write the reverse complement of the 'len' bases of 'seq' to 'rc' (null
+   terminated), keeping the case.  IUPAC ambiguity codes are complemented
+   too (R <-> Y, K <-> M, B <-> V, D <-> H; S, W and N are their own
+   complement).  Returns 0 if 'seq' holds anything but base codes.
+*/
+int
+iupac_reverse_complement(const char *seq, size_t len, char *rc) {
+    static const char from[] = "ACGTURYKMSWBVDHNacgturykmswbvdhn";
+    static const char to[]   = "TGCAAYRMKSWVBHDNtgcaayrmkswvbhdn";
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        const char *p = seq[i] ? strchr(from, seq[i]) : NULL;
+        if (p == NULL)
+            return 0;
+        rc[len - 1 - i] = to[p - from];
+    }
+    rc[len] = '\0';
+
+    return 1;
+}
@@ -0,0 +1,79 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* IUPAC degenerate base codes
+
+   Each IUPAC code stands for a set of bases, held here as a 4 bit mask
+   (A = 1, C = 2, G = 4, T/U = 8):
+
+     R = A/G   Y = C/T   K = G/T   M = A/C   S = C/G   W = A/T
+     B = C/G/T   D = A/G/T   H = A/C/T   V = A/C/G   N = any base
+
+   A pattern of such codes is compiled into the per-character position
+   masks ('peq') of the bit-parallel matchers in myers.h: the entry of a
+   read character has a bit set for every pattern position whose base
+   set includes it.  A pattern 'N' matches any read character.  An 'N'
+   (or any other non-ACGTU character) in a read is a mismatch against
+   everything else, unless reads are searched with 'N' as a wildcard,
+   in which case it matches every pattern position.
+
+   For the (TRE) regular expression engine, the same pattern is written
+   out with a character class for each degenerate position.
+*/
+
+#ifndef _IUPAC_H_
+#define _IUPAC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+
+/* D E F I N E S *************************************************************/
+#define IUPAC_A 1
+#define IUPAC_C 2
+#define IUPAC_G 4
+#define IUPAC_T 8
+#define IUPAC_N (IUPAC_A | IUPAC_C | IUPAC_G | IUPAC_T)
+
+/* longest regular expression written out for a pattern character */
+#define IUPAC_REGEX_EXPANSION 8
+
+/* P R O T O T Y P E S *******************************************************/
+int iupac_base_mask(char c);
+int iupac_is_pattern(const char *pattern);
+int iupac_is_degenerate(const char *pattern);
+void iupac_fill_peq(const char *pattern,
+                    size_t pattern_len,
+                    int read_n_wildcard,
+                    uint64_t *peq);
+char* iupac_to_regex(const char *pattern, int read_n_wildcard);
+int iupac_reverse_complement(const char *seq, size_t len, char *rc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IUPAC_H */
@@ -0,0 +1,494 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* libfqgrep -- fqgrep's single pattern matching, as a library
+
+   See libfqgrep.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include <limits.h>
+#include <tre/tre.h>
+#include "libfqgrep.h"
+#include "engine.h"
+#include "bm.h"
+#include "myers.h"
+#include "iupac.h"
+#include "pack.h"
+
+/* D E F I N E S *************************************************************/
+/* packed sequences of up to ~5000 bases are kept on the stack */
+#define FQGREP_PACK_STACK_WORDS 256
+
+/* D A T A    S T R U C T U R E S ********************************************/
+struct fqgrep_matcher {
+    int           engine;         /* ENGINE_* (see engine.h) */
+    int           both_strands;
+    int           cost_substitutions;
+    bm_searcher   *bm;
+    bm_searcher   *bm_rc;
+    myers_pattern *myers;
+    myers_pattern *myers_rc;
+    int           max_edits;      /* of the bit-parallel search */
+    pack_pattern  *pack;
+    pack_pattern  *pack_rc;
+    int           max_substitutions; /* of the Hamming distance search */
+    regex_t       tre;
+    regex_t       tre_rc;
+    int           tre_compiled;   /* number of the above compiled */
+    regaparams_t  tre_params;
+};
+
+/* P R O T O T Y P E S *******************************************************/
+static int fqgrep_compile_tre(regex_t *regexp,
+                              const char *pattern,
+                              int iupac,
+                              int n_wildcard);
+static int fqgrep_myers_search(const fqgrep_matcher *matcher,
+                               const myers_pattern *mp,
+                               const char *seq,
+                               size_t len,
+                               myers_match *match);
+static int fqgrep_tre_search(const fqgrep_matcher *matcher,
+                             const regex_t *regexp,
+                             const char *seq,
+                             size_t len,
+                             regamatch_t *match,
+                             regmatch_t *pmatch);
+
+/* F U N C T I O N S *********************************************************/
+
+/* fqgrep's defaults: an exact search of the forward strand */
+void
+fqgrep_params_init(fqgrep_params *params) {
+    params->pattern            = NULL;
+    params->max_mismatches     = 0;
+    params->cost_insertions    = 1;
+    params->cost_deletions     = 1;
+    params->cost_substitutions = 1;
+    params->max_insertions     = INT_MAX;
+    params->max_deletions      = INT_MAX;
+    params->max_substitutions  = INT_MAX;
+    params->both_strands       = 0;
+    params->n_wildcard         = 0;
+    params->force_tre          = 0;
+}
+
+/* case insensitive extended syntax, with IUPAC codes as classes */
+static int
+fqgrep_compile_tre(regex_t *regexp,
+                   const char *pattern,
+                   int iupac,
+                   int n_wildcard) {
+    char *regex = NULL;
+    int errcode;
+
+    if (iupac && (regex = iupac_to_regex(pattern, n_wildcard)) == NULL)
+        return FQGREP_ENOMEM;
+
+    errcode = tre_regcomp(regexp, regex ? regex : pattern,
+                          REG_EXTENDED | REG_ICASE);
+    free(regex);
+
+    if (errcode == REG_ESPACE)
+        return FQGREP_ENOMEM;
+    return errcode ? FQGREP_EPATTERN : FQGREP_OK;
+}
+
+/*
+   Compile 'params' into '*matcher', with the engine 'engine_select'
+   picks for fqgrep as well.  Returns FQGREP_OK, or an error code with
+   '*matcher' set to NULL.
+*/
+int
+fqgrep_matcher_create(const fqgrep_params *params, fqgrep_matcher **matcher) {
+    fqgrep_matcher *m;
+    engine_choice choice;
+    const char *pattern;
+    char *pattern_rc = NULL;
+    size_t len;
+    int iupac, ret = FQGREP_OK;
+
+    if (matcher == NULL)
+        return FQGREP_EINVAL;
+    *matcher = NULL;
+
+    if ( params == NULL || params->pattern == NULL ||
+         (len = strlen(params->pattern)) == 0 ||
+         params->max_mismatches < 0 || params->cost_insertions < 0 ||
+         params->cost_deletions < 0 || params->cost_substitutions < 0 ||
+         params->max_insertions < 0 || params->max_deletions < 0 ||
+         params->max_substitutions < 0 )
+        return FQGREP_EINVAL;
+    pattern = params->pattern;
+
+    if ( (m = calloc(1, sizeof(fqgrep_matcher))) == NULL )
+        return FQGREP_ENOMEM;
+    m->both_strands       = params->both_strands != 0;
+    m->cost_substitutions = params->cost_substitutions;
+
+    /* the reverse complement is only defined for sequences of bases */
+    if (m->both_strands) {
+        if ( (pattern_rc = malloc(len + 1)) == NULL ) {
+            ret = FQGREP_ENOMEM;
+            goto fail;
+        }
+        if ( !iupac_reverse_complement(pattern, len, pattern_rc) ) {
+            ret = FQGREP_EINVAL;
+            goto fail;
+        }
+    }
+
+    engine_select(params, &choice);
+    m->engine            = choice.engine;
+    m->max_edits         = choice.max_edits;
+    m->max_substitutions = choice.max_substitutions;
+    iupac                = choice.iupac;
+
+    if (m->engine == ENGINE_HAMMING) {
+        m->pack = pack_pattern_create(pattern, len, 0);
+        if (m->both_strands)
+            m->pack_rc = pack_pattern_create(pattern_rc, len, 0);
+        if (m->pack == NULL || (m->both_strands && m->pack_rc == NULL)) {
+            ret = FQGREP_ENOMEM;
+            goto fail;
+        }
+    }
+    else if (m->engine == ENGINE_MYERS) {
+        if (iupac) {
+            m->myers = myers_pattern_create_iupac(pattern, len,
+                                                  params->n_wildcard);
+            if (m->both_strands)
+                m->myers_rc = myers_pattern_create_iupac(pattern_rc, len,
+                                                         params->n_wildcard);
+        }
+        else {
+            m->myers = myers_pattern_create(pattern, len);
+            if (m->both_strands)
+                m->myers_rc = myers_pattern_create(pattern_rc, len);
+        }
+        if (m->myers == NULL || (m->both_strands && m->myers_rc == NULL)) {
+            ret = FQGREP_ENOMEM;
+            goto fail;
+        }
+    }
+    else if (m->engine == ENGINE_TRE) {
+        tre_regaparams_default(&m->tre_params);
+        m->tre_params.max_cost   = params->max_mismatches;
+        m->tre_params.cost_ins   = params->cost_insertions;
+        m->tre_params.cost_del   = params->cost_deletions;
+        m->tre_params.cost_subst = params->cost_substitutions;
+        m->tre_params.max_ins    = params->max_insertions;
+        m->tre_params.max_del    = params->max_deletions;
+        m->tre_params.max_subst  = params->max_substitutions;
+
+        ret = fqgrep_compile_tre(&m->tre, pattern, iupac, params->n_wildcard);
+        if (ret != FQGREP_OK)
+            goto fail;
+        m->tre_compiled++;
+
+        if (m->both_strands) {
+            ret = fqgrep_compile_tre(&m->tre_rc, pattern_rc, iupac,
+                                     params->n_wildcard);
+            if (ret != FQGREP_OK)
+                goto fail;
+            m->tre_compiled++;
+        }
+    }
+    else {
+        m->bm = bm_searcher_create(pattern, len);
+        if (m->both_strands)
+            m->bm_rc = bm_searcher_create(pattern_rc, len);
+        if (m->bm == NULL || (m->both_strands && m->bm_rc == NULL)) {
+            ret = FQGREP_ENOMEM;
+            goto fail;
+        }
+    }
+
+    free(pattern_rc);
+    *matcher = m;
+    return FQGREP_OK;
+
+fail:
+    free(pattern_rc);
+    fqgrep_matcher_destroy(m);
+    return ret;
+}
+
+/* exact (IUPAC) searches only need the shift-and scan */
+static int
+fqgrep_myers_search(const fqgrep_matcher *matcher,
+                    const myers_pattern *mp,
+                    const char *seq,
+                    size_t len,
+                    myers_match *match) {
+    if (matcher->max_edits == 0)
+        return myers_exact_search(mp, seq, len, match);
+
+    return myers_search(mp, seq, len, matcher->max_edits, match);
+}
+
+/* returns 1 on a match, 0 if there is none and -1 if out of memory */
+static int
+fqgrep_tre_search(const fqgrep_matcher *matcher,
+                  const regex_t *regexp,
+                  const char *seq,
+                  size_t len,
+                  regamatch_t *match,
+                  regmatch_t *pmatch) {
+    int errcode;
+
+    memset(match, 0, sizeof(regamatch_t));
+    pmatch->rm_so = pmatch->rm_eo = 0;
+    match->pmatch = pmatch;
+    match->nmatch = 1;
+
+    errcode = tre_reganexec(regexp, seq, len, match, matcher->tre_params, 0);
+    if (errcode == REG_OK)
+        return 1;
+    return errcode == REG_ESPACE ? -1 : 0;
+}
+
+/*
+   Search one sequence.  With 'both_strands' the reverse complement wins
+   if it matches at a lower cost, or at the same cost but ending earlier.
+*/
+int
+fqgrep_match_one(const fqgrep_matcher *matcher,
+                 const char *seq,
+                 size_t len,
+                 fqgrep_match *match) {
+    if (matcher == NULL || match == NULL || (seq == NULL && len > 0))
+        return FQGREP_EINVAL;
+
+    memset(match, 0, sizeof(fqgrep_match));
+    match->strand = '+';
+
+    if (matcher->engine == ENGINE_BM) {
+        const char *found;
+        int which = 0;
+
+        if (matcher->bm_rc != NULL)
+            found = bm_searcher_search_either(matcher->bm, matcher->bm_rc,
+                                              seq, len, &which);
+        else
+            found = bm_searcher_search(matcher->bm, seq, len);
+
+        if (found != NULL) {
+            match->matched = 1;
+            match->strand  = which == 1 ? '-' : '+';
+            match->start   = (size_t) (found - seq);
+            match->end     = match->start + matcher->bm->needle_len;
+        }
+    }
+    else if (matcher->engine == ENGINE_HAMMING) {
+        uint64_t words[FQGREP_PACK_STACK_WORDS];
+        pack_arena arena = { words, 0, FQGREP_PACK_STACK_WORDS };
+        pack_seq packed;
+        pack_match m, m_rc;
+        int found;
+
+        /* only a very long sequence is packed on the heap */
+        if (pack_arena_words(len, 1) > arena.cap) {
+            arena.words = NULL;
+            arena.cap   = 0;
+            if ( !pack_arena_reserve(&arena, len, 1) )
+                return FQGREP_ENOMEM;
+        }
+        pack_arena_add(&arena, seq, len, 0, &packed);
+
+        found = pack_search(matcher->pack, &packed,
+                            matcher->max_substitutions, &m);
+        if ( matcher->pack_rc != NULL &&
+             pack_search(matcher->pack_rc, &packed,
+                         matcher->max_substitutions, &m_rc) &&
+             ( !found || m_rc.substitutions < m.substitutions ||
+               (m_rc.substitutions == m.substitutions &&
+                m_rc.start < m.start) ) ) {
+            found = 1;
+            m = m_rc;
+            match->strand = '-';
+        }
+        if (arena.words != words)
+            pack_arena_free(&arena);
+
+        if (found) {
+            match->matched           = 1;
+            match->start             = m.start;
+            match->end               = m.end;
+            match->num_mismatches    = m.substitutions *
+                                       matcher->cost_substitutions;
+            match->num_substitutions = m.substitutions;
+        }
+    }
+    else if (matcher->engine == ENGINE_MYERS) {
+        myers_match m, m_rc;
+        int found = fqgrep_myers_search(matcher, matcher->myers,
+                                        seq, len, &m);
+
+        if ( matcher->myers_rc != NULL &&
+             fqgrep_myers_search(matcher, matcher->myers_rc,
+                                 seq, len, &m_rc) &&
+             ( !found || m_rc.edits < m.edits ||
+               (m_rc.edits == m.edits && m_rc.end < m.end) ) ) {
+            found = 1;
+            m = m_rc;
+            match->strand = '-';
+        }
+
+        if (found) {
+            /* costs in the same units as TRE would report them */
+            match->matched           = 1;
+            match->start             = m.start;
+            match->end               = m.end;
+            match->num_mismatches    = m.edits * matcher->cost_substitutions;
+            match->num_insertions    = m.insertions;
+            match->num_deletions     = m.deletions;
+            match->num_substitutions = m.substitutions;
+        }
+    }
+    else {
+        regamatch_t m, m_rc;
+        regmatch_t pm, pm_rc;
+        int found = fqgrep_tre_search(matcher, &matcher->tre,
+                                      seq, len, &m, &pm);
+        int found_rc = 0;
+
+        if (found < 0)
+            return FQGREP_ENOMEM;
+
+        if (matcher->both_strands) {
+            found_rc = fqgrep_tre_search(matcher, &matcher->tre_rc,
+                                         seq, len, &m_rc, &pm_rc);
+            if (found_rc < 0)
+                return FQGREP_ENOMEM;
+        }
+
+        if ( found_rc &&
+             ( !found || m_rc.cost < m.cost ||
+               (m_rc.cost == m.cost && pm_rc.rm_eo < pm.rm_eo) ) ) {
+            found = 1;
+            m  = m_rc;
+            pm = pm_rc;
+            match->strand = '-';
+        }
+
+        if (found) {
+            match->matched           = 1;
+            match->start             = (size_t) pm.rm_so;
+            match->end               = (size_t) pm.rm_eo;
+            match->num_mismatches    = m.cost;
+            match->num_insertions    = m.num_ins;
+            match->num_deletions     = m.num_del;
+            match->num_substitutions = m.num_subst;
+        }
+    }
+
+    return FQGREP_OK;
+}
+
+/*
+   Search 'num_seqs' sequences, filling in 'matches[i]' for 'seqs[i]' of
+   length 'lens[i]'.  The number of matching sequences is stored in
+   'num_matched' (if not NULL).  On an error the results from the failing
+   sequence on are undefined.
+*/
+int
+fqgrep_match_batch(const fqgrep_matcher *matcher,
+                   const char *const *seqs,
+                   const size_t *lens,
+                   size_t num_seqs,
+                   fqgrep_match *matches,
+                   size_t *num_matched) {
+    size_t i, matched = 0;
+    int ret;
+
+    if (num_matched != NULL)
+        *num_matched = 0;
+
+    if ( matcher == NULL ||
+         (num_seqs > 0 && (seqs == NULL || lens == NULL || matches == NULL)) )
+        return FQGREP_EINVAL;
+
+    for (i = 0; i < num_seqs; i++) {
+        ret = fqgrep_match_one(matcher, seqs[i], lens[i], &matches[i]);
+        if (ret != FQGREP_OK)
+            return ret;
+        matched += (size_t) matches[i].matched;
+    }
+
+    if (num_matched != NULL)
+        *num_matched = matched;
+
+    return FQGREP_OK;
+}
+
+const char*
+fqgrep_matcher_engine(const fqgrep_matcher *matcher) {
+    if (matcher == NULL)
+        return NULL;
+
+    switch (matcher->engine) {
+        case ENGINE_BM:
+            return "boyer-moore";
+        case ENGINE_MYERS:
+            return matcher->max_edits == 0 ? "shift-and" : "bit-parallel";
+        case ENGINE_HAMMING:
+            return "hamming";
+        default:
+            return "tre";
+    }
+}
+
+const char*
+fqgrep_strerror(int code) {
+    switch (code) {
+        case FQGREP_OK:
+            return "Success";
+        case FQGREP_EINVAL:
+            return "Invalid pattern or parameters";
+        case FQGREP_ENOMEM:
+            return "Out of memory";
+        case FQGREP_EPATTERN:
+            return "Pattern could not be compiled";
+        default:
+            return "Unknown error";
+    }
+}
+
+void
+fqgrep_matcher_destroy(fqgrep_matcher *matcher) {
+    if (matcher == NULL)
+        return;
+
+    bm_searcher_destroy(matcher->bm);
+    bm_searcher_destroy(matcher->bm_rc);
+    myers_pattern_destroy(matcher->myers);
+    myers_pattern_destroy(matcher->myers_rc);
+    pack_pattern_destroy(matcher->pack);
+    pack_pattern_destroy(matcher->pack_rc);
+    if (matcher->tre_compiled > 0)
+        tre_regfree(&matcher->tre);
+    if (matcher->tre_compiled > 1)
+        tre_regfree(&matcher->tre_rc);
+    free(matcher);
+}
@@ -0,0 +1,128 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* libfqgrep -- fqgrep's single pattern matching, as a library
+
+   A matcher is compiled once from a pattern and the same parameters as
+   fqgrep's -m/-S/-I/-D/-s/-i/-d/-e, '--both-strands' and '--n-wildcard'
+   options, and picks the same engine fqgrep would (the rules are shared,
+   in engine.h):
+
+     boyer-moore   -- exact searches of a literal pattern (vectorized
+                      where the CPU allows)
+     shift-and /   -- exact IUPAC and unit cost approximate searches of
+     bit-parallel     patterns of up to 64 bases
+     hamming       -- substitution only searches ('max_insertions' and
+                      'max_deletions' at 0) of plain base patterns, over
+                      the 2-bit packed sequence
+     tre           -- everything else, or when 'force_tre' is set
+
+   Sequences are given as (pointer, length) pairs, and need not be null
+   terminated.  The results go into a caller provided array, one per
+   sequence.  Every function returns one of the FQGREP_* codes instead of
+   exiting; 'fqgrep_strerror' describes them.
+
+   A compiled matcher is never modified by a search, so any number of
+   threads may search with the same matcher at the same time.
+
+     fqgrep_params params;
+     fqgrep_matcher *matcher;
+
+     fqgrep_params_init(&params);
+     params.pattern = "GATTACA";
+     params.max_mismatches = 1;
+     if (fqgrep_matcher_create(&params, &matcher) == FQGREP_OK) {
+         fqgrep_match_batch(matcher, seqs, lens, n, matches, &num_matched);
+         fqgrep_matcher_destroy(matcher);
+     }
+
+   Build it with 'make libfqgrep.a' or 'make libfqgrep.so', and link with
+   -lfqgrep -ltre -lpthread.
+*/
+
+#ifndef _LIBFQGREP_H_
+#define _LIBFQGREP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+
+/* D E F I N E S *************************************************************/
+#define FQGREP_OK         0
+#define FQGREP_EINVAL    -1       /* missing or out of range parameters */
+#define FQGREP_ENOMEM    -2       /* out of memory */
+#define FQGREP_EPATTERN  -3       /* the pattern could not be compiled */
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    const char *pattern;
+    int max_mismatches;           /* total cost allowed (-m) [0] */
+    int cost_insertions;          /* -I [1] */
+    int cost_deletions;           /* -D [1] */
+    int cost_substitutions;       /* -S [1] */
+    int max_insertions;           /* -i [INT_MAX, unlimited] */
+    int max_deletions;            /* -d [INT_MAX] */
+    int max_substitutions;        /* -s [INT_MAX] */
+    int both_strands;             /* also search the reverse complement */
+    int n_wildcard;               /* 'N' in a sequence matches any base */
+    int force_tre;                /* always use the tre engine (-e) */
+} fqgrep_params;
+
+/* the leftmost (best) match of a sequence, as in fqgrep's '-r' report */
+typedef struct {
+    int    matched;
+    char   strand;                /* '+', or '-' for the reverse complement */
+    size_t start;                 /* offset of the first matched char */
+    size_t end;                   /* offset one past the last matched char */
+    int    num_mismatches;        /* total cost */
+    int    num_insertions;
+    int    num_deletions;
+    int    num_substitutions;
+} fqgrep_match;
+
+typedef struct fqgrep_matcher fqgrep_matcher;
+
+/* P R O T O T Y P E S *******************************************************/
+void fqgrep_params_init(fqgrep_params *params);
+int fqgrep_matcher_create(const fqgrep_params *params,
+                          fqgrep_matcher **matcher);
+int fqgrep_match_one(const fqgrep_matcher *matcher,
+                     const char *seq,
+                     size_t len,
+                     fqgrep_match *match);
+int fqgrep_match_batch(const fqgrep_matcher *matcher,
+                       const char *const *seqs,
+                       const size_t *lens,
+                       size_t num_seqs,
+                       fqgrep_match *matches,
+                       size_t *num_matched);
+const char* fqgrep_matcher_engine(const fqgrep_matcher *matcher);
+const char* fqgrep_strerror(int code);
+void fqgrep_matcher_destroy(fqgrep_matcher *matcher);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LIBFQGREP_H */
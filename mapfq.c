@@ -0,0 +1,313 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Zero-copy FASTQ/FASTA parsing of memory mapped (uncompressed) files
+
+   See mapfq.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "mapfq.h"
+
+/* D A T A    S T R U C T U R E S ********************************************/
+/* a sequence or quality string being gathered from one or more lines */
+typedef struct {
+    const char *s;
+    size_t     l;
+    size_t     lines;
+} mapfq_field;
+
+/* P R O T O T Y P E S *******************************************************/
+static size_t mapfq_line_end(const mapfq_reader *reader, size_t pos);
+static int    mapfq_append_line(char **buf,
+                                size_t *cap,
+                                mapfq_field *field,
+                                const char *line,
+                                size_t len);
+
+/* F U N C T I O N S *********************************************************/
+
+/*
+   Map 'fd' if it is a non-empty, uncompressed regular file.  Returns NULL
+   otherwise (or if it cannot be mapped), in which case the file should be
+   read as a stream.
+*/
+mapfq_reader*
+mapfq_open(int fd) {
+    mapfq_reader *reader;
+    struct stat st;
+    void *data;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+        return NULL;
+
+    data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    /* leave gzip (and BGZF) input to the decompressing reader */
+    if ( st.st_size >= 2 &&
+         ((unsigned char *) data)[0] == 0x1f &&
+         ((unsigned char *) data)[1] == 0x8b ) {
+        munmap(data, (size_t) st.st_size);
+        return NULL;
+    }
+
+    if ( (reader = calloc(1, sizeof(mapfq_reader))) == NULL ) {
+        munmap(data, (size_t) st.st_size);
+        return NULL;
+    }
+
+    madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+    reader->data   = data;
+    reader->len    = (size_t) st.st_size;
+    reader->mapped = 1;
+
+    return reader;
+}
+
+/* a reader of 'len' bytes at 'data'; returns NULL if out of memory */
+mapfq_reader*
+mapfq_open_buffer(const char *data, size_t len) {
+    mapfq_reader *reader;
+
+    if ( (reader = calloc(1, sizeof(mapfq_reader))) == NULL )
+        return NULL;
+
+    mapfq_reset(reader, data, len);
+    return reader;
+}
+
+/* start parsing a buffer reader over from 'data' */
+void
+mapfq_reset(mapfq_reader *reader, const char *data, size_t len) {
+    reader->data      = data;
+    reader->len       = len;
+    reader->pos       = 0;
+    reader->last_char = 0;
+    reader->done      = 0;
+}
+
+/* where the next record's header is (or is to be looked for from) */
+size_t
+mapfq_tell(const mapfq_reader *reader) {
+    return reader->last_char ? reader->pos - 1 : reader->pos;
+}
+
+/* offset of the newline ending the line at 'pos' (or the end of the file) */
+static size_t
+mapfq_line_end(const mapfq_reader *reader, size_t pos) {
+    const char *nl = memchr(reader->data + pos, '\n', reader->len - pos);
+    return nl ? (size_t) (nl - reader->data) : reader->len;
+}
+
+/*
+   Add a line to a field, as kseq appends it: a field of a single line is
+   left in place in the mapping, a second line moves it to 'buf'.  A
+   trailing '\r' is dropped.  Returns 0 if out of memory.
+*/
+static int
+mapfq_append_line(char **buf,
+                  size_t *cap,
+                  mapfq_field *field,
+                  const char *line,
+                  size_t len) {
+    if (field->lines++ == 0) {
+        field->s = line;
+        field->l = len;
+    }
+    else {
+        if (field->l + len + 1 > *cap) {
+            size_t new_cap = *cap ? *cap : 256;
+            char *new_buf;
+            while (field->l + len + 1 > new_cap)
+                new_cap *= 2;
+            if ( (new_buf = realloc(*buf, new_cap)) == NULL )
+                return 0;
+            /* realloc has already moved a field that was in 'buf' */
+            if (field->s == *buf)
+                field->s = new_buf;
+            *buf = new_buf;
+            *cap = new_cap;
+        }
+        if (field->s != *buf)
+            memmove(*buf, field->s, field->l);
+        memcpy(*buf + field->l, line, len);
+        field->s  = *buf;
+        field->l += len;
+    }
+
+    if (field->l > 1 && field->s[field->l - 1] == '\r')
+        field->l--;
+
+    return 1;
+}
+
+/*
+   Parse the next record into 'rec'.  Returns 1 on success, 0 at the end of
+   the input, or when a truncated FASTQ record is found ('kseq_read' stops
+   there too), and -1 if out of memory.
+*/
+int
+mapfq_read(mapfq_reader *reader, mapfq_record *rec) {
+    const char *d = reader->data;
+    const size_t n = reader->len;
+    size_t p = reader->pos;
+    size_t start, i, j;
+    mapfq_field seq  = { NULL, 0, 0 };
+    mapfq_field qual = { NULL, 0, 0 };
+    size_t plus_len = 0;
+    int c = -1;
+
+    if (reader->done)
+        return 0;
+
+    /* jump to the next header line */
+    if (reader->last_char == 0) {
+        while (p < n && d[p] != '>' && d[p] != '@')
+            p++;
+        if (p >= n) {
+            reader->done = 1;
+            return 0;
+        }
+        p++;
+    }
+    start = p - 1;
+
+    if (p >= n) {
+        reader->done = 1;
+        return 0;
+    }
+
+    /* the name ends at the first white space, the comment at the newline */
+    for (i = p; i < n && !isspace((unsigned char) d[i]); i++)
+        ;
+    rec->name      = d + p;
+    rec->name_l    = i - p;
+    rec->comment   = d + i;
+    rec->comment_l = 0;
+    p = (i < n) ? i + 1 : n;
+
+    if (i < n && d[i] != '\n' && p < n) {
+        j = mapfq_line_end(reader, p);
+        rec->comment   = d + p;
+        rec->comment_l = j - p;
+        if (rec->comment_l > 1 && d[j - 1] == '\r')
+            rec->comment_l--;
+        p = (j < n) ? j + 1 : n;
+    }
+
+    /* sequence lines, up to the next header or the '+' line */
+    while (p < n) {
+        c = (unsigned char) d[p++];
+        if (c == '>' || c == '+' || c == '@')
+            break;
+        if (c == '\n') {
+            c = -1;
+            continue;
+        }
+        j = mapfq_line_end(reader, p);
+        if ( !mapfq_append_line(&reader->seq_buf, &reader->seq_cap,
+                                &seq, d + p - 1, j - p + 1) )
+            return -1;
+        p = (j < n) ? j + 1 : n;
+        c = -1;
+    }
+
+    rec->seq       = seq.lines ? seq.s : d + p;
+    rec->seq_l     = seq.l;
+    rec->qual      = d + p;
+    rec->qual_l    = 0;
+    rec->raw       = NULL;
+    rec->raw_l     = 0;
+    rec->transient = seq.lines > 1;
+
+    if (c != '+') {
+        /* FASTA */
+        if (c == '>' || c == '@')
+            reader->last_char = c;
+        else
+            reader->done = 1;
+        reader->pos = p;
+        return 1;
+    }
+
+    /* skip the rest of the '+' line */
+    j = mapfq_line_end(reader, p);
+    if (j >= n) {
+        reader->done = 1;
+        return 0;
+    }
+    plus_len = j - p + 2;
+    p = j + 1;
+
+    /* quality lines, until there are as many as sequence characters */
+    do {
+        if (p >= n)
+            break;
+        j = mapfq_line_end(reader, p);
+        if ( !mapfq_append_line(&reader->qual_buf, &reader->qual_cap,
+                                &qual, d + p, j - p) )
+            return -1;
+        p = (j < n) ? j + 1 : n;
+    } while (qual.l < seq.l);
+
+    reader->last_char = 0;
+    reader->pos = p;
+
+    if (qual.l != seq.l) {
+        reader->done = 1;
+        return 0;
+    }
+
+    rec->qual      = qual.lines ? qual.s : d + p;
+    rec->qual_l    = qual.l;
+    rec->transient = seq.lines > 1 || qual.lines > 1;
+
+    /* the text is exactly "@name[ comment]\nseq\n+\nqual\n" */
+    if ( d[start] == '@' && d[p - 1] == '\n' && plus_len == 2 &&
+         (rec->comment_l == 0 || d[start + 1 + rec->name_l] == ' ') &&
+         p - start == 1 + rec->name_l +
+                      (rec->comment_l ? 1 + rec->comment_l : 0) + 1 +
+                      rec->seq_l + 1 + 2 + rec->qual_l + 1 ) {
+        rec->raw   = d + start;
+        rec->raw_l = p - start;
+    }
+
+    return 1;
+}
+
+void
+mapfq_close(mapfq_reader *reader) {
+    if (reader == NULL)
+        return;
+
+    if (reader->mapped)
+        munmap((void *) reader->data, reader->len);
+    free(reader->seq_buf);
+    free(reader->qual_buf);
+    free(reader);
+}
@@ -0,0 +1,97 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Zero-copy FASTQ/FASTA parsing of memory mapped (uncompressed) files
+
+   An uncompressed regular file is mapped into memory and its records are
+   handed out as pointer and length views into the mapping, rather than
+   being copied into buffers as kseq does.  The fields are therefore NOT
+   null terminated.
+
+   The records are split up exactly as 'kseq_read' splits them up (names
+   end at the first white space, '\r' line endings are dropped, blank
+   lines are skipped, multi-line sequences are joined), so the two are
+   interchangeable.  Only a sequence or quality string spread over more
+   than one line (or with a '\r' ending) has to be copied, into a scratch
+   buffer of the reader; such records are marked 'transient' as their
+   fields are only valid until the next 'mapfq_read'.
+
+   When a FASTQ record's text is exactly what fqgrep would print for it
+   ('@name comment', the sequence, '+' and the quality on one line each),
+   'raw' points at that text, so it can be written out as is.
+
+   'mapfq_open_buffer' parses a range of memory the caller owns (such as
+   a block of records found through an index), and 'mapfq_reset' moves
+   it on to another range.  'mapfq_tell' is the offset the next record
+   would be parsed from, so parsing can later be picked up from there.
+*/
+
+#ifndef _MAPFQ_H_
+#define _MAPFQ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    const char *name;
+    size_t     name_l;
+    const char *comment;
+    size_t     comment_l;
+    const char *seq;
+    size_t     seq_l;
+    const char *qual;
+    size_t     qual_l;
+    const char *raw;          /* the verbatim record text (or NULL) */
+    size_t     raw_l;
+    int        transient;     /* fields live in the reader's scratch space */
+} mapfq_record;
+
+typedef struct {
+    const char *data;         /* the mapped file (or the caller's buffer) */
+    size_t     len;
+    int        mapped;        /* 'data' is the reader's own mapping */
+    size_t     pos;
+    int        last_char;     /* header char already consumed (as kseq) */
+    int        done;
+    char       *seq_buf;      /* scratch space for multi-line fields */
+    size_t     seq_cap;
+    char       *qual_buf;
+    size_t     qual_cap;
+} mapfq_reader;
+
+/* P R O T O T Y P E S *******************************************************/
+mapfq_reader* mapfq_open(int fd);
+mapfq_reader* mapfq_open_buffer(const char *data, size_t len);
+void mapfq_reset(mapfq_reader *reader, const char *data, size_t len);
+size_t mapfq_tell(const mapfq_reader *reader);
+int mapfq_read(mapfq_reader *reader, mapfq_record *rec);
+void mapfq_close(mapfq_reader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MAPFQ_H */
@@ -0,0 +1,379 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Bit-parallel approximate (Levenshtein) pattern matching
+
+   See myers.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include <ctype.h>
+#include "myers.h"
+#include "iupac.h"
+
+/* F U N C T I O N S *********************************************************/
+
+/* true if the pattern only consists of (upper or lower case) A, C, G, T */
+int
+myers_is_dna_literal(const char *pattern) {
+    if (*pattern == '\0')
+        return 0;
+
+    for ( ; *pattern; pattern++) {
+        switch (*pattern) {
+            case 'A': case 'C': case 'G': case 'T':
+            case 'a': case 'c': case 'g': case 't':
+                break;
+            default:
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+myers_pattern*
+myers_pattern_create(const char *pattern, size_t pattern_len) {
+    myers_pattern *mp;
+    size_t i;
+
+    if (pattern_len == 0 || pattern_len > MYERS_MAX_PATTERN_LENGTH)
+        return NULL;
+
+    if ( (mp = calloc(1, sizeof(myers_pattern))) == NULL )
+        return NULL;
+
+    if ( (mp->pattern = malloc(pattern_len + 1)) == NULL ) {
+        free(mp);
+        return NULL;
+    }
+    memcpy(mp->pattern, pattern, pattern_len);
+    mp->pattern[pattern_len] = '\0';
+    mp->pattern_len = pattern_len;
+
+    for (i = 0; i < pattern_len; i++) {
+        unsigned char c = (unsigned char) pattern[i];
+        mp->peq[toupper(c)] |= 1ULL << i;
+        mp->peq[tolower(c)] |= 1ULL << i;
+    }
+
+    return mp;
+}
+
+/*
+   A pattern of IUPAC codes (see 'iupac_is_pattern'); with 'read_n_wildcard'
+   an 'N' in the text matches any pattern position.
+*/
+myers_pattern*
+myers_pattern_create_iupac(const char *pattern,
+                           size_t pattern_len,
+                           int read_n_wildcard) {
+    myers_pattern *mp = myers_pattern_create(pattern, pattern_len);
+
+    if (mp != NULL)
+        iupac_fill_peq(pattern, pattern_len, read_n_wildcard, mp->peq);
+
+    return mp;
+}
+
+/*
+   Recover the alignment of the pattern that ends at text offset 'end'
+   with 'edits' errors.  The alignment cannot span more than
+   pattern_len + edits text characters, so only that window is examined.
+*/
+void
+myers_traceback(const myers_pattern *mp,
+                const char *text,
+                size_t end,
+                int edits,
+                myers_match *match) {
+    int D[MYERS_MAX_PATTERN_LENGTH + 1][2 * MYERS_MAX_PATTERN_LENGTH + 1];
+    const size_t m = mp->pattern_len;
+    size_t w = m + (size_t) edits;
+    size_t i, j;
+    const char *window;
+
+    if (w > end)
+        w = end;
+    window = text + end - w;
+
+    for (j = 0; j <= w; j++)
+        D[0][j] = 0;
+
+    for (i = 1; i <= m; i++) {
+        D[i][0] = (int) i;
+        for (j = 1; j <= w; j++) {
+            int diag = D[i-1][j-1] +
+                !((mp->peq[(unsigned char) window[j-1]] >> (i-1)) & 1);
+            int del  = D[i-1][j] + 1;
+            int ins  = D[i][j-1] + 1;
+            int best = diag;
+            if (del < best)
+                best = del;
+            if (ins < best)
+                best = ins;
+            D[i][j] = best;
+        }
+    }
+
+    match->end           = end;
+    match->edits         = D[m][w];
+    match->insertions    = 0;
+    match->deletions     = 0;
+    match->substitutions = 0;
+
+    i = m;
+    j = w;
+    while (i > 0) {
+        int mismatch = (j > 0) &&
+            !((mp->peq[(unsigned char) window[j-1]] >> (i-1)) & 1);
+
+        if (j > 0 && D[i][j] == D[i-1][j-1] + mismatch) {
+            match->substitutions += mismatch;
+            i--;
+            j--;
+        }
+        else if (D[i][j] == D[i-1][j] + 1) {
+            match->deletions++;
+            i--;
+        }
+        else {
+            match->insertions++;
+            j--;
+        }
+    }
+
+    match->start = end - w + j;
+}
+
+/*
+   Search 'text' for the lowest cost occurrence of the pattern with at most
+   'max_edits' errors, preferring the earliest end position amongst equally
+   good matches.  Returns 1 and fills in 'match' if found, otherwise 0.
+*/
+int
+myers_search(const myers_pattern *mp,
+             const char *text,
+             size_t text_len,
+             int max_edits,
+             myers_match *match) {
+    const uint64_t last = 1ULL << (mp->pattern_len - 1);
+    uint64_t pv = ~0ULL;
+    uint64_t mv = 0;
+    int score = (int) mp->pattern_len;
+    int best_score = score;
+    size_t best_end = 0;
+    size_t j;
+
+    for (j = 0; j < text_len && best_score > 0; j++) {
+        uint64_t eq = mp->peq[(unsigned char) text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        if (ph & last)
+            score++;
+        else if (mh & last)
+            score--;
+
+        ph <<= 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        if (score < best_score) {
+            best_score = score;
+            best_end   = j + 1;
+        }
+    }
+
+    if (best_score > max_edits)
+        return 0;
+
+    myers_traceback(mp, text, best_end, best_score, match);
+    return 1;
+}
+
+/*
+   Search 'text' for the first exact occurrence of the pattern with the
+   shift-and algorithm.  Returns 1 and fills in 'match' if found,
+   otherwise 0.
+*/
+int
+myers_exact_search(const myers_pattern *mp,
+                   const char *text,
+                   size_t text_len,
+                   myers_match *match) {
+    const uint64_t last = 1ULL << (mp->pattern_len - 1);
+    uint64_t d = 0;
+    size_t j;
+
+    for (j = 0; j < text_len; j++) {
+        d = ((d << 1) | 1) & mp->peq[(unsigned char) text[j]];
+        if (d & last) {
+            match->start         = j + 1 - mp->pattern_len;
+            match->end           = j + 1;
+            match->edits         = 0;
+            match->insertions    = 0;
+            match->deletions     = 0;
+            match->substitutions = 0;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* character 'j' of the text, counting from the end if 'from_end' */
+#define ANCHORED_CHAR(text, text_len, j, from_end) \
+    ((unsigned char) (text)[(from_end) ? (text_len) - 1 - (j) : (j)])
+
+/*
+   Align the whole pattern against a prefix of 'text' with at most
+   'max_edits' errors, preferring the fewest errors and then the shortest
+   prefix.  With 'from_end' the text is read backwards, so 'mp' has to
+   hold the reversed pattern, and the alignment is against a suffix of
+   the text.  Returns 1 and fills in 'match' (in forward text offsets)
+   if found, otherwise 0.
+*/
+int
+myers_anchored_search(const myers_pattern *mp,
+                      const char *text,
+                      size_t text_len,
+                      int max_edits,
+                      int from_end,
+                      myers_match *match) {
+    int D[MYERS_MAX_PATTERN_LENGTH + 1][2 * MYERS_MAX_PATTERN_LENGTH + 1];
+    const size_t m = mp->pattern_len;
+    const uint64_t last = 1ULL << (m - 1);
+    uint64_t pv = ~0ULL;
+    uint64_t mv = 0;
+    int score = (int) m;
+    int best_score = score;
+    size_t best_end = 0;
+    size_t n = text_len;
+    size_t i, j;
+
+    if (max_edits > MYERS_MAX_PATTERN_LENGTH)
+        max_edits = MYERS_MAX_PATTERN_LENGTH;
+
+    /* no alignment with few enough errors spans more characters */
+    if (n > m + (size_t) max_edits)
+        n = m + (size_t) max_edits;
+
+    for (j = 0; j < n && best_score > 0; j++) {
+        uint64_t eq = mp->peq[ANCHORED_CHAR(text, text_len, j, from_end)];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        if (ph & last)
+            score++;
+        else if (mh & last)
+            score--;
+
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        if (score < best_score) {
+            best_score = score;
+            best_end   = j + 1;
+        }
+    }
+
+    if (best_score > max_edits)
+        return 0;
+
+    /* recover the alignment of the pattern with the first 'best_end' chars */
+    for (j = 0; j <= best_end; j++)
+        D[0][j] = (int) j;
+
+    for (i = 1; i <= m; i++) {
+        D[i][0] = (int) i;
+        for (j = 1; j <= best_end; j++) {
+            unsigned char c = ANCHORED_CHAR(text, text_len, j - 1, from_end);
+            int diag = D[i-1][j-1] + !((mp->peq[c] >> (i-1)) & 1);
+            int del  = D[i-1][j] + 1;
+            int ins  = D[i][j-1] + 1;
+            int best = diag;
+            if (del < best)
+                best = del;
+            if (ins < best)
+                best = ins;
+            D[i][j] = best;
+        }
+    }
+
+    match->edits         = D[m][best_end];
+    match->insertions    = 0;
+    match->deletions     = 0;
+    match->substitutions = 0;
+
+    i = m;
+    j = best_end;
+    while (i > 0 || j > 0) {
+        int mismatch = 1;
+
+        if (i > 0 && j > 0) {
+            unsigned char c = ANCHORED_CHAR(text, text_len, j - 1, from_end);
+            mismatch = !((mp->peq[c] >> (i-1)) & 1);
+        }
+
+        if (i > 0 && j > 0 && D[i][j] == D[i-1][j-1] + mismatch) {
+            match->substitutions += mismatch;
+            i--;
+            j--;
+        }
+        else if (i > 0 && D[i][j] == D[i-1][j] + 1) {
+            match->deletions++;
+            i--;
+        }
+        else {
+            match->insertions++;
+            j--;
+        }
+    }
+
+    if (from_end) {
+        match->start = text_len - best_end;
+        match->end   = text_len;
+    }
+    else {
+        match->start = 0;
+        match->end   = best_end;
+    }
+
+    return 1;
+}
+
+void
+myers_pattern_destroy(myers_pattern *mp) {
+    if (mp == NULL)
+        return;
+
+    free(mp->pattern);
+    free(mp);
+}
@@ -0,0 +1,110 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Bit-parallel approximate (Levenshtein) pattern matching
+
+   Gene Myers, "A fast bit-vector algorithm for approximate string
+   matching based on dynamic programming", J. ACM 46(3), 1999.
+
+   The whole pattern is held in a single 64-bit word, so patterns may be
+   at most MYERS_MAX_PATTERN_LENGTH characters long.  Matching is case
+   insensitive.  Once the best end position is known, the alignment is
+   recovered with a small dynamic programming traceback over the window
+   of text that can contain the match, which yields the start position
+   and the number of insertions (extra text characters), deletions
+   (pattern characters missing from the text) and substitutions.
+
+   Patterns of IUPAC degenerate base codes (see iupac.h) are compiled into
+   the same position masks, so they are searched at the same speed.  For
+   exact searches the masks drive a shift-and scan instead, which only
+   needs two word operations per text character.
+
+   An anchored search aligns the whole pattern against the start (or the
+   end) of the text, as adapter trimming needs: the top row of the
+   dynamic programming matrix then grows by one per text character, so
+   a +1 horizontal delta is shifted in at the top of every column.
+*/
+
+#ifndef _MYERS_H_
+#define _MYERS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+
+/* D E F I N E S *************************************************************/
+#define MYERS_MAX_PATTERN_LENGTH 64
+#define MYERS_ALPHABET_SIZE ( 1 << CHAR_BIT)
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    char     *pattern;
+    size_t   pattern_len;
+    uint64_t peq[MYERS_ALPHABET_SIZE];  /* pattern positions of each char */
+} myers_pattern;
+
+typedef struct {
+    size_t start;            /* offset of the first matched text char */
+    size_t end;              /* offset one past the last matched char */
+    int    edits;
+    int    insertions;
+    int    deletions;
+    int    substitutions;
+} myers_match;
+
+/* P R O T O T Y P E S *******************************************************/
+int myers_is_dna_literal(const char *pattern);
+myers_pattern* myers_pattern_create(const char *pattern, size_t pattern_len);
+myers_pattern* myers_pattern_create_iupac(const char *pattern,
+                                          size_t pattern_len,
+                                          int read_n_wildcard);
+int myers_exact_search(const myers_pattern *mp,
+                       const char *text,
+                       size_t text_len,
+                       myers_match *match);
+int myers_search(const myers_pattern *mp,
+                 const char *text,
+                 size_t text_len,
+                 int max_edits,
+                 myers_match *match);
+void myers_traceback(const myers_pattern *mp,
+                     const char *text,
+                     size_t end,
+                     int edits,
+                     myers_match *match);
+int myers_anchored_search(const myers_pattern *mp,
+                          const char *text,
+                          size_t text_len,
+                          int max_edits,
+                          int from_end,
+                          myers_match *match);
+void myers_pattern_destroy(myers_pattern *mp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MYERS_H */
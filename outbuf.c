@@ -0,0 +1,158 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Buffered output for the report functions
+
+   See outbuf.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <errno.h>
+#include <unistd.h>
+#include "outbuf.h"
+
+/* F U N C T I O N S *********************************************************/
+
+/* returns NULL if out of memory */
+outbuf*
+outbuf_open(int fd) {
+    return outbuf_create(fd, OUTBUF_SIZE, OUTBUF_PLAIN, 0);
+}
+
+/*
+   A buffer of 'size' bytes, whose output is BGZF compressed at 'level'
+   (1 to 9) by 'num_threads' threads (0 for none), unless 'level' is
+   OUTBUF_PLAIN.  Returns NULL if out of memory.
+*/
+outbuf*
+outbuf_create(int fd, size_t size, int level, int num_threads) {
+    outbuf *ob;
+
+    if ( (ob = calloc(1, sizeof(outbuf))) == NULL )
+        return NULL;
+
+    if ( (ob->buf = malloc(size)) == NULL ) {
+        free(ob);
+        return NULL;
+    }
+
+    if (level != OUTBUF_PLAIN &&
+        (ob->bgzw = bgzw_open(fd, level, num_threads)) == NULL) {
+        free(ob->buf);
+        free(ob);
+        return NULL;
+    }
+
+    ob->fd  = fd;
+    ob->cap = size;
+    return ob;
+}
+
+static void
+outbuf_write_fd(outbuf *ob, const char *data, size_t len) {
+    while (len > 0 && ob->error == 0) {
+        ssize_t n = write(ob->fd, data, len);
+        if (n < 0) {
+            if (errno != EINTR)
+                ob->error = errno;
+            continue;
+        }
+        data += n;
+        len  -= (size_t) n;
+    }
+}
+
+static void
+outbuf_send(outbuf *ob, const char *data, size_t len) {
+    ob->written += len;
+    if (ob->bgzw == NULL)
+        outbuf_write_fd(ob, data, len);
+    else if (ob->error == 0)
+        ob->error = bgzw_write(ob->bgzw, data, len);
+}
+
+/* a write that does not fit in what is left of the buffer */
+void
+outbuf_write_slow(outbuf *ob, const char *data, size_t len) {
+    size_t room = ob->cap - ob->len;
+
+    /* top up the buffer and send it on its way */
+    memcpy(ob->buf + ob->len, data, room);
+    ob->len += room;
+    data    += room;
+    len     -= room;
+    outbuf_flush(ob);
+
+    /* anything larger than the buffer itself is written directly */
+    if (len >= ob->cap) {
+        outbuf_send(ob, data, len);
+        return;
+    }
+
+    memcpy(ob->buf, data, len);
+    ob->len = len;
+}
+
+void
+outbuf_put_int(outbuf *ob, long value) {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    unsigned long v = (value < 0) ? 0UL - (unsigned long) value
+                                  : (unsigned long) value;
+
+    do {
+        *--p = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v);
+
+    if (value < 0)
+        *--p = '-';
+
+    outbuf_write(ob, p, (size_t) (digits + sizeof(digits) - p));
+}
+
+/* returns 0, or -1 if a write has failed */
+int
+outbuf_flush(outbuf *ob) {
+    outbuf_send(ob, ob->buf, ob->len);
+    ob->len = 0;
+    return ob->error ? -1 : 0;
+}
+
+/* flush and free the buffer (the file descriptor is left open) */
+int
+outbuf_close(outbuf *ob) {
+    int ret;
+
+    if (ob == NULL)
+        return 0;
+
+    outbuf_flush(ob);
+    if (ob->bgzw != NULL) {
+        int error = bgzw_close(ob->bgzw);
+        if (ob->error == 0)
+            ob->error = error;
+    }
+    ret = ob->error ? -1 : 0;
+    free(ob->buf);
+    free(ob);
+    return ret;
+}
@@ -0,0 +1,115 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Buffered output for the report functions
+
+   A replacement for stdio on the output path: fields of a known length
+   are copied straight into a large private buffer (no format string
+   parsing and no stream locking per call) and integers are formatted by
+   hand.  The buffer goes out in large 'write' calls.
+
+   A failed write is remembered and any further output is dropped;
+   'outbuf_flush' and 'outbuf_close' report it.
+
+   'outbuf_create' sets the buffer size, and can compress the output on
+   its way out as BGZF (see bgzw.h), by a pool of threads or in the
+   caller.  The byte counts ('outbuf_tell') are always of the
+   uncompressed output.
+*/
+
+#ifndef _OUTBUF_H_
+#define _OUTBUF_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "bgzw.h"
+
+/* D E F I N E S *************************************************************/
+#define OUTBUF_SIZE (1 << 20)
+#define OUTBUF_PLAIN -1           /* no compression */
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    int    fd;
+    int    error;             /* errno of a failed write (or 0) */
+    char   *buf;
+    size_t len;
+    size_t cap;
+    size_t written;           /* bytes sent on their way so far */
+    bgzw_writer *bgzw;        /* compression (or NULL) */
+} outbuf;
+
+/* P R O T O T Y P E S *******************************************************/
+outbuf* outbuf_open(int fd);
+outbuf* outbuf_create(int fd, size_t size, int level, int num_threads);
+void outbuf_write_slow(outbuf *ob, const char *data, size_t len);
+void outbuf_put_int(outbuf *ob, long value);
+int outbuf_flush(outbuf *ob);
+int outbuf_close(outbuf *ob);
+
+/*
+   The common case of a short write is inlined.  An empty field may come
+   as a NULL 'data' (e.g. the qualities of a FASTA record), which memcpy
+   may not be given.
+*/
+static inline void
+outbuf_write(outbuf *ob, const char *data, size_t len) {
+    if (len == 0)
+        return;
+
+    if (len <= ob->cap - ob->len) {
+        memcpy(ob->buf + ob->len, data, len);
+        ob->len += len;
+    }
+    else {
+        outbuf_write_slow(ob, data, len);
+    }
+}
+
+static inline void
+outbuf_puts(outbuf *ob, const char *str) {
+    outbuf_write(ob, str, strlen(str));
+}
+
+/* the total output so far, buffered or written */
+static inline size_t
+outbuf_tell(const outbuf *ob) {
+    return ob->written + ob->len;
+}
+
+static inline void
+outbuf_putc(outbuf *ob, char c) {
+    if (ob->len == ob->cap)
+        outbuf_write_slow(ob, &c, 1);
+    else
+        ob->buf[ob->len++] = c;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OUTBUF_H */
@@ -0,0 +1,478 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* 2-bit packed sequences, and the substitution-only kernel that scans them
+
+   See pack.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include "pack.h"
+
+/* D E F I N E S *************************************************************/
+#define PACK_EVEN_BITS 0x5555555555555555ULL
+#define PACK_COUNTER_BITS 7       /* counts up to 2 * PACK_SLICED_MAX_PATTERN */
+#define PACK_BYTES(c)  (0x0101010101010101ULL * (unsigned char) (c))
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PACK_SWAR 1
+#endif
+
+/* G L O B A L S *************************************************************/
+
+/*
+   A base's 2-bit code plus one; 0 for anything that is not a base.  The
+   code is bits 1-2 of the ASCII letter (either case), so 8 letters can
+   be packed at once without a lookup.
+*/
+static const unsigned char pack_codes[256] = {
+    ['A'] = 1, ['C'] = 2, ['T'] = 3, ['G'] = 4,
+    ['a'] = 1, ['c'] = 2, ['t'] = 3, ['g'] = 4
+};
+
+/* the same, for a case sensitive search */
+static const unsigned char pack_codes_upper[256] = {
+    ['A'] = 1, ['C'] = 2, ['T'] = 3, ['G'] = 4
+};
+
+/* P R O T O T Y P E S *******************************************************/
+static size_t pack_words(const char *seq,
+                         size_t len,
+                         int match_case,
+                         uint64_t *bases,
+                         uint64_t *nmask);
+#ifdef PACK_SWAR
+static inline uint64_t pack_zero_bytes(uint64_t v);
+#endif
+static inline uint64_t pack_window(const uint64_t *bases, size_t i);
+static inline uint64_t pack_spread(uint64_t x);
+static inline uint64_t pack_nwindow(const uint64_t *nmask, size_t i);
+static inline void pack_eq_masks(const pack_seq *seq, size_t w, uint64_t eq[4]);
+static inline uint64_t pack_eq_shifted(uint64_t eq[4][4],
+                                       size_t w,
+                                       size_t p,
+                                       unsigned char c);
+static int pack_search_sliced(const pack_pattern *pp,
+                              const pack_seq *seq,
+                              int max_substitutions,
+                              pack_match *match);
+static int pack_search_windows(const pack_pattern *pp,
+                               const pack_seq *seq,
+                               int max_substitutions,
+                               pack_match *match);
+static inline int pack_count(uint64_t x);
+
+/* F U N C T I O N S *********************************************************/
+
+/* the words a batch of 'num_seqs' sequences of 'num_bases' bases takes */
+size_t
+pack_arena_words(size_t num_bases, size_t num_seqs) {
+    return num_bases / PACK_BASES_PER_WORD +
+           num_bases / (2 * PACK_BASES_PER_WORD) + 4 * num_seqs;
+}
+
+/*
+   Make room for a batch of 'num_seqs' sequences of 'num_bases' bases in
+   all, and empty the arena.  Sequences added afterwards never move.
+   Returns 0 if out of memory.
+*/
+int
+pack_arena_reserve(pack_arena *arena, size_t num_bases, size_t num_seqs) {
+    size_t need = pack_arena_words(num_bases, num_seqs);
+
+    arena->len = 0;
+    if (need > arena->cap) {
+        uint64_t *words = realloc(arena->words, need * sizeof(uint64_t));
+        if (words == NULL)
+            return 0;
+        arena->words = words;
+        arena->cap   = need;
+    }
+
+    return 1;
+}
+
+#ifdef PACK_SWAR
+/* 0x80 in every byte of 'v' that is zero, and 0 in the others */
+static inline uint64_t
+pack_zero_bytes(uint64_t v) {
+    const uint64_t low = 0x7f7f7f7f7f7f7f7fULL;
+    return ~(((v & low) + low) | v | low);
+}
+#endif
+
+/*
+   Pack the bases of 'seq' into 'bases', and flag the other characters
+   in 'nmask' (if not NULL).  Both get a zero padding word, so a window
+   may always be taken from two neighboring words.  Returns the number
+   of characters that are not bases.
+*/
+static size_t
+pack_words(const char *seq,
+           size_t len,
+           int match_case,
+           uint64_t *bases,
+           uint64_t *nmask) {
+    const unsigned char *codes = match_case ? pack_codes_upper : pack_codes;
+    size_t i = 0, other = 0;
+
+    memset(bases, 0,
+           ((len + PACK_BASES_PER_WORD - 1) / PACK_BASES_PER_WORD + 1) *
+           sizeof(uint64_t));
+
+#ifdef PACK_SWAR
+    /* 8 letters at a time: bits 1-2 of each, gathered into 16 bits */
+    {
+        const uint64_t fold = match_case ? 0 : PACK_BYTES(0x20);
+        const char *a = match_case ? "ACGT" : "acgt";
+
+        for ( ; i + 8 <= len; i += 8) {
+            uint64_t x, y, valid;
+
+            memcpy(&x, seq + i, sizeof(x));
+            y = x | fold;
+            valid = pack_zero_bytes(y ^ PACK_BYTES(a[0])) |
+                    pack_zero_bytes(y ^ PACK_BYTES(a[1])) |
+                    pack_zero_bytes(y ^ PACK_BYTES(a[2])) |
+                    pack_zero_bytes(y ^ PACK_BYTES(a[3]));
+            if (valid != PACK_BYTES(0x80))
+                other += 8 - (size_t) __builtin_popcountll(valid);
+
+            x = (x >> 1) & PACK_BYTES(0x03);
+            x = (x | (x >> 6))  & 0x000f000f000f000fULL;
+            x = (x | (x >> 12)) & 0x000000ff000000ffULL;
+            x = (x | (x >> 24)) & 0x000000000000ffffULL;
+            bases[i / PACK_BASES_PER_WORD] |=
+                x << (2 * (i % PACK_BASES_PER_WORD));
+        }
+    }
+#endif
+
+    for ( ; i < len; i++) {
+        unsigned char code = codes[(unsigned char) seq[i]];
+        other += code == 0;
+        bases[i / PACK_BASES_PER_WORD] |=
+            (uint64_t) ((code - 1) & 3) << (2 * (i % PACK_BASES_PER_WORD));
+    }
+
+    if (nmask != NULL) {
+        memset(nmask, 0, (len / 64 + 2) * sizeof(uint64_t));
+        for (i = 0; i < len; i++)
+            if (codes[(unsigned char) seq[i]] == 0)
+                nmask[i / 64] |= 1ULL << (i % 64);
+    }
+
+    return other;
+}
+
+/*
+   Pack a sequence into the (reserved) arena.  With 'match_case' only
+   upper case letters are bases, and lower case ones are flagged in the
+   N mask (so they never match).
+*/
+void
+pack_arena_add(pack_arena *arena,
+               const char *seq,
+               size_t len,
+               int match_case,
+               pack_seq *packed) {
+    uint64_t *bases = arena->words + arena->len;
+    size_t num_words = len / PACK_BASES_PER_WORD + 2;
+
+    packed->bases = bases;
+    packed->nmask = NULL;
+    packed->len   = len;
+    arena->len   += num_words;
+
+    /* the N mask is only kept if there is anything to flag */
+    if ( pack_words(seq, len, match_case, bases, NULL) > 0 ) {
+        uint64_t *nmask = arena->words + arena->len;
+        pack_words(seq, len, match_case, bases, nmask);
+        packed->nmask = nmask;
+        arena->len   += len / (2 * PACK_BASES_PER_WORD) + 2;
+    }
+}
+
+void
+pack_arena_free(pack_arena *arena) {
+    free(arena->words);
+    arena->words = NULL;
+    arena->len   = 0;
+    arena->cap   = 0;
+}
+
+/*
+   Returns NULL if the pattern is not made up of A, C, G and T only (in
+   upper case, with 'match_case').
+*/
+pack_pattern*
+pack_pattern_create(const char *pattern, size_t pattern_len, int match_case) {
+    const unsigned char *codes = match_case ? pack_codes_upper : pack_codes;
+    pack_pattern *pp;
+    size_t i, rest;
+
+    if (pattern_len == 0)
+        return NULL;
+    for (i = 0; i < pattern_len; i++)
+        if (codes[(unsigned char) pattern[i]] == 0)
+            return NULL;
+
+    if ( (pp = calloc(1, sizeof(pack_pattern))) == NULL )
+        return NULL;
+
+    pp->num_words = (pattern_len + PACK_BASES_PER_WORD - 1) /
+                    PACK_BASES_PER_WORD;
+    pp->words = malloc((pp->num_words + 1) * sizeof(uint64_t));
+    pp->codes = malloc(pattern_len);
+    if (pp->words == NULL || pp->codes == NULL) {
+        pack_pattern_destroy(pp);
+        return NULL;
+    }
+    pack_words(pattern, pattern_len, match_case, pp->words, NULL);
+    for (i = 0; i < pattern_len; i++)
+        pp->codes[i] = codes[(unsigned char) pattern[i]] - 1;
+    pp->len = pattern_len;
+
+    rest = pattern_len - (pp->num_words - 1) * PACK_BASES_PER_WORD;
+    pp->last_mask = rest == PACK_BASES_PER_WORD ?
+                    PACK_EVEN_BITS :
+                    PACK_EVEN_BITS & ((1ULL << (2 * rest)) - 1);
+
+    return pp;
+}
+
+/* the 32 bases from base 'i' on */
+static inline uint64_t
+pack_window(const uint64_t *bases, size_t i) {
+    size_t q = i / PACK_BASES_PER_WORD;
+    unsigned int shift = (unsigned int) (i % PACK_BASES_PER_WORD) * 2;
+
+    return (bases[q] >> shift) | ((bases[q + 1] << 1) << (63 - shift));
+}
+
+/* 32 bits spread onto the even bits of a word */
+static inline uint64_t
+pack_spread(uint64_t x) {
+    x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+    x = (x | (x << 8))  & 0x00ff00ff00ff00ffULL;
+    x = (x | (x << 4))  & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x << 2))  & 0x3333333333333333ULL;
+    x = (x | (x << 1))  & PACK_EVEN_BITS;
+    return x;
+}
+
+/* the N flags of the 32 bases from base 'i' on, spread onto the even bits */
+static inline uint64_t
+pack_nwindow(const uint64_t *nmask, size_t i) {
+    size_t q = i / 64;
+    unsigned int shift = (unsigned int) (i % 64);
+
+    return pack_spread(((nmask[q] >> shift) |
+                        ((nmask[q + 1] << 1) << (63 - shift))) & 0xffffffffULL);
+}
+
+/* the number of (even) bits set */
+static inline int
+pack_count(uint64_t x) {
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int) ((x * 0x0101010101010101ULL) >> 56);
+}
+
+/* which of the 32 bases of word 'w' are each of the 4 bases (on even bits) */
+static inline void
+pack_eq_masks(const pack_seq *seq, size_t w, uint64_t eq[4]) {
+    uint64_t bases = seq->bases[w], known = PACK_EVEN_BITS;
+    int c;
+
+    if (seq->nmask != NULL)
+        known &= ~pack_spread((seq->nmask[w / 2] >> (32 * (w % 2))) &
+                              0xffffffffULL);
+
+    for (c = 0; c < 4; c++) {
+        uint64_t x = bases ^ (PACK_EVEN_BITS * (uint64_t) c);
+        eq[c] = ~(x | (x >> 1)) & known;
+    }
+}
+
+/* where pattern base 'p' (of code 'c') is, for the alignments of word 'w' */
+static inline uint64_t
+pack_eq_shifted(uint64_t eq[4][4], size_t w, size_t p, unsigned char c) {
+    size_t q = w + p / PACK_BASES_PER_WORD;
+    unsigned int shift = 2 * (unsigned int) (p % PACK_BASES_PER_WORD);
+    uint64_t lo = eq[q % 4][c];
+
+    return shift ? (lo >> shift) | (eq[(q + 1) % 4][c] << (64 - shift)) : lo;
+}
+
+/*
+   Patterns of up to PACK_SLICED_MAX_PATTERN bases: the 32 alignments
+   that start in a word are all tested at once, a pattern base at a
+   time, against the masks of where each base is in the sequence.  An
+   exact search ANDs the masks; otherwise the mismatches of every
+   alignment are added up in bit-sliced counters (bit i of all 32 counts
+   in one word), which saturate at the next power of two above the
+   limit.  Either way the pattern is only followed for as long as some
+   alignment is still alive.
+*/
+static int
+pack_search_sliced(const pack_pattern *pp,
+                   const pack_seq *seq,
+                   int max_substitutions,
+                   pack_match *match) {
+    const size_t m = pp->len, last = seq->len - m;
+    const size_t reach = (m - 1) / PACK_BASES_PER_WORD + 1;
+    uint64_t eq[4][4];            /* base masks of the next few words */
+    int limit = max_substitutions < (int) m ? max_substitutions : (int) m;
+    int bits = 0, best = limit + 1, i, v;
+    size_t best_start = 0, filled = 0, w, p;
+
+    while ( (1 << bits) <= limit )
+        bits++;
+
+    for (w = 0; w <= last / PACK_BASES_PER_WORD && best > 0; w++) {
+        uint64_t alive = PACK_EVEN_BITS, over = 0;
+        uint64_t counts[PACK_COUNTER_BITS];
+
+        for ( ; filled <= w + reach; filled++)
+            pack_eq_masks(seq, filled, eq[filled % 4]);
+
+        /* the alignments past the end of the sequence */
+        if (w == last / PACK_BASES_PER_WORD &&
+            last % PACK_BASES_PER_WORD != PACK_BASES_PER_WORD - 1)
+            alive &= (1ULL << (2 * (last % PACK_BASES_PER_WORD) + 2)) - 1;
+
+        if (bits == 0) {
+            for (p = 0; p < m && alive != 0; p++)
+                alive &= pack_eq_shifted(eq, w, p, pp->codes[p]);
+            if (alive != 0) {
+                best = 0;
+                best_start = w * PACK_BASES_PER_WORD +
+                             (size_t) __builtin_ctzll(alive) / 2;
+            }
+            continue;
+        }
+
+        for (i = 0; i < bits; i++)
+            counts[i] = 0;
+
+        for (p = 0; p < m && alive != 0; p++) {
+            uint64_t carry = ~pack_eq_shifted(eq, w, p, pp->codes[p]);
+
+            for (i = 0; i < bits; i++) {
+                uint64_t t = counts[i] & carry;
+                counts[i] ^= carry;
+                carry = t;
+            }
+            over  |= carry;
+            alive &= ~over;
+        }
+
+        /* the fewest substitutions in this word, and the leftmost of those */
+        for (v = 0; v < best && alive != 0; v++) {
+            uint64_t hit = alive;
+            for (i = 0; i < bits; i++)
+                hit &= ((v >> i) & 1) ? counts[i] : ~counts[i];
+            if (hit != 0) {
+                best = v;
+                best_start = w * PACK_BASES_PER_WORD +
+                             (size_t) __builtin_ctzll(hit) / 2;
+            }
+        }
+    }
+
+    if (best > limit)
+        return 0;
+
+    match->start         = best_start;
+    match->end           = best_start + m;
+    match->substitutions = best;
+    return 1;
+}
+
+/* longer patterns: a 32 base window of the sequence per pattern word */
+static int
+pack_search_windows(const pack_pattern *pp,
+                    const pack_seq *seq,
+                    int max_substitutions,
+                    pack_match *match) {
+    const size_t m = pp->len;
+    int best = max_substitutions + 1;
+    size_t best_start = 0, i, w;
+
+    for (i = 0; i + m <= seq->len && best > 0; i++) {
+        int subs = 0;
+
+        for (w = 0; w < pp->num_words && subs < best; w++) {
+            size_t at = i + w * PACK_BASES_PER_WORD;
+            uint64_t mask = w + 1 < pp->num_words ?
+                            PACK_EVEN_BITS : pp->last_mask;
+            uint64_t x = pack_window(seq->bases, at) ^ pp->words[w];
+
+            x = (x | (x >> 1)) & mask;
+            if (seq->nmask != NULL)
+                x |= pack_nwindow(seq->nmask, at) & mask;
+            subs += pack_count(x);
+        }
+        if (subs < best) {
+            best = subs;
+            best_start = i;
+        }
+    }
+
+    if (best > max_substitutions)
+        return 0;
+
+    match->start         = best_start;
+    match->end           = best_start + m;
+    match->substitutions = best;
+    return 1;
+}
+
+/*
+   Find the alignment of the pattern with the fewest substitutions (and
+   the leftmost of those), if it has at most 'max_substitutions'.  Returns
+   1 if there is one, otherwise 0.
+*/
+int
+pack_search(const pack_pattern *pp,
+            const pack_seq *seq,
+            int max_substitutions,
+            pack_match *match) {
+    if (max_substitutions < 0 || seq->len < pp->len)
+        return 0;
+
+    if (pp->len <= PACK_SLICED_MAX_PATTERN)
+        return pack_search_sliced(pp, seq, max_substitutions, match);
+
+    return pack_search_windows(pp, seq, max_substitutions, match);
+}
+
+void
+pack_pattern_destroy(pack_pattern *pp) {
+    if (pp == NULL)
+        return;
+
+    free(pp->words);
+    free(pp->codes);
+    free(pp);
+}
@@ -0,0 +1,115 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* 2-bit packed sequences, and the substitution-only kernel that scans them
+
+   A sequence is packed into 64-bit words of 32 bases each, 2 bits per
+   base (A = 0, C = 1, T = 2, G = 3: bits 1-2 of the ASCII letter, so 8
+   letters are packed at once), base i at bits 2 * (i % 32) of word
+   i / 32.  Any other character (an 'N', mostly) is packed as an A, and
+   flagged in an N mask of 64 bases per word, which only the sequences
+   that have such characters carry.  Lower case bases are packed as
+   bases, or flagged, for a case sensitive search ('match_case').  The
+   packed form of a batch of reads goes into one contiguous arena,
+   reserved up front for the whole batch, at about a quarter of the
+   memory of the text.
+
+   A word of a sequence is turned into 4 masks of where each base is
+   (the flagged characters are no base), with a bit per base.  For a
+   pattern of up to 64 bases, the 32 alignments that start in a word are
+   then tested together, one pattern base at a time: an exact search
+   ANDs the (shifted) masks of the pattern's bases, and a substitution
+   search adds the mismatches up in bit-sliced counters.  Either stops as
+   soon as no alignment is left.  A longer pattern is compared with each
+   32 base window of the sequence by one XOR per word; the base pairs
+   that differ are folded onto one bit each and counted.
+
+   'pack_search' reports the alignment with the fewest substitutions (of
+   at most 'max_substitutions'), and the leftmost of those; with
+   'max_substitutions' at 0 this is the leftmost exact occurrence.
+*/
+
+#ifndef _PACK_H_
+#define _PACK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+
+/* D E F I N E S *************************************************************/
+#define PACK_BASES_PER_WORD 32
+#define PACK_SLICED_MAX_PATTERN 64
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    const uint64_t *bases;        /* 32 bases per word */
+    const uint64_t *nmask;        /* 64 bases per word (or NULL: none) */
+    size_t         len;
+} pack_seq;
+
+typedef struct {
+    uint64_t *words;
+    size_t   len;
+    size_t   cap;
+} pack_arena;
+
+typedef struct {
+    uint64_t      *words;
+    unsigned char *codes;         /* the 2-bit code of each base */
+    size_t        num_words;
+    uint64_t      last_mask;      /* the bits of the last word in use */
+    size_t        len;
+} pack_pattern;
+
+typedef struct {
+    size_t start;                 /* offset of the first matched base */
+    size_t end;                   /* offset one past the last matched base */
+    int    substitutions;
+} pack_match;
+
+/* P R O T O T Y P E S *******************************************************/
+size_t pack_arena_words(size_t num_bases, size_t num_seqs);
+int pack_arena_reserve(pack_arena *arena, size_t num_bases, size_t num_seqs);
+void pack_arena_add(pack_arena *arena,
+                    const char *seq,
+                    size_t len,
+                    int match_case,
+                    pack_seq *packed);
+void pack_arena_free(pack_arena *arena);
+pack_pattern* pack_pattern_create(const char *pattern,
+                                  size_t pattern_len,
+                                  int match_case);
+int pack_search(const pack_pattern *pp,
+                const pack_seq *seq,
+                int max_substitutions,
+                pack_match *match);
+void pack_pattern_destroy(pack_pattern *pp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PACK_H */
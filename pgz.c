@@ -0,0 +1,620 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Threaded (and for BGZF, parallel) decompression of input streams
+
+   See pgz.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include "pgz.h"
+
+/* D E F I N E S *************************************************************/
+/* chunk states */
+#define PGZ_CHUNK_EMPTY     0    /* free for the producer */
+#define PGZ_CHUNK_FILLED    1    /* holds BGZF blocks waiting for a worker */
+#define PGZ_CHUNK_INFLATING 2
+#define PGZ_CHUNK_READY     3    /* holds data for the consumer */
+
+/* P R O T O T Y P E S *******************************************************/
+static int  pgz_fill_input(pgz_reader *reader);
+static int  pgz_read_exact(pgz_reader *reader, unsigned char *dst, size_t n);
+static int  pgz_is_bgzf(const unsigned char *header, size_t len, size_t *bsize);
+static int  pgz_fill_bgzf_chunk(pgz_reader *reader, pgz_chunk *chunk);
+static int  pgz_fill_stream_chunk(pgz_reader *reader, pgz_chunk *chunk);
+static int  pgz_inflate_chunk(pgz_chunk *chunk);
+static void* pgz_producer_thread(void *arg);
+static void* pgz_worker_thread(void *arg);
+
+/* F U N C T I O N S *********************************************************/
+
+/*
+   Start decompressing 'fd' in the background.  'num_workers' is the
+   number of threads used to inflate BGZF input.  Returns NULL if out of
+   memory or if the threads could not be started.
+*/
+pgz_reader*
+pgz_open(int fd, int num_workers) {
+    pgz_reader *reader;
+    size_t i, bsize;
+    int j;
+
+    if (num_workers < 1)
+        num_workers = 1;
+
+    if ( (reader = calloc(1, sizeof(pgz_reader))) == NULL )
+        return NULL;
+
+    reader->fd = fd;
+    reader->total_chunks = SIZE_MAX;
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->cond, NULL);
+
+    if ( (reader->ibuf = malloc(PGZ_INPUT_BUFFER_SIZE)) == NULL ) {
+        free(reader);
+        return NULL;
+    }
+
+    /* sniff the format from the first bytes of the input */
+    while (!reader->ieof && reader->ibuf_len < 18) {
+        if (pgz_fill_input(reader) < 0) {
+            reader->error = 1;
+            break;
+        }
+    }
+
+    if (reader->ibuf_len >= 2 &&
+        reader->ibuf[0] == 0x1f && reader->ibuf[1] == 0x8b) {
+        reader->format =
+            pgz_is_bgzf(reader->ibuf, reader->ibuf_len, &bsize) ?
+                PGZ_BGZF : PGZ_GZIP;
+    }
+    else {
+        reader->format = PGZ_PLAIN;
+    }
+
+    if (reader->format == PGZ_GZIP) {
+        if (inflateInit2(&reader->zs, 15 + 16) != Z_OK) {
+            free(reader->ibuf);
+            free(reader);
+            return NULL;
+        }
+    }
+
+    reader->num_workers = (reader->format == PGZ_BGZF) ? num_workers : 0;
+    reader->num_chunks  = (reader->format == PGZ_BGZF) ?
+                          2 * (size_t) num_workers + 2 : 4;
+    reader->chunks  = calloc(reader->num_chunks, sizeof(pgz_chunk));
+    reader->workers = calloc(reader->num_workers + 1, sizeof(pthread_t));
+    if (reader->chunks == NULL || reader->workers == NULL)
+        goto fail;
+
+    for (i = 0; i < reader->num_chunks; i++) {
+        pgz_chunk *chunk = &reader->chunks[i];
+        chunk->out = malloc(PGZ_CHUNK_SIZE);
+        if (chunk->out == NULL)
+            goto fail;
+        if (reader->format == PGZ_BGZF) {
+            chunk->in = malloc(PGZ_BLOCKS_PER_CHUNK * PGZ_BGZF_MAX_BLOCK_SIZE);
+            if (chunk->in == NULL)
+                goto fail;
+        }
+    }
+
+    if (pthread_create(&reader->producer, NULL,
+                       pgz_producer_thread, reader) != 0)
+        goto fail;
+
+    for (j = 0; j < reader->num_workers; j++) {
+        if (pthread_create(&reader->workers[j], NULL,
+                           pgz_worker_thread, reader) != 0) {
+            /* let the producer and the started workers wind down */
+            reader->num_workers = j;
+            pgz_close(reader);
+            return NULL;
+        }
+    }
+
+    return reader;
+
+fail:
+    if (reader->chunks != NULL) {
+        for (i = 0; i < reader->num_chunks; i++) {
+            free(reader->chunks[i].in);
+            free(reader->chunks[i].out);
+        }
+    }
+    if (reader->format == PGZ_GZIP)
+        inflateEnd(&reader->zs);
+    free(reader->chunks);
+    free(reader->workers);
+    free(reader->ibuf);
+    free(reader);
+    return NULL;
+}
+
+/*
+   Read up to 'len' decompressed bytes into 'buf'.  Like 'gzread', less
+   than 'len' bytes are only returned at the end of the input.  Returns
+   the number of bytes read, or -1 if the input is corrupt or unreadable.
+*/
+int
+pgz_read(pgz_reader *reader, void *buf, unsigned int len) {
+    unsigned char *dst = buf;
+    size_t copied = 0;
+
+    while (copied < len) {
+        pgz_chunk *chunk = reader->current;
+        size_t n;
+
+        if (chunk == NULL) {
+            size_t slot = reader->next_read % reader->num_chunks;
+            struct timespec t0, t1;
+            int waited = 0;
+
+            pthread_mutex_lock(&reader->lock);
+            while ( !reader->error &&
+                    reader->next_read < reader->total_chunks &&
+                    !(reader->chunks[slot].state == PGZ_CHUNK_READY &&
+                      reader->chunks[slot].seqno == reader->next_read) ) {
+                if (!waited++)
+                    clock_gettime(CLOCK_MONOTONIC, &t0);
+                pthread_cond_wait(&reader->cond, &reader->lock);
+            }
+            if (waited) {
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                reader->wait_seconds +=
+                    (double) (t1.tv_sec - t0.tv_sec) +
+                    (double) (t1.tv_nsec - t0.tv_nsec) / 1e9;
+            }
+
+            if (reader->error) {
+                pthread_mutex_unlock(&reader->lock);
+                return -1;
+            }
+            if (reader->next_read >= reader->total_chunks) {
+                pthread_mutex_unlock(&reader->lock);
+                break;
+            }
+            pthread_mutex_unlock(&reader->lock);
+
+            chunk = reader->current = &reader->chunks[slot];
+            reader->current_pos = 0;
+        }
+
+        n = chunk->out_len - reader->current_pos;
+        if (n > len - copied)
+            n = len - copied;
+        memcpy(dst + copied, chunk->out + reader->current_pos, n);
+        copied += n;
+        reader->current_pos += n;
+
+        /* hand the used up chunk back to the producer */
+        if (reader->current_pos == chunk->out_len) {
+            pthread_mutex_lock(&reader->lock);
+            chunk->state = PGZ_CHUNK_EMPTY;
+            reader->next_read++;
+            pthread_cond_broadcast(&reader->cond);
+            pthread_mutex_unlock(&reader->lock);
+            reader->current = NULL;
+        }
+    }
+
+    reader->bytes_out += copied;
+    return (int) copied;
+}
+
+int
+pgz_format(const pgz_reader *reader) {
+    return reader->format;
+}
+
+/*
+   The byte counts and the consumer's wait so far; 'bytes_in' is only
+   complete once the input has been read to its end.
+*/
+void
+pgz_stats(pgz_reader *reader,
+          size_t *bytes_in,
+          size_t *bytes_out,
+          double *wait_seconds) {
+    pthread_mutex_lock(&reader->lock);
+    *bytes_in = reader->bytes_in;
+    pthread_mutex_unlock(&reader->lock);
+
+    *bytes_out    = reader->bytes_out;
+    *wait_seconds = reader->wait_seconds;
+}
+
+/* stop the background threads (even if the input was not read to its end) */
+void
+pgz_close(pgz_reader *reader) {
+    size_t i;
+    int j;
+
+    if (reader == NULL)
+        return;
+
+    pthread_mutex_lock(&reader->lock);
+    reader->shutdown = 1;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+
+    pthread_join(reader->producer, NULL);
+    for (j = 0; j < reader->num_workers; j++)
+        pthread_join(reader->workers[j], NULL);
+
+    for (i = 0; i < reader->num_chunks; i++) {
+        free(reader->chunks[i].in);
+        free(reader->chunks[i].out);
+    }
+    if (reader->format == PGZ_GZIP)
+        inflateEnd(&reader->zs);
+
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->cond);
+    free(reader->chunks);
+    free(reader->workers);
+    free(reader->ibuf);
+    free(reader);
+}
+
+/* read more raw input (after any unused input); returns -1 on error */
+static int
+pgz_fill_input(pgz_reader *reader) {
+    ssize_t n;
+
+    if (reader->ibuf_pos > 0) {
+        memmove(reader->ibuf,
+                reader->ibuf + reader->ibuf_pos,
+                reader->ibuf_len - reader->ibuf_pos);
+        reader->ibuf_len -= reader->ibuf_pos;
+        reader->ibuf_pos  = 0;
+    }
+
+    if (reader->ieof || reader->ibuf_len == PGZ_INPUT_BUFFER_SIZE)
+        return 0;
+
+    do {
+        n = read(reader->fd,
+                 reader->ibuf + reader->ibuf_len,
+                 PGZ_INPUT_BUFFER_SIZE - reader->ibuf_len);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0)
+        return -1;
+    if (n == 0)
+        reader->ieof = 1;
+
+    reader->ibuf_len += (size_t) n;
+    reader->bytes_in += (size_t) n;
+    return 0;
+}
+
+/*
+   Returns 1 if all 'n' bytes were read, 0 if the input ended before the
+   first byte and -1 on error (including input that ends part way).
+*/
+static int
+pgz_read_exact(pgz_reader *reader, unsigned char *dst, size_t n) {
+    const size_t wanted = n;
+
+    while (n > 0) {
+        size_t avail = reader->ibuf_len - reader->ibuf_pos;
+
+        if (avail == 0) {
+            if (reader->ieof)
+                return (n == wanted) ? 0 : -1;
+            if (pgz_fill_input(reader) < 0)
+                return -1;
+            continue;
+        }
+
+        if (avail > n)
+            avail = n;
+        memcpy(dst, reader->ibuf + reader->ibuf_pos, avail);
+        reader->ibuf_pos += avail;
+        dst += avail;
+        n   -= avail;
+    }
+
+    return 1;
+}
+
+/*
+   A BGZF block header is a gzip header with the FEXTRA flag set and a
+   'BC' extra subfield holding the total block size minus one.
+*/
+static int
+pgz_is_bgzf(const unsigned char *header, size_t len, size_t *bsize) {
+    size_t xlen, pos;
+
+    if (len < 18 || header[0] != 0x1f || header[1] != 0x8b ||
+        header[2] != 8 || !(header[3] & 4))
+        return 0;
+
+    xlen = header[10] | (header[11] << 8);
+    for (pos = 12; pos + 4 <= 12 + xlen && pos + 4 <= len; ) {
+        size_t slen = header[pos + 2] | (header[pos + 3] << 8);
+        if (header[pos] == 'B' && header[pos + 1] == 'C' && slen == 2) {
+            if (pos + 6 > len)
+                return 0;
+            *bsize = (size_t) (header[pos + 4] | (header[pos + 5] << 8)) + 1;
+            return 1;
+        }
+        pos += 4 + slen;
+    }
+
+    return 0;
+}
+
+/* returns 1 if more input may follow, 0 at the end of input, -1 on error */
+static int
+pgz_fill_bgzf_chunk(pgz_reader *reader, pgz_chunk *chunk) {
+    chunk->in_len     = 0;
+    chunk->num_blocks = 0;
+    chunk->out_len    = 0;
+
+    while (chunk->num_blocks < PGZ_BLOCKS_PER_CHUNK) {
+        unsigned char *block = chunk->in + chunk->in_len;
+        size_t xlen, bsize;
+        int ret;
+
+        /* the fixed part of the header, then the extra field */
+        if ( (ret = pgz_read_exact(reader, block, 12)) <= 0 )
+            return ret;
+
+        xlen = block[10] | (block[11] << 8);
+        if (12 + xlen > PGZ_BGZF_MAX_BLOCK_SIZE ||
+            pgz_read_exact(reader, block + 12, xlen) != 1 ||
+            !pgz_is_bgzf(block, 12 + xlen, &bsize) ||
+            bsize < 12 + xlen + 8 ||
+            bsize > PGZ_BGZF_MAX_BLOCK_SIZE)
+            return -1;
+
+        /* the compressed data, CRC32 and uncompressed size */
+        if (pgz_read_exact(reader, block + 12 + xlen, bsize - 12 - xlen) != 1)
+            return -1;
+
+        chunk->block_start[chunk->num_blocks++] = chunk->in_len;
+        chunk->in_len += bsize;
+        chunk->block_start[chunk->num_blocks] = chunk->in_len;
+    }
+
+    return 1;
+}
+
+static int
+pgz_inflate_chunk(pgz_chunk *chunk) {
+    z_stream zs;
+    size_t b;
+
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -15) != Z_OK)
+        return 0;
+
+    chunk->out_len = 0;
+    for (b = 0; b < chunk->num_blocks; b++) {
+        unsigned char *block = chunk->in + chunk->block_start[b];
+        size_t bsize = chunk->block_start[b + 1] - chunk->block_start[b];
+        size_t xlen  = block[10] | (block[11] << 8);
+        unsigned char *trailer = block + bsize - 8;
+        uint32_t crc   = trailer[0] | (trailer[1] << 8) |
+                         (trailer[2] << 16) | ((uint32_t) trailer[3] << 24);
+        uint32_t isize = trailer[4] | (trailer[5] << 8) |
+                         (trailer[6] << 16) | ((uint32_t) trailer[7] << 24);
+
+        if (isize > PGZ_BGZF_MAX_BLOCK_SIZE ||
+            chunk->out_len + isize > PGZ_CHUNK_SIZE)
+            goto fail;
+
+        inflateReset(&zs);
+        zs.next_in   = block + 12 + xlen;
+        zs.avail_in  = (uInt) (bsize - 12 - xlen - 8);
+        zs.next_out  = chunk->out + chunk->out_len;
+        zs.avail_out = isize;
+        if (inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.avail_out != 0)
+            goto fail;
+
+        if (crc32(crc32(0L, Z_NULL, 0),
+                  chunk->out + chunk->out_len, isize) != crc)
+            goto fail;
+
+        chunk->out_len += isize;
+    }
+
+    inflateEnd(&zs);
+    return 1;
+
+fail:
+    inflateEnd(&zs);
+    return 0;
+}
+
+/*
+   Decompress (or copy) the next PGZ_CHUNK_SIZE bytes of a plain or gzip
+   stream.  Returns 1 if more input may follow, 0 at the end of input,
+   -1 on error.
+*/
+static int
+pgz_fill_stream_chunk(pgz_reader *reader, pgz_chunk *chunk) {
+    chunk->out_len = 0;
+
+    while (chunk->out_len < PGZ_CHUNK_SIZE) {
+        size_t avail = reader->ibuf_len - reader->ibuf_pos;
+
+        if (avail == 0) {
+            if (reader->ieof) {
+                /* a gzip member that was cut short */
+                return reader->zs_active ? -1 : 0;
+            }
+            if (pgz_fill_input(reader) < 0)
+                return -1;
+            continue;
+        }
+
+        if (reader->format == PGZ_PLAIN) {
+            if (avail > PGZ_CHUNK_SIZE - chunk->out_len)
+                avail = PGZ_CHUNK_SIZE - chunk->out_len;
+            memcpy(chunk->out + chunk->out_len,
+                   reader->ibuf + reader->ibuf_pos, avail);
+            chunk->out_len   += avail;
+            reader->ibuf_pos += avail;
+        }
+        else {
+            int ret;
+
+            /* a following gzip member starts a new stream */
+            if (!reader->zs_active) {
+                if (avail < 2 && !reader->ieof) {
+                    if (pgz_fill_input(reader) < 0)
+                        return -1;
+                    continue;
+                }
+                /* ignore any trailing garbage, as gzread does */
+                if (avail < 2 ||
+                    reader->ibuf[reader->ibuf_pos] != 0x1f ||
+                    reader->ibuf[reader->ibuf_pos + 1] != 0x8b) {
+                    reader->ibuf_pos = reader->ibuf_len;
+                    reader->ieof = 1;
+                    return 0;
+                }
+                inflateReset(&reader->zs);
+                reader->zs_active = 1;
+            }
+
+            reader->zs.next_in   = reader->ibuf + reader->ibuf_pos;
+            reader->zs.avail_in  = (uInt) avail;
+            reader->zs.next_out  = chunk->out + chunk->out_len;
+            reader->zs.avail_out = (uInt) (PGZ_CHUNK_SIZE - chunk->out_len);
+
+            ret = inflate(&reader->zs, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+                return -1;
+
+            reader->ibuf_pos = reader->ibuf_len - reader->zs.avail_in;
+            chunk->out_len   = PGZ_CHUNK_SIZE - reader->zs.avail_out;
+            if (ret == Z_STREAM_END)
+                reader->zs_active = 0;
+        }
+    }
+
+    return 1;
+}
+
+static void*
+pgz_producer_thread(void *arg) {
+    pgz_reader *reader = arg;
+    size_t seqno = 0;
+    int more = 1, error = reader->error;
+
+    while (more && !error) {
+        pgz_chunk *chunk = &reader->chunks[seqno % reader->num_chunks];
+        int shutdown;
+
+        pthread_mutex_lock(&reader->lock);
+        while (chunk->state != PGZ_CHUNK_EMPTY && !reader->shutdown)
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        shutdown = reader->shutdown;
+        pthread_mutex_unlock(&reader->lock);
+
+        if (shutdown)
+            break;
+
+        if (reader->format == PGZ_BGZF)
+            more = pgz_fill_bgzf_chunk(reader, chunk);
+        else
+            more = pgz_fill_stream_chunk(reader, chunk);
+
+        if (more < 0) {
+            error = 1;
+            break;
+        }
+
+        if ( (reader->format == PGZ_BGZF && chunk->num_blocks == 0) ||
+             (reader->format != PGZ_BGZF && chunk->out_len == 0) )
+            break;
+
+        pthread_mutex_lock(&reader->lock);
+        chunk->seqno = seqno++;
+        chunk->state = (reader->format == PGZ_BGZF) ?
+                       PGZ_CHUNK_FILLED : PGZ_CHUNK_READY;
+        pthread_cond_broadcast(&reader->cond);
+        pthread_mutex_unlock(&reader->lock);
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    if (error)
+        reader->error = 1;
+    reader->total_chunks = seqno;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+
+    return NULL;
+}
+
+static void*
+pgz_worker_thread(void *arg) {
+    pgz_reader *reader = arg;
+
+    for (;;) {
+        pgz_chunk *chunk;
+        int ok;
+
+        pthread_mutex_lock(&reader->lock);
+        for (;;) {
+            chunk = &reader->chunks[reader->next_inflate % reader->num_chunks];
+            if (reader->shutdown || reader->error ||
+                reader->next_inflate >= reader->total_chunks)
+                break;
+            if (chunk->state == PGZ_CHUNK_FILLED &&
+                chunk->seqno == reader->next_inflate)
+                break;
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        }
+
+        if (reader->shutdown || reader->error ||
+            reader->next_inflate >= reader->total_chunks) {
+            pthread_mutex_unlock(&reader->lock);
+            break;
+        }
+
+        chunk->state = PGZ_CHUNK_INFLATING;
+        reader->next_inflate++;
+        pthread_mutex_unlock(&reader->lock);
+
+        ok = pgz_inflate_chunk(chunk);
+
+        pthread_mutex_lock(&reader->lock);
+        if (!ok)
+            reader->error = 1;
+        chunk->state = PGZ_CHUNK_READY;
+        pthread_cond_broadcast(&reader->cond);
+        pthread_mutex_unlock(&reader->lock);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,128 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Threaded (and for BGZF, parallel) decompression of input streams
+
+   'pgz_read' is a drop in replacement for 'gzread' that is fed by a
+   background thread, so the consumer never waits on inflate while
+   there is decompressed data available.  The data is passed along in a
+   ring of chunks, which are handed back to the consumer strictly in
+   input order.
+
+     plain   -- the background thread just reads ahead
+     gzip    -- the background thread inflates the (possibly multi
+                member) gzip stream; a single gzip member cannot be
+                inflated in parallel
+     BGZF    -- the blocked gzip format used by samtools/htslib (a series
+                of independent gzip members of at most 64KB each); the
+                background thread splits the input into groups of blocks
+                which a pool of worker threads inflate in parallel
+
+   The format is detected from the first bytes of the stream.
+
+   The consumer's time spent blocked on a chunk that is not ready yet is
+   kept (with one clock reading per wait, not per read), which shows
+   whether a search is held up by the decompression.
+*/
+
+#ifndef _PGZ_H_
+#define _PGZ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <pthread.h>
+#include <zlib.h>
+
+/* D E F I N E S *************************************************************/
+#define PGZ_PLAIN 0
+#define PGZ_GZIP  1
+#define PGZ_BGZF  2
+
+#define PGZ_CHUNK_SIZE (1 << 20)         /* bytes decompressed per chunk */
+#define PGZ_BLOCKS_PER_CHUNK 16          /* BGZF blocks per chunk */
+#define PGZ_BGZF_MAX_BLOCK_SIZE 65536
+#define PGZ_INPUT_BUFFER_SIZE (1 << 17)
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    size_t        seqno;              /* position of the chunk in the input */
+    int           state;
+    unsigned char *in;                /* compressed BGZF blocks */
+    size_t        in_len;
+    size_t        num_blocks;
+    size_t        block_start[PGZ_BLOCKS_PER_CHUNK + 1];
+    unsigned char *out;               /* decompressed data */
+    size_t        out_len;
+} pgz_chunk;
+
+typedef struct {
+    int             fd;
+    int             format;           /* PGZ_PLAIN, PGZ_GZIP or PGZ_BGZF */
+    int             error;
+    int             shutdown;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       producer;
+    pthread_t       *workers;
+    int             num_workers;
+
+    pgz_chunk       *chunks;
+    size_t          num_chunks;
+    size_t          next_inflate;     /* next chunk for a worker */
+    size_t          next_read;        /* next chunk for the consumer */
+    size_t          total_chunks;     /* known once the producer is done */
+
+    /* consumer side */
+    pgz_chunk       *current;
+    size_t          current_pos;
+    size_t          bytes_out;        /* decompressed bytes handed out */
+    double          wait_seconds;     /* spent waiting on the next chunk */
+
+    /* producer side */
+    unsigned char   *ibuf;            /* raw input read ahead */
+    size_t          ibuf_pos;
+    size_t          ibuf_len;
+    int             ieof;
+    size_t          bytes_in;         /* raw bytes read from 'fd' */
+    z_stream        zs;
+    int             zs_active;        /* inside of a gzip member */
+} pgz_reader;
+
+/* P R O T O T Y P E S *******************************************************/
+pgz_reader* pgz_open(int fd, int num_workers);
+int pgz_read(pgz_reader *reader, void *buf, unsigned int len);
+int pgz_format(const pgz_reader *reader);
+void pgz_stats(pgz_reader *reader,
+               size_t *bytes_in,
+               size_t *bytes_out,
+               double *wait_seconds);
+void pgz_close(pgz_reader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PGZ_H */
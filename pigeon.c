@@ -0,0 +1,216 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Approximate multiple pattern search by pigeonhole seed filtering
+
+   See pigeon.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include "pigeon.h"
+
+/* D A T A    S T R U C T U R E S ********************************************/
+/* the state of a single 'pigeon_search' call */
+typedef struct {
+    const pigeon_matcher *pm;
+    const char           *text;
+    size_t               text_len;
+    pigeon_match         *best;
+    int                  found;
+} pigeon_search_state;
+
+/* F U N C T I O N S *********************************************************/
+
+/*
+   Build the matcher for patterns of 1 to MYERS_MAX_PATTERN_LENGTH
+   characters.  Returns NULL if a pattern is out of that range or if out
+   of memory.
+*/
+pigeon_matcher*
+pigeon_create(const char **patterns,
+              const size_t *pattern_lens,
+              size_t num_patterns,
+              int max_edits) {
+    pigeon_matcher *pm;
+    const char **seeds = NULL;
+    size_t *seed_lens = NULL;
+    size_t i, j, num_seeds = 0;
+    const size_t pieces = (size_t) max_edits + 1;
+
+    if ( (pm = calloc(1, sizeof(pigeon_matcher))) == NULL )
+        return NULL;
+
+    pm->num_patterns = num_patterns;
+    pm->max_edits    = max_edits;
+    pm->patterns     = calloc(num_patterns + 1, sizeof(myers_pattern *));
+    pm->unseeded     = malloc((num_patterns + 1) * sizeof(size_t));
+    pm->seed_pattern = malloc((num_patterns * pieces + 1) * sizeof(size_t));
+    pm->seed_offset  = malloc((num_patterns * pieces + 1) * sizeof(size_t));
+    seeds            = malloc((num_patterns * pieces + 1) * sizeof(char *));
+    seed_lens        = malloc((num_patterns * pieces + 1) * sizeof(size_t));
+    if (pm->patterns == NULL || pm->unseeded == NULL ||
+        pm->seed_pattern == NULL || pm->seed_offset == NULL ||
+        seeds == NULL || seed_lens == NULL)
+        goto fail;
+
+    for (i = 0; i < num_patterns; i++) {
+        const size_t len = pattern_lens[i];
+
+        pm->patterns[i] = myers_pattern_create(patterns[i], len);
+        if (pm->patterns[i] == NULL)
+            goto fail;
+
+        if (len < pieces) {
+            pm->unseeded[pm->num_unseeded++] = i;
+            continue;
+        }
+
+        /* cut the pattern into k + 1 (nearly) equal pieces */
+        for (j = 0; j < pieces; j++) {
+            size_t start = j * len / pieces;
+            size_t end   = (j + 1) * len / pieces;
+            seeds[num_seeds]           = patterns[i] + start;
+            seed_lens[num_seeds]       = end - start;
+            pm->seed_pattern[num_seeds] = i;
+            pm->seed_offset[num_seeds]  = start;
+            num_seeds++;
+        }
+    }
+
+    if ( (pm->seeds = aho_build(seeds, seed_lens, num_seeds, 1)) == NULL )
+        goto fail;
+
+    free(seeds);
+    free(seed_lens);
+    return pm;
+
+fail:
+    free(seeds);
+    free(seed_lens);
+    pigeon_destroy(pm);
+    return NULL;
+}
+
+/* verify a pattern over a window of the text, keeping the best match */
+static void
+pigeon_verify(pigeon_search_state *state,
+              size_t pattern,
+              size_t window_start,
+              size_t window_end) {
+    myers_match match;
+    pigeon_match *best = state->best;
+
+    if ( !myers_search(state->pm->patterns[pattern],
+                       state->text + window_start,
+                       window_end - window_start,
+                       state->pm->max_edits,
+                       &match) )
+        return;
+
+    /* redo the alignment against the whole text, so that it does not
+       depend upon where the window happened to start */
+    myers_traceback(state->pm->patterns[pattern],
+                    state->text,
+                    match.end + window_start,
+                    match.edits,
+                    &match);
+
+    /* prefer fewer edits, then the earlier end, then the earlier pattern */
+    if ( !state->found ||
+         match.edits < best->match.edits ||
+         (match.edits == best->match.edits &&
+          match.end < best->match.end) ||
+         (match.edits == best->match.edits &&
+          match.end == best->match.end &&
+          pattern < best->pattern) ) {
+        best->pattern = pattern;
+        best->match   = match;
+        state->found  = 1;
+    }
+}
+
+static int
+pigeon_seed_hit(const aho_match *hit, void *data) {
+    pigeon_search_state *state = data;
+    const pigeon_matcher *pm = state->pm;
+    const size_t pattern = pm->seed_pattern[hit->pattern];
+    const size_t len = pm->patterns[pattern]->pattern_len;
+    const size_t k = (size_t) pm->max_edits;
+    size_t window_start = 0, window_end = state->text_len;
+
+    /* the pattern can start up to k characters either side of where the
+       seed puts it, and spans at most its length plus k characters */
+    if (hit->start > pm->seed_offset[hit->pattern] + k)
+        window_start = hit->start - pm->seed_offset[hit->pattern] - k;
+    if (window_start + len + 2 * k < window_end)
+        window_end = window_start + len + 2 * k;
+
+    pigeon_verify(state, pattern, window_start, window_end);
+
+    return 0;
+}
+
+/*
+   Search 'text' for the best occurrence of any of the patterns (fewest
+   edits, then earliest end).  Returns 1 and fills in 'match' if found,
+   otherwise 0.
+*/
+int
+pigeon_search(const pigeon_matcher *pm,
+              const char *text,
+              size_t text_len,
+              pigeon_match *match) {
+    pigeon_search_state state;
+    size_t i;
+
+    state.pm       = pm;
+    state.text     = text;
+    state.text_len = text_len;
+    state.best     = match;
+    state.found    = 0;
+
+    for (i = 0; i < pm->num_unseeded; i++)
+        pigeon_verify(&state, pm->unseeded[i], 0, text_len);
+
+    aho_search_all(pm->seeds, text, text_len, pigeon_seed_hit, &state);
+
+    return state.found;
+}
+
+void
+pigeon_destroy(pigeon_matcher *pm) {
+    size_t i;
+
+    if (pm == NULL)
+        return;
+
+    if (pm->patterns != NULL) {
+        for (i = 0; i < pm->num_patterns; i++)
+            myers_pattern_destroy(pm->patterns[i]);
+    }
+    free(pm->patterns);
+    free(pm->unseeded);
+    free(pm->seed_pattern);
+    free(pm->seed_offset);
+    aho_destroy(pm->seeds);
+    free(pm);
+}
@@ -0,0 +1,80 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Approximate multiple pattern search by pigeonhole seed filtering
+
+   If a pattern occurs with at most k edits, and the pattern is cut into
+   k + 1 pieces, then at least one of the pieces must occur exactly
+   (each edit can only spoil one piece).  So the pieces ("seeds") of all
+   patterns are searched for at once with a single Aho-Corasick
+   automaton, and only the patterns whose seeds occur are verified, with
+   the bit-parallel matcher, over the small window of the read around
+   each seed hit.
+
+   Patterns shorter than k + 1 characters cannot be seeded and are
+   always verified over the whole read.  Matching is case insensitive.
+*/
+
+#ifndef _PIGEON_H_
+#define _PIGEON_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include "aho.h"
+#include "myers.h"
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    size_t        num_patterns;
+    myers_pattern **patterns;
+    int           max_edits;
+    aho_automaton *seeds;          /* automaton of every pattern's pieces */
+    size_t        *seed_pattern;   /* pattern that each seed belongs to */
+    size_t        *seed_offset;    /* offset of each seed in its pattern */
+    size_t        num_unseeded;
+    size_t        *unseeded;       /* patterns too short to be seeded */
+} pigeon_matcher;
+
+typedef struct {
+    size_t      pattern;           /* index of the matched pattern */
+    myers_match match;
+} pigeon_match;
+
+/* P R O T O T Y P E S *******************************************************/
+pigeon_matcher* pigeon_create(const char **patterns,
+                              const size_t *pattern_lens,
+                              size_t num_patterns,
+                              int max_edits);
+int pigeon_search(const pigeon_matcher *pm,
+                  const char *text,
+                  size_t text_len,
+                  pigeon_match *match);
+void pigeon_destroy(pigeon_matcher *pm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PIGEON_H */
@@ -0,0 +1,246 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Quality-aware approximate pattern matching
+
+   See qualmatch.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include <limits.h>
+#include "qualmatch.h"
+
+/* D E F I N E S *************************************************************/
+/* traceback matrices up to this many cells live on the stack */
+#define QUALMATCH_STACK_CELLS 8192
+
+/* P R O T O T Y P E S *******************************************************/
+static int  qual_is_low(const qual_matcher *qm, const char *qual, size_t j);
+static int  qual_subst_cost(const qual_matcher *qm,
+                            const char *text,
+                            const char *qual,
+                            size_t i,
+                            size_t j);
+static void qual_traceback(const qual_matcher *qm,
+                           const char *text,
+                           const char *qual,
+                           size_t end,
+                           qual_match *match);
+
+/* F U N C T I O N S *********************************************************/
+
+/* true if text char 'j' is a poor base call */
+static int
+qual_is_low(const qual_matcher *qm, const char *qual, size_t j) {
+    return qual != NULL &&
+           (int) (unsigned char) qual[j] - QUALMATCH_PHRED_OFFSET <
+               qm->min_quality;
+}
+
+/* the cost of aligning pattern char 'i' with text char 'j' (both 0 based) */
+static int
+qual_subst_cost(const qual_matcher *qm,
+                const char *text,
+                const char *qual,
+                size_t i,
+                size_t j) {
+    if ( (qm->mp->peq[(unsigned char) text[j]] >> i) & 1 )
+        return 0;
+
+    if ( qual_is_low(qm, qual, j) )
+        return qm->low_quality_cost;
+
+    return qm->cost_substitutions;
+}
+
+/*
+   Search 'text' (with base qualities 'qual', or NULL if there are none)
+   for the lowest weighted cost occurrence of the pattern costing at most
+   'max_cost', preferring the earliest end amongst equally good matches.
+   Returns 1 and fills in 'match' if found, otherwise 0.
+*/
+int
+qual_search(const qual_matcher *qm,
+            const char *text,
+            const char *qual,
+            size_t text_len,
+            qual_match *match) {
+    int col[MYERS_MAX_PATTERN_LENGTH + 1];
+    const size_t m = qm->mp->pattern_len;
+    const int over = qm->max_cost + 1;      /* anything above the threshold */
+    size_t last_active;                     /* last row within the threshold */
+    size_t i, j;
+    int best_cost = over;
+    size_t best_end = 0;
+
+    /* the first column: deleting the first 'i' pattern chars */
+    col[0] = 0;
+    last_active = 0;
+    for (i = 1; i <= m; i++) {
+        col[i] = col[i-1] + qm->cost_deletions;
+        if (col[i] > over)
+            col[i] = over;
+        if (col[i] <= qm->max_cost)
+            last_active = i;
+    }
+    if (last_active == m) {
+        best_cost = col[m];
+        best_end  = 0;
+    }
+
+    /*
+       rows below the cut-off hold 'over': their real costs are above the
+       threshold, and only ever feed into costs that are too
+    */
+    for (j = 0; j < text_len && best_cost > 0; j++) {
+        size_t rows = last_active < m ? last_active + 1 : m;
+        int diag = col[0];                  /* the previous column's row i-1 */
+
+        /* a match may start anywhere, so the top row stays 0 */
+        last_active = 0;
+
+        for (i = 1; i <= rows; i++) {
+            int best = diag + qual_subst_cost(qm, text, qual, i - 1, j);
+            int up   = col[i-1] + qm->cost_deletions;
+            int left = col[i] + qm->cost_insertions;
+
+            if (up < best)
+                best = up;
+            if (left < best)
+                best = left;
+            if (best > over)
+                best = over;
+
+            diag   = col[i];
+            col[i] = best;
+            if (best <= qm->max_cost)
+                last_active = i;
+        }
+
+        if (last_active == m && col[m] < best_cost) {
+            best_cost = col[m];
+            best_end  = j + 1;
+        }
+    }
+
+    if (best_cost > qm->max_cost)
+        return 0;
+
+    qual_traceback(qm, text, qual, best_end, match);
+    return 1;
+}
+
+/*
+   Recover the alignment of the pattern that ends at text offset 'end'.
+   With insertions costing at least one, it cannot span more than
+   pattern_len + max_cost / cost_insertions text characters.
+*/
+static void
+qual_traceback(const qual_matcher *qm,
+               const char *text,
+               const char *qual,
+               size_t end,
+               qual_match *match) {
+    int stack_cells[QUALMATCH_STACK_CELLS];
+    const size_t m = qm->mp->pattern_len;
+    size_t w = end;
+    size_t i, j, width;
+    const char *window_text, *window_qual;
+    int *D;
+
+    if (qm->cost_insertions > 0 &&
+        m + (size_t) (qm->max_cost / qm->cost_insertions) < w)
+        w = m + (size_t) (qm->max_cost / qm->cost_insertions);
+
+    width = w + 1;
+    if ((m + 1) * width <= QUALMATCH_STACK_CELLS) {
+        D = stack_cells;
+    }
+    else if ( (D = malloc((m + 1) * width * sizeof(int))) == NULL ) {
+        /* report the end alone rather than fail the search */
+        memset(match, 0, sizeof(qual_match));
+        match->start = end;
+        match->end   = end;
+        return;
+    }
+
+    window_text = text + end - w;
+    window_qual = qual != NULL ? qual + end - w : NULL;
+
+    for (j = 0; j <= w; j++)
+        D[j] = 0;
+
+    for (i = 1; i <= m; i++) {
+        D[i * width] = D[(i-1) * width] + qm->cost_deletions;
+        for (j = 1; j <= w; j++) {
+            int diag = D[(i-1) * width + j-1] +
+                qual_subst_cost(qm, window_text, window_qual, i-1, j-1);
+            int del  = D[(i-1) * width + j] + qm->cost_deletions;
+            int ins  = D[i * width + j-1] + qm->cost_insertions;
+            int best = diag;
+            if (del < best)
+                best = del;
+            if (ins < best)
+                best = ins;
+            D[i * width + j] = best;
+        }
+    }
+
+    match->end                       = end;
+    match->cost                      = D[m * width + w];
+    match->insertions                = 0;
+    match->deletions                 = 0;
+    match->substitutions             = 0;
+    match->low_quality_substitutions = 0;
+
+    i = m;
+    j = w;
+    while (i > 0) {
+        int cost = (j > 0) ?
+            qual_subst_cost(qm, window_text, window_qual, i-1, j-1) : 0;
+
+        if (j > 0 && D[i * width + j] == D[(i-1) * width + j-1] + cost) {
+            if ( !((qm->mp->peq[(unsigned char) window_text[j-1]] >> (i-1))
+                   & 1) ) {
+                match->substitutions++;
+                match->low_quality_substitutions +=
+                    qual_is_low(qm, window_qual, j-1);
+            }
+            i--;
+            j--;
+        }
+        else if (D[i * width + j] == D[(i-1) * width + j] + qm->cost_deletions) {
+            match->deletions++;
+            i--;
+        }
+        else {
+            match->insertions++;
+            j--;
+        }
+    }
+
+    match->start = end - w + j;
+
+    if (D != stack_cells)
+        free(D);
+}
@@ -0,0 +1,88 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Quality-aware approximate pattern matching
+
+   An edit distance search in which a substitution costs less (or
+   nothing) where the read's base call is unreliable: at a base with a
+   Phred quality below 'min_quality' a substitution costs
+   'low_quality_cost' instead of the usual substitution cost.  Insertions
+   and deletions keep their costs.  Sequencing errors in an adapter
+   therefore need not be paid for with a looser threshold everywhere.
+
+   The weights rule out the bit-parallel matcher, so this is a plain
+   column-by-column dynamic programming search (over the pattern's
+   character masks from myers.h, so IUPAC patterns work the same way).
+   Ukkonen's cut-off keeps it cheap: all costs are non-negative, so once
+   the cells below some row of a column exceed the threshold, they do
+   in every following column too, and only the rows above it are
+   computed.  The lowest cost end (and amongst those the earliest) is
+   then traced back, as in myers.c, for its start and edit counts.
+*/
+
+#ifndef _QUALMATCH_H_
+#define _QUALMATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include "myers.h"
+
+/* D E F I N E S *************************************************************/
+#define QUALMATCH_PHRED_OFFSET 33
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    const myers_pattern *mp;         /* pattern positions of each char */
+    int cost_insertions;
+    int cost_deletions;
+    int cost_substitutions;
+    int low_quality_cost;            /* substitution cost at a poor base */
+    int min_quality;                 /* Phred score of a reliable base */
+    int max_cost;
+} qual_matcher;
+
+typedef struct {
+    size_t start;                    /* offset of the first matched char */
+    size_t end;                      /* offset one past the last one */
+    int    cost;                     /* the quality weighted cost */
+    int    insertions;
+    int    deletions;
+    int    substitutions;            /* including the low quality ones */
+    int    low_quality_substitutions;
+} qual_match;
+
+/* P R O T O T Y P E S *******************************************************/
+int qual_search(const qual_matcher *qm,
+                const char *text,
+                const char *qual,
+                size_t text_len,
+                qual_match *match);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _QUALMATCH_H */
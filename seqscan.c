@@ -0,0 +1,322 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Sequence-only scanning of FASTQ/FASTA input, for the '-C' counts
+
+   See seqscan.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include "seqscan.h"
+
+/* D E F I N E S *************************************************************/
+#define SEQSCAN_MORE -3           /* the record runs past the window */
+
+/* D A T A    S T R U C T U R E S ********************************************/
+/* a sequence or quality string being gathered from one or more lines */
+typedef struct {
+    const char *s;
+    size_t     l;
+    size_t     lines;
+} seqscan_field;
+
+/* P R O T O T Y P E S *******************************************************/
+static size_t seqscan_line_end(const seqscan *scan, size_t pos);
+static int    seqscan_append_line(char **buf,
+                                  size_t *cap,
+                                  seqscan_field *field,
+                                  const char *line,
+                                  size_t len);
+static int    seqscan_parse(seqscan *scan, const char **seq, size_t *seq_l);
+static int    seqscan_fill(seqscan *scan);
+
+/* F U N C T I O N S *********************************************************/
+
+/* scan a mapped file in place; returns NULL if out of memory */
+seqscan*
+seqscan_open_mapped(const char *data, size_t len) {
+    seqscan *scan;
+
+    if ( (scan = calloc(1, sizeof(seqscan))) == NULL )
+        return NULL;
+
+    scan->data = data;
+    scan->len  = len;
+    scan->eof  = 1;
+
+    return scan;
+}
+
+/* scan a stream through a window; returns NULL if out of memory */
+seqscan*
+seqscan_open_stream(pgz_reader *fp) {
+    seqscan *scan;
+
+    if ( (scan = calloc(1, sizeof(seqscan))) == NULL )
+        return NULL;
+
+    if ( (scan->buf = malloc(SEQSCAN_WINDOW_SIZE)) == NULL ) {
+        free(scan);
+        return NULL;
+    }
+
+    scan->fp   = fp;
+    scan->data = scan->buf;
+    scan->cap  = SEQSCAN_WINDOW_SIZE;
+
+    return scan;
+}
+
+/* offset of the newline ending the line at 'pos' (or the end of the window) */
+static size_t
+seqscan_line_end(const seqscan *scan, size_t pos) {
+    const char *nl = memchr(scan->data + pos, '\n', scan->len - pos);
+    return nl ? (size_t) (nl - scan->data) : scan->len;
+}
+
+/*
+   Add a line to a field, as 'mapfq_append_line' does: a field of a single
+   line is left in place, a second line moves it to 'buf'.  A trailing
+   '\r' is dropped.  Returns 0 if out of memory.
+*/
+static int
+seqscan_append_line(char **buf,
+                    size_t *cap,
+                    seqscan_field *field,
+                    const char *line,
+                    size_t len) {
+    if (field->lines++ == 0) {
+        field->s = line;
+        field->l = len;
+    }
+    else {
+        if (field->l + len + 1 > *cap) {
+            size_t new_cap = *cap ? *cap : 256;
+            char *new_buf;
+            while (field->l + len + 1 > new_cap)
+                new_cap *= 2;
+            if ( (new_buf = realloc(*buf, new_cap)) == NULL )
+                return 0;
+            /* realloc has already moved a field that was in 'buf' */
+            if (field->s == *buf)
+                field->s = new_buf;
+            *buf = new_buf;
+            *cap = new_cap;
+        }
+        if (field->s != *buf)
+            memmove(*buf, field->s, field->l);
+        memcpy(*buf + field->l, line, len);
+        field->s  = *buf;
+        field->l += len;
+    }
+
+    if (field->l > 1 && field->s[field->l - 1] == '\r')
+        field->l--;
+
+    return 1;
+}
+
+/*
+   Scan the record at the start of the window, following 'mapfq_read'.
+   Returns 1 with its sequence, 0 at the end of the input (or at a
+   truncated FASTQ record), -1 if out of memory, or SEQSCAN_MORE if the
+   record is not wholly in the window, in which case nothing is consumed.
+*/
+static int
+seqscan_parse(seqscan *scan, const char **seq, size_t *seq_l) {
+    const char *d = scan->data;
+    const size_t n = scan->len;
+    size_t p = scan->pos;
+    size_t j;
+    seqscan_field sf = { NULL, 0, 0 };
+    seqscan_field qf = { NULL, 0, 0 };
+    int c = -1;
+
+    /* jump to the next header line */
+    if (scan->last_char == 0) {
+        while (p < n && d[p] != '>' && d[p] != '@')
+            p++;
+        scan->pos = p;
+        if (p >= n) {
+            if (!scan->eof)
+                return SEQSCAN_MORE;
+            scan->done = 1;
+            return 0;
+        }
+        scan->last_char = (unsigned char) d[p];
+        scan->pos = ++p;
+    }
+
+    if (p >= n) {
+        if (!scan->eof)
+            return SEQSCAN_MORE;
+        scan->done = 1;
+        return 0;
+    }
+
+    /* the header line, name and comment alike */
+    j = seqscan_line_end(scan, p);
+    if (j >= n && !scan->eof)
+        return SEQSCAN_MORE;
+    scan->header   = d + p;
+    scan->header_l = j - p;
+    p = (j < n) ? j + 1 : n;
+
+    /* sequence lines, up to the next header or the '+' line */
+    for (;;) {
+        if (p >= n) {
+            if (!scan->eof)
+                return SEQSCAN_MORE;
+            c = -1;
+            break;
+        }
+        c = (unsigned char) d[p++];
+        if (c == '>' || c == '+' || c == '@')
+            break;
+        if (c == '\n')
+            continue;
+        j = seqscan_line_end(scan, p);
+        if (j >= n && !scan->eof)
+            return SEQSCAN_MORE;
+        if ( !seqscan_append_line(&scan->seq_buf, &scan->seq_cap,
+                                  &sf, d + p - 1, j - p + 1) )
+            return -1;
+        p = (j < n) ? j + 1 : n;
+    }
+
+    *seq   = sf.lines ? sf.s : d + p;
+    *seq_l = sf.l;
+
+    if (c != '+') {
+        /* FASTA */
+        if (c == '>' || c == '@')
+            scan->last_char = c;
+        else
+            scan->done = 1;
+        scan->pos = p;
+        return 1;
+    }
+
+    /* skip the rest of the '+' line */
+    j = seqscan_line_end(scan, p);
+    if (j >= n) {
+        if (!scan->eof)
+            return SEQSCAN_MORE;
+        scan->done = 1;
+        return 0;
+    }
+    p = j + 1;
+
+    /* quality lines, only measured, until they are as long as the sequence */
+    do {
+        if (p >= n) {
+            if (!scan->eof)
+                return SEQSCAN_MORE;
+            break;
+        }
+        j = seqscan_line_end(scan, p);
+        if (j >= n && !scan->eof)
+            return SEQSCAN_MORE;
+        if ( !seqscan_append_line(&scan->qual_buf, &scan->qual_cap,
+                                  &qf, d + p, j - p) )
+            return -1;
+        p = (j < n) ? j + 1 : n;
+    } while (qf.l < sf.l);
+
+    scan->last_char = 0;
+    scan->pos = p;
+
+    if (qf.l != sf.l) {
+        scan->done = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+   Move the unscanned rest of a stream's window to its front (or grow the
+   window, if a record fills all of it), and read in more.  Returns 0, -1
+   if out of memory, or -2 if the input could not be read.
+*/
+static int
+seqscan_fill(seqscan *scan) {
+    size_t room;
+    int n;
+
+    if (scan->pos > 0) {
+        memmove(scan->buf, scan->buf + scan->pos, scan->len - scan->pos);
+        scan->len -= scan->pos;
+        scan->pos  = 0;
+    }
+    else if (scan->len == scan->cap) {
+        char *buf = realloc(scan->buf, 2 * scan->cap);
+        if (buf == NULL)
+            return -1;
+        scan->buf  = buf;
+        scan->cap *= 2;
+    }
+    scan->data = scan->buf;
+
+    room = scan->cap - scan->len;
+    if (room > (1U << 30))
+        room = 1U << 30;
+
+    if ( (n = pgz_read(scan->fp, scan->buf + scan->len, (unsigned int) room)) < 0 )
+        return -2;
+    if (n == 0)
+        scan->eof = 1;
+    scan->len += (size_t) n;
+
+    return 0;
+}
+
+/*
+   Hand out the sequence of the next record.  Returns 1, 0 at the end of
+   the input, -1 if out of memory, or -2 if the input could not be read.
+*/
+int
+seqscan_next(seqscan *scan, const char **seq, size_t *seq_l) {
+    int ret;
+
+    if (scan->done)
+        return 0;
+
+    while ( (ret = seqscan_parse(scan, seq, seq_l)) == SEQSCAN_MORE ) {
+        if ( (ret = seqscan_fill(scan)) < 0 )
+            return ret;
+    }
+
+    return ret;
+}
+
+void
+seqscan_close(seqscan *scan) {
+    if (scan == NULL)
+        return;
+
+    free(scan->buf);
+    free(scan->seq_buf);
+    free(scan->qual_buf);
+    free(scan);
+}
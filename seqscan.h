@@ -0,0 +1,87 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Sequence-only scanning of FASTQ/FASTA input, for the '-C' counts
+
+   A count needs nothing but the sequences, so rather than parsing whole
+   records, the scanner looks for the line structure in the raw input
+   and hands out the sequences only: a header line is skipped with a
+   single newline search, without splitting the name and comment, and a
+   quality string is only measured, to find where the record ends.
+
+   The input is either a memory mapped file (as mapped by 'mapfq_open'),
+   which is scanned in place, or a (decompressed) stream, which is read
+   into a window that the sequences are handed out of.  A record that
+   runs past the end of the window is scanned again once the window is
+   refilled (and grown, for records longer than the window).
+
+   The records are split up exactly as 'kseq_read' and 'mapfq_read' split
+   them up, so a count agrees with the full search.  A sequence is a view
+   into the input (NOT null terminated), unless it is spread over more
+   than one line, in which case it is joined in a scratch buffer.  Either
+   way it is only valid until the next 'seqscan_next'.
+*/
+
+#ifndef _SEQSCAN_H_
+#define _SEQSCAN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include "pgz.h"
+
+/* D E F I N E S *************************************************************/
+#define SEQSCAN_WINDOW_SIZE (1 << 22)
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    pgz_reader *fp;           /* the stream, or NULL for a mapped file */
+    const char *data;         /* the window (or the whole mapped file) */
+    size_t     len;
+    size_t     pos;
+    int        eof;           /* nothing is left beyond the window */
+    int        last_char;     /* header char already consumed (as kseq) */
+    int        done;
+    char       *buf;          /* storage of a stream's window */
+    size_t     cap;
+    char       *seq_buf;      /* scratch space for multi-line fields */
+    size_t     seq_cap;
+    char       *qual_buf;
+    size_t     qual_cap;
+    const char *header;       /* the last record's header line (after the */
+    size_t     header_l;      /* '@' or '>'), for error messages */
+} seqscan;
+
+/* P R O T O T Y P E S *******************************************************/
+seqscan* seqscan_open_mapped(const char *data, size_t len);
+seqscan* seqscan_open_stream(pgz_reader *fp);
+int seqscan_next(seqscan *scan, const char **seq, size_t *seq_l);
+void seqscan_close(seqscan *scan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SEQSCAN_H */
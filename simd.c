@@ -0,0 +1,324 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Vectorized exact substring search
+
+   See simd.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <string.h>
+#include "simd.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* F U N C T I O N S *********************************************************/
+
+#ifdef SIMD_X86
+
+/* the positions from 'start' on that are too close to the end for a vector */
+static const char*
+simd_search_tail(const char *haystack,
+                 size_t haystack_len,
+                 const char *needle,
+                 size_t needle_len,
+                 size_t start) {
+    size_t i;
+
+    for (i = start; i + needle_len <= haystack_len; i++) {
+        if (haystack[i] == needle[0] &&
+            memcmp(haystack + i + 1, needle + 1, needle_len - 1) == 0)
+            return haystack + i;
+    }
+
+    return NULL;
+}
+
+const char*
+simd_search_sse2(const char *haystack,
+                 size_t haystack_len,
+                 const char *needle,
+                 size_t needle_len) {
+    __m128i first, last;
+    size_t i;
+
+    if (needle_len == 0)
+        return haystack;
+    if (haystack_len < needle_len)
+        return NULL;
+
+    first = _mm_set1_epi8(needle[0]);
+    last  = _mm_set1_epi8(needle[needle_len - 1]);
+
+    for (i = 0; i + needle_len - 1 + 16 <= haystack_len; i += 16) {
+        const __m128i block_first =
+            _mm_loadu_si128((const __m128i *) (haystack + i));
+        const __m128i block_last =
+            _mm_loadu_si128((const __m128i *) (haystack + i + needle_len - 1));
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                          _mm_cmpeq_epi8(last, block_last)));
+
+        /* verify the candidates from left to right */
+        while (mask != 0) {
+            const size_t pos = i + (size_t) __builtin_ctz(mask);
+            if (needle_len <= 2 ||
+                memcmp(haystack + pos + 1, needle + 1, needle_len - 2) == 0)
+                return haystack + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    return simd_search_tail(haystack, haystack_len, needle, needle_len, i);
+}
+
+__attribute__((target("avx2")))
+const char*
+simd_search_avx2(const char *haystack,
+                 size_t haystack_len,
+                 const char *needle,
+                 size_t needle_len) {
+    __m256i first, last;
+    size_t i;
+
+    if (needle_len == 0)
+        return haystack;
+    if (haystack_len < needle_len)
+        return NULL;
+
+    first = _mm256_set1_epi8(needle[0]);
+    last  = _mm256_set1_epi8(needle[needle_len - 1]);
+
+    for (i = 0; i + needle_len - 1 + 32 <= haystack_len; i += 32) {
+        const __m256i block_first =
+            _mm256_loadu_si256((const __m256i *) (haystack + i));
+        const __m256i block_last =
+            _mm256_loadu_si256((const __m256i *)
+                               (haystack + i + needle_len - 1));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                             _mm256_cmpeq_epi8(last, block_last)));
+
+        /* verify the candidates from left to right */
+        while (mask != 0) {
+            const size_t pos = i + (size_t) __builtin_ctz(mask);
+            if (needle_len <= 2 ||
+                memcmp(haystack + pos + 1, needle + 1, needle_len - 2) == 0)
+                return haystack + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    /* finish off with the narrower vectors, then one at a time */
+    return simd_search_sse2(haystack + i, haystack_len - i,
+                            needle, needle_len);
+}
+
+/*
+   The pair kernels look for two needles of the same length in a single
+   pass (as for a pattern and its reverse complement), by merging the
+   candidate masks of both.  'which' is set to 0 or 1 for the needle
+   found; at a position where both occur, the first needle wins.
+*/
+static int
+simd_pair_verify(const char *pos,
+                 const char *needle,
+                 size_t needle_len) {
+    return needle_len <= 2 ||
+           memcmp(pos + 1, needle + 1, needle_len - 2) == 0;
+}
+
+static const char*
+simd_search_pair_tail(const char *haystack,
+                      size_t haystack_len,
+                      const char *needle1,
+                      const char *needle2,
+                      size_t needle_len,
+                      size_t start,
+                      int *which) {
+    size_t i;
+
+    for (i = start; i + needle_len <= haystack_len; i++) {
+        if (memcmp(haystack + i, needle1, needle_len) == 0) {
+            *which = 0;
+            return haystack + i;
+        }
+        if (memcmp(haystack + i, needle2, needle_len) == 0) {
+            *which = 1;
+            return haystack + i;
+        }
+    }
+
+    return NULL;
+}
+
+const char*
+simd_search_pair_sse2(const char *haystack,
+                      size_t haystack_len,
+                      const char *needle1,
+                      const char *needle2,
+                      size_t needle_len,
+                      int *which) {
+    __m128i first1, last1, first2, last2;
+    size_t i;
+
+    *which = 0;
+    if (needle_len == 0)
+        return haystack;
+    if (haystack_len < needle_len)
+        return NULL;
+
+    first1 = _mm_set1_epi8(needle1[0]);
+    last1  = _mm_set1_epi8(needle1[needle_len - 1]);
+    first2 = _mm_set1_epi8(needle2[0]);
+    last2  = _mm_set1_epi8(needle2[needle_len - 1]);
+
+    for (i = 0; i + needle_len - 1 + 16 <= haystack_len; i += 16) {
+        const __m128i block_first =
+            _mm_loadu_si128((const __m128i *) (haystack + i));
+        const __m128i block_last =
+            _mm_loadu_si128((const __m128i *) (haystack + i + needle_len - 1));
+        unsigned int mask1 = (unsigned int) _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first1, block_first),
+                          _mm_cmpeq_epi8(last1, block_last)));
+        unsigned int mask2 = (unsigned int) _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first2, block_first),
+                          _mm_cmpeq_epi8(last2, block_last)));
+        unsigned int mask = mask1 | mask2;
+
+        while (mask != 0) {
+            const unsigned int bit = (unsigned int) __builtin_ctz(mask);
+            const size_t pos = i + bit;
+            if ( ((mask1 >> bit) & 1) &&
+                 simd_pair_verify(haystack + pos, needle1, needle_len) ) {
+                *which = 0;
+                return haystack + pos;
+            }
+            if ( ((mask2 >> bit) & 1) &&
+                 simd_pair_verify(haystack + pos, needle2, needle_len) ) {
+                *which = 1;
+                return haystack + pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return simd_search_pair_tail(haystack, haystack_len,
+                                 needle1, needle2, needle_len, i, which);
+}
+
+__attribute__((target("avx2")))
+const char*
+simd_search_pair_avx2(const char *haystack,
+                      size_t haystack_len,
+                      const char *needle1,
+                      const char *needle2,
+                      size_t needle_len,
+                      int *which) {
+    __m256i first1, last1, first2, last2;
+    size_t i;
+
+    *which = 0;
+    if (needle_len == 0)
+        return haystack;
+    if (haystack_len < needle_len)
+        return NULL;
+
+    first1 = _mm256_set1_epi8(needle1[0]);
+    last1  = _mm256_set1_epi8(needle1[needle_len - 1]);
+    first2 = _mm256_set1_epi8(needle2[0]);
+    last2  = _mm256_set1_epi8(needle2[needle_len - 1]);
+
+    for (i = 0; i + needle_len - 1 + 32 <= haystack_len; i += 32) {
+        const __m256i block_first =
+            _mm256_loadu_si256((const __m256i *) (haystack + i));
+        const __m256i block_last =
+            _mm256_loadu_si256((const __m256i *)
+                               (haystack + i + needle_len - 1));
+        unsigned int mask1 = (unsigned int) _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first1, block_first),
+                             _mm256_cmpeq_epi8(last1, block_last)));
+        unsigned int mask2 = (unsigned int) _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first2, block_first),
+                             _mm256_cmpeq_epi8(last2, block_last)));
+        unsigned int mask = mask1 | mask2;
+
+        while (mask != 0) {
+            const unsigned int bit = (unsigned int) __builtin_ctz(mask);
+            const size_t pos = i + bit;
+            if ( ((mask1 >> bit) & 1) &&
+                 simd_pair_verify(haystack + pos, needle1, needle_len) ) {
+                *which = 0;
+                return haystack + pos;
+            }
+            if ( ((mask2 >> bit) & 1) &&
+                 simd_pair_verify(haystack + pos, needle2, needle_len) ) {
+                *which = 1;
+                return haystack + pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return simd_search_pair_sse2(haystack + i, haystack_len - i,
+                                 needle1, needle2, needle_len, which);
+}
+
+#endif /* SIMD_X86 */
+
+/* the best kernel for the running CPU (or NULL if there is none) */
+simd_search_fn
+simd_search_select(void) {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return simd_search_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return simd_search_sse2;
+#endif
+    return NULL;
+}
+
+const char*
+simd_search_name(simd_search_fn fn) {
+#ifdef SIMD_X86
+    if (fn == simd_search_avx2)
+        return "avx2";
+    if (fn == simd_search_sse2)
+        return "sse2";
+#endif
+    return "scalar";
+}
+
+/* the best pair kernel for the running CPU (or NULL if there is none) */
+simd_search_pair_fn
+simd_search_pair_select(void) {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return simd_search_pair_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return simd_search_pair_sse2;
+#endif
+    return NULL;
+}
@@ -0,0 +1,104 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Vectorized exact substring search
+
+   On a four letter alphabet the Boyer-Moore bad character shifts are
+   short, so most of its time goes into table lookups and mispredicted
+   branches.  These kernels instead compare 16 (SSE2) or 32 (AVX2) text
+   positions at once against the first and the last character of the
+   needle, and only verify the remaining characters of the (rare)
+   candidate positions that agree on both:
+
+     Wojciech Mula, "SIMD-friendly algorithms for substring searching",
+     http://0x80.pl/articles/simd-strfind.html
+
+   The kernels are compiled with per-function target attributes, so the
+   program as a whole does not require AVX2; 'simd_search_select' picks
+   the best kernel the running CPU supports, or returns NULL if there is
+   none (a non-x86 build), in which case the caller should fall back to a
+   scalar search.  Like the scalar search, the kernels return the
+   leftmost occurrence.
+
+   The pair kernels search for two needles of the same length (such as a
+   pattern and its reverse complement) in one pass over the text.
+*/
+
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+
+/* D E F I N E S *************************************************************/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#endif
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef const char* (*simd_search_fn)(const char *haystack,
+                                      size_t haystack_len,
+                                      const char *needle,
+                                      size_t needle_len);
+
+typedef const char* (*simd_search_pair_fn)(const char *haystack,
+                                           size_t haystack_len,
+                                           const char *needle1,
+                                           const char *needle2,
+                                           size_t needle_len,
+                                           int *which);
+
+/* P R O T O T Y P E S *******************************************************/
+simd_search_fn simd_search_select(void);
+simd_search_pair_fn simd_search_pair_select(void);
+const char* simd_search_name(simd_search_fn fn);
+#ifdef SIMD_X86
+const char* simd_search_sse2(const char *haystack,
+                             size_t haystack_len,
+                             const char *needle,
+                             size_t needle_len);
+const char* simd_search_avx2(const char *haystack,
+                             size_t haystack_len,
+                             const char *needle,
+                             size_t needle_len);
+const char* simd_search_pair_sse2(const char *haystack,
+                                  size_t haystack_len,
+                                  const char *needle1,
+                                  const char *needle2,
+                                  size_t needle_len,
+                                  int *which);
+const char* simd_search_pair_avx2(const char *haystack,
+                                  size_t haystack_len,
+                                  const char *needle1,
+                                  const char *needle2,
+                                  size_t needle_len,
+                                  int *which);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SIMD_H */
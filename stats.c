@@ -0,0 +1,233 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Per-stage timing and throughput counters ('--stats')
+
+   See stats.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+
+/* P R O T O T Y P E S *******************************************************/
+static void stats_sum(search_stats *total, const search_stats *stats);
+static void stats_write_text(FILE *fp,
+                             const search_stats *stats,
+                             double ticks_per_second);
+static void stats_write_json_string(FILE *fp, const char *str);
+static void stats_write_json(FILE *fp,
+                             const search_stats *stats,
+                             double ticks_per_second);
+
+/* F U N C T I O N S *********************************************************/
+
+/* returns NULL if out of memory */
+stats_report*
+stats_report_open(const char *json_file) {
+    stats_report *report;
+
+    if ( (report = calloc(1, sizeof(stats_report))) == NULL )
+        return NULL;
+
+    if (json_file != NULL)
+        strncpy(report->json_file, json_file, STATS_MAX_NAME_LENGTH - 1);
+
+    clock_gettime(CLOCK_MONOTONIC, &report->start_time);
+    report->start_ticks = stats_now();
+
+    return report;
+}
+
+void
+stats_clear(search_stats *stats, const char *input) {
+    memset(stats, 0, sizeof(search_stats));
+    strncpy(stats->input, input, STATS_MAX_NAME_LENGTH - 1);
+    stats->format  = "-";
+    stats->matcher = "-";
+}
+
+/* note the finished search of an input; returns 0 if out of memory */
+int
+stats_report_add(stats_report *report, const search_stats *stats) {
+    if (report->num_inputs == report->cap) {
+        size_t cap = report->cap ? 2 * report->cap : 8;
+        search_stats *inputs = realloc(report->inputs,
+                                       cap * sizeof(search_stats));
+        if (inputs == NULL)
+            return 0;
+        report->inputs = inputs;
+        report->cap    = cap;
+    }
+
+    report->inputs[report->num_inputs++] = *stats;
+    return 1;
+}
+
+static void
+stats_sum(search_stats *total, const search_stats *stats) {
+    total->records            += stats->records;
+    total->bases              += stats->bases;
+    total->bytes_in           += stats->bytes_in;
+    total->bytes_decompressed += stats->bytes_decompressed;
+    total->bytes_out          += stats->bytes_out;
+    total->matches            += stats->matches;
+    total->searches           += stats->searches;
+    total->read_ticks         += stats->read_ticks;
+    total->match_ticks        += stats->match_ticks;
+    total->report_ticks       += stats->report_ticks;
+    total->inflate_wait       += stats->inflate_wait;
+}
+
+static void
+stats_write_text(FILE *fp, const search_stats *stats, double ticks_per_second) {
+    double wall = stats->wall_ticks / ticks_per_second;
+
+    if (wall <= 0)
+        wall = 1e-9;
+
+    fprintf(fp, "[stats] %s\n", stats->input);
+    fprintf(fp, "\t%-20s%s, %s\n", "input / matcher",
+                stats->format, stats->matcher);
+    fprintf(fp, "\t%-20s%zu (%zu bases)\n", "records",
+                stats->records, stats->bases);
+    fprintf(fp, "\t%-20s%zu (%zu searches)\n", "matches",
+                stats->matches, stats->searches);
+    fprintf(fp, "\t%-20s%zu in, %zu decompressed, %zu out\n", "bytes",
+                stats->bytes_in, stats->bytes_decompressed, stats->bytes_out);
+    fprintf(fp, "\t%-20s%.3f s\n", "read",
+                stats->read_ticks / ticks_per_second);
+    fprintf(fp, "\t%-20s%.3f s\n", "  inflate wait", stats->inflate_wait);
+    fprintf(fp, "\t%-20s%.3f s\n", "match",
+                stats->match_ticks / ticks_per_second);
+    fprintf(fp, "\t%-20s%.3f s\n", "report",
+                stats->report_ticks / ticks_per_second);
+    fprintf(fp, "\t%-20s%.3f s, %.0f reads/s, %.2f MB/s\n", "wall", wall,
+                stats->records / wall,
+                stats->bytes_decompressed / wall / 1e6);
+}
+
+static void
+stats_write_json_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (; *str; str++) {
+        unsigned char c = (unsigned char) *str;
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else
+            fputc(c, fp);
+    }
+    fputc('"', fp);
+}
+
+static void
+stats_write_json(FILE *fp, const search_stats *stats, double ticks_per_second) {
+    double wall = stats->wall_ticks / ticks_per_second;
+
+    if (wall <= 0)
+        wall = 1e-9;
+
+    fprintf(fp, "{\"input\": ");
+    stats_write_json_string(fp, stats->input);
+    fprintf(fp, ", \"format\": ");
+    stats_write_json_string(fp, stats->format);
+    fprintf(fp, ", \"matcher\": ");
+    stats_write_json_string(fp, stats->matcher);
+    fprintf(fp, ", \"records\": %zu, \"bases\": %zu, \"matches\": %zu, "
+                "\"searches\": %zu, \"bytes_in\": %zu, "
+                "\"bytes_decompressed\": %zu, \"bytes_out\": %zu, "
+                "\"read_seconds\": %.6f, \"inflate_wait_seconds\": %.6f, "
+                "\"match_seconds\": %.6f, \"report_seconds\": %.6f, "
+                "\"wall_seconds\": %.6f, \"reads_per_second\": %.0f, "
+                "\"mb_per_second\": %.3f}",
+                stats->records, stats->bases, stats->matches,
+                stats->searches, stats->bytes_in,
+                stats->bytes_decompressed, stats->bytes_out,
+                stats->read_ticks / ticks_per_second, stats->inflate_wait,
+                stats->match_ticks / ticks_per_second,
+                stats->report_ticks / ticks_per_second,
+                wall, stats->records / wall,
+                stats->bytes_decompressed / wall / 1e6);
+}
+
+/*
+   Write the summary of every input and the total, and free the report.
+   Returns 0, or -1 if the JSON file could not be written.
+*/
+int
+stats_report_close(stats_report *report) {
+    struct timespec end_time;
+    stats_ticks end_ticks;
+    double seconds, ticks_per_second;
+    search_stats total;
+    FILE *fp = stderr;
+    size_t i;
+    int ret = 0;
+
+    if (report == NULL)
+        return 0;
+
+    /* the tick rate, measured over the whole run */
+    end_ticks = stats_now();
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    seconds = (double) (end_time.tv_sec - report->start_time.tv_sec) +
+              (double) (end_time.tv_nsec - report->start_time.tv_nsec) / 1e9;
+    ticks_per_second = (seconds > 0 && end_ticks > report->start_ticks) ?
+                       (end_ticks - report->start_ticks) / seconds : 1e9;
+
+    stats_clear(&total, "total");
+    for (i = 0; i < report->num_inputs; i++)
+        stats_sum(&total, &report->inputs[i]);
+    total.wall_ticks = end_ticks - report->start_ticks;
+
+    if (strlen(report->json_file)) {
+        if ( (fp = fopen(report->json_file, "w")) == NULL ) {
+            free(report->inputs);
+            free(report);
+            return -1;
+        }
+
+        fprintf(fp, "{\"inputs\": [");
+        for (i = 0; i < report->num_inputs; i++) {
+            fprintf(fp, i ? ",\n  " : "\n  ");
+            stats_write_json(fp, &report->inputs[i], ticks_per_second);
+        }
+        fprintf(fp, "\n ],\n \"total\": ");
+        stats_write_json(fp, &total, ticks_per_second);
+        fprintf(fp, "\n}\n");
+
+        if (fclose(fp) != 0)
+            ret = -1;
+    }
+    else {
+        for (i = 0; i < report->num_inputs; i++)
+            stats_write_text(fp, &report->inputs[i], ticks_per_second);
+        if (report->num_inputs != 1)
+            stats_write_text(fp, &total, ticks_per_second);
+    }
+
+    free(report->inputs);
+    free(report);
+    return ret;
+}
@@ -0,0 +1,114 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+/* N O T E S *****************************************************************/
+/* Per-stage timing and throughput counters ('--stats')
+
+   The search of an input is split into three stages, each timed on its
+   own:
+
+     read    -- parsing records (kseq or the memory mapped parser),
+                including any time spent waiting on the decompression
+                threads, which is also given separately as 'inflate wait'
+     match   -- running the matcher over the records
+     report  -- formatting the output of the reported records
+
+   In the threaded search ('-t') the stages overlap, and the times are
+   the busy times of the reader thread, of all the workers together, and
+   of the writer.
+
+   The timers are read with 'rdtsc' on x86 (a handful of cycles per
+   reading), and with 'clock_gettime' elsewhere.  The ticks are turned
+   into seconds once the run is over, against the wall clock time of the
+   whole run, so no calibration is needed up front.
+
+   A summary of every input and the total is written to stderr when the
+   run is over, or as JSON to the file named with '--stats=<FILE>'.
+*/
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* D E F I N E S *************************************************************/
+#define STATS_MAX_NAME_LENGTH 2048
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef unsigned long long stats_ticks;
+
+typedef struct {
+    char        input[STATS_MAX_NAME_LENGTH];
+    const char  *format;          /* how the input was read */
+    const char  *matcher;         /* which search engine ran */
+    size_t      records;
+    size_t      bases;
+    size_t      bytes_in;         /* of the input file(s), as stored */
+    size_t      bytes_decompressed;
+    size_t      bytes_out;
+    size_t      matches;
+    size_t      searches;         /* matcher runs (mates may be skipped) */
+    stats_ticks read_ticks;
+    stats_ticks match_ticks;
+    stats_ticks report_ticks;
+    stats_ticks wall_ticks;
+    double      inflate_wait;     /* seconds */
+} search_stats;
+
+typedef struct {
+    char            json_file[STATS_MAX_NAME_LENGTH]; /* or empty */
+    search_stats    *inputs;
+    size_t          num_inputs;
+    size_t          cap;
+    stats_ticks     start_ticks;
+    struct timespec start_time;
+} stats_report;
+
+/* P R O T O T Y P E S *******************************************************/
+stats_report* stats_report_open(const char *json_file);
+void stats_clear(search_stats *stats, const char *input);
+int stats_report_add(stats_report *report, const search_stats *stats);
+int stats_report_close(stats_report *report);
+
+static inline stats_ticks
+stats_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (stats_ticks) ts.tv_sec * 1000000000ULL + (stats_ticks) ts.tv_nsec;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STATS_H */
@@ -0,0 +1,336 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Adapter trimming reports
+
+   See trim.h for details.
+*/
+
+/* I N C L U D E S ***********************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "trim.h"
+
+/* P R O T O T Y P E S *******************************************************/
+static outbuf* trim_output_open(const char *prefix,
+                                int mismatches,
+                                const char *suffix);
+static int     trim_output_close(outbuf *out);
+static int     trim_outputs_close(trim_report *report);
+static outbuf* trim_table_open(const trim_report *report, const char *suffix);
+static void    trim_write_read(outbuf *out,
+                               int fasta,
+                               const trim_read *read,
+                               size_t start,
+                               size_t end);
+static int     trim_write_tables(const trim_report *report);
+
+/* F U N C T I O N S *********************************************************/
+
+/*
+   Open the trim, omit and untrimmed outputs of every mismatch level.
+   Returns NULL if out of memory or an output cannot be created.
+*/
+trim_report*
+trim_report_open(const char *prefix,
+                 int side,
+                 int fasta,
+                 const int *mismatches,
+                 size_t num_levels) {
+    trim_report *report;
+    size_t i;
+
+    if (num_levels == 0 || num_levels > TRIM_MAX_LEVELS)
+        return NULL;
+
+    if ( (report = calloc(1, sizeof(trim_report))) == NULL )
+        return NULL;
+
+    report->side  = side;
+    report->fasta = fasta;
+    strncpy(report->prefix, prefix, TRIM_MAX_PREFIX_LENGTH - 1);
+    report->num_levels = num_levels;
+
+    for (i = 0; i < num_levels; i++) {
+        trim_level *level = &report->levels[i];
+
+        level->max_mismatches = mismatches[i];
+        level->trimmed   = trim_output_open(prefix, mismatches[i], "trim");
+        level->omitted   = trim_output_open(prefix, mismatches[i], "omit");
+        level->untrimmed = trim_output_open(prefix, mismatches[i], "utrim");
+        if ( level->trimmed == NULL || level->omitted == NULL ||
+             level->untrimmed == NULL ) {
+            report->num_levels = i + 1;
+            trim_outputs_close(report);
+            free(report);
+            return NULL;
+        }
+    }
+
+    return report;
+}
+
+/* '<prefix>.<mismatches>.<suffix>' */
+static outbuf*
+trim_output_open(const char *prefix, int mismatches, const char *suffix) {
+    char path[TRIM_MAX_PREFIX_LENGTH + 64];
+    outbuf *out;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s.%d.%s", prefix, mismatches, suffix);
+    if ( (fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0 )
+        return NULL;
+
+    if ( (out = outbuf_open(fd)) == NULL )
+        close(fd);
+
+    return out;
+}
+
+static int
+trim_output_close(outbuf *out) {
+    int fd, ret;
+
+    if (out == NULL)
+        return 0;
+
+    fd  = out->fd;
+    ret = outbuf_close(out);
+    if (close(fd) != 0)
+        ret = -1;
+
+    return ret;
+}
+
+/* close the outputs of every level; returns -1 if any failed */
+static int
+trim_outputs_close(trim_report *report) {
+    size_t i;
+    int ret = 0;
+
+    for (i = 0; i < report->num_levels; i++) {
+        trim_level *level = &report->levels[i];
+        if (trim_output_close(level->trimmed) != 0)
+            ret = -1;
+        if (trim_output_close(level->omitted) != 0)
+            ret = -1;
+        if (trim_output_close(level->untrimmed) != 0)
+            ret = -1;
+        free(level->length_counts);
+        level->trimmed       = NULL;
+        level->omitted       = NULL;
+        level->untrimmed     = NULL;
+        level->length_counts = NULL;
+    }
+
+    return ret;
+}
+
+/* '<prefix>.<suffix>' */
+static outbuf*
+trim_table_open(const trim_report *report, const char *suffix) {
+    char path[TRIM_MAX_PREFIX_LENGTH + 64];
+    outbuf *out;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s.%s", report->prefix, suffix);
+    if ( (fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0 )
+        return NULL;
+
+    if ( (out = outbuf_open(fd)) == NULL )
+        close(fd);
+
+    return out;
+}
+
+/* write out the 'start' to 'end' stretch of the read */
+static void
+trim_write_read(outbuf *out,
+                int fasta,
+                const trim_read *read,
+                size_t start,
+                size_t end) {
+    fasta = fasta || read->qual_l == 0;
+
+    outbuf_putc(out, fasta ? '>' : '@');
+    outbuf_write(out, read->name, read->name_l);
+    if (read->comment_l) {
+        outbuf_putc(out, ' ');
+        outbuf_write(out, read->comment, read->comment_l);
+    }
+    outbuf_putc(out, '\n');
+    outbuf_write(out, read->seq + start, end - start);
+    outbuf_putc(out, '\n');
+
+    if (!fasta) {
+        outbuf_write(out, "+\n", 2);
+        outbuf_write(out, read->qual + start, end - start);
+        outbuf_putc(out, '\n');
+    }
+}
+
+/*
+   Route a read, given its adapter match (if 'matched'), at every level.
+   Returns 0 if out of memory.
+*/
+int
+trim_report_add(trim_report *report,
+                const trim_read *read,
+                int matched,
+                int cost,
+                size_t match_start,
+                size_t match_end) {
+    size_t i, start, end, length;
+    int omit;
+
+    /* the part of the read that is kept */
+    if (report->side == TRIM_LEFT) {
+        start = match_end;
+        end   = read->seq_l;
+        omit  = match_end >= read->seq_l;
+    }
+    else {
+        start = 0;
+        end   = match_start;
+        omit  = match_start == 0;
+    }
+    length = omit ? 0 : end - start;
+
+    for (i = 0; i < report->num_levels; i++) {
+        trim_level *level = &report->levels[i];
+
+        level->total_reads++;
+
+        if ( !matched || cost > level->max_mismatches ) {
+            trim_write_read(level->untrimmed, report->fasta,
+                            read, 0, read->seq_l);
+            continue;
+        }
+
+        level->matched_reads++;
+        if (omit) {
+            level->omitted_reads++;
+            trim_write_read(level->omitted, report->fasta,
+                            read, 0, read->seq_l);
+        }
+        else {
+            level->trimmed_reads++;
+            trim_write_read(level->trimmed, report->fasta,
+                            read, start, end);
+        }
+
+        if (length >= level->length_cap) {
+            size_t cap = level->length_cap ? level->length_cap : 256;
+            long *counts;
+            while (length >= cap)
+                cap *= 2;
+            counts = realloc(level->length_counts, cap * sizeof(long));
+            if (counts == NULL)
+                return 0;
+            memset(counts + level->length_cap, 0,
+                   (cap - level->length_cap) * sizeof(long));
+            level->length_counts = counts;
+            level->length_cap    = cap;
+        }
+        level->length_counts[length]++;
+    }
+
+    return 1;
+}
+
+/* the read count ('rch') and read length ('rlh') histogram tables */
+static int
+trim_write_tables(const trim_report *report) {
+    size_t i, l, max_length = 0;
+    outbuf *out;
+
+    if ( (out = trim_table_open(report, "rch.dat")) == NULL )
+        return -1;
+
+    outbuf_puts(out, "MismatchThreshold\tTotalFilteredReads\tTrimmed\t"
+                     "Omitted\tTotalReads\n");
+    for (i = 0; i < report->num_levels; i++) {
+        const trim_level *level = &report->levels[i];
+        outbuf_put_int(out, level->max_mismatches);
+        outbuf_putc(out, '\t');
+        outbuf_put_int(out, level->matched_reads);
+        outbuf_putc(out, '\t');
+        outbuf_put_int(out, level->trimmed_reads);
+        outbuf_putc(out, '\t');
+        outbuf_put_int(out, level->omitted_reads);
+        outbuf_putc(out, '\t');
+        outbuf_put_int(out, level->total_reads);
+        outbuf_putc(out, '\n');
+    }
+    if (trim_output_close(out) != 0)
+        return -1;
+
+    /* every level's histogram runs up to the longest trimmed read */
+    for (i = 0; i < report->num_levels; i++) {
+        const trim_level *level = &report->levels[i];
+        for (l = 0; l < level->length_cap; l++) {
+            if (level->length_counts[l] && l > max_length)
+                max_length = l;
+        }
+    }
+
+    if ( (out = trim_table_open(report, "rlh.dat")) == NULL )
+        return -1;
+
+    outbuf_puts(out, "Mismatch\tReadLength\tReadCount\n");
+    for (i = 0; i < report->num_levels; i++) {
+        const trim_level *level = &report->levels[i];
+        for (l = 0; l <= max_length; l++) {
+            outbuf_put_int(out, level->max_mismatches);
+            outbuf_putc(out, '\t');
+            outbuf_put_int(out, (long) l);
+            outbuf_putc(out, '\t');
+            outbuf_put_int(out, l < level->length_cap ?
+                                level->length_counts[l] : 0);
+            outbuf_putc(out, '\n');
+        }
+    }
+
+    return trim_output_close(out);
+}
+
+/*
+   Write the tables, and close (and free) all the outputs.  Returns -1 if
+   any of the output could not be written, otherwise 0.
+*/
+int
+trim_report_close(trim_report *report) {
+    int ret = 0;
+
+    if (report == NULL)
+        return 0;
+
+    if (trim_write_tables(report) != 0)
+        ret = -1;
+    if (trim_outputs_close(report) != 0)
+        ret = -1;
+
+    free(report);
+    return ret;
+}
@@ -0,0 +1,116 @@
+/* L I C E N S E *************************************************************/
+
+/*
+    Copyright (C) 2010, 2011 Indraniel Das <indraniel@gmail.com>
+                             and Washington University in St. Louis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/* N O T E S *****************************************************************/
+/* Adapter trimming reports
+
+   The native replacement for the scripts/fqgrep-trim.pl pipeline.  Each
+   read is matched once against an adapter anchored to its start ('left'
+   trimming) or its end ('right' trimming), allowing for the highest of
+   the requested mismatch levels.  The lowest cost alignment is also the
+   one found when searching with any higher level, so every level is
+   decided from that one match, in the same pass over the input.
+
+   For every mismatch level <m> the reads are routed to one of
+
+     <prefix>.<m>.trim   -- reads with the adapter cut off (along with
+                            the matching stretch of quality values)
+     <prefix>.<m>.omit   -- reads where the adapter reaches the opposite
+                            end, so nothing would be left
+     <prefix>.<m>.utrim  -- reads without the adapter, unaltered
+
+   and once the input is done two tables are written, in the same layout
+   as the script wrote them:
+
+     <prefix>.rch.dat    -- reads filtered, trimmed and omitted per level
+     <prefix>.rlh.dat    -- the trimmed read length histogram per level
+*/
+
+#ifndef _TRIM_H_
+#define _TRIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* I N C L U D E S ***********************************************************/
+#include <stdlib.h>
+#include "outbuf.h"
+
+/* D E F I N E S *************************************************************/
+#define TRIM_LEFT  1              /* the adapter precedes the read */
+#define TRIM_RIGHT 2              /* the adapter follows the read */
+
+#define TRIM_MAX_LEVELS 16
+#define TRIM_MAX_PREFIX_LENGTH 1024
+
+/* D A T A    S T R U C T U R E S ********************************************/
+typedef struct {
+    const char *name;
+    size_t     name_l;
+    const char *comment;
+    size_t     comment_l;
+    const char *seq;
+    size_t     seq_l;
+    const char *qual;
+    size_t     qual_l;
+} trim_read;
+
+typedef struct {
+    int    max_mismatches;        /* the level's match cost threshold */
+    outbuf *trimmed;
+    outbuf *omitted;
+    outbuf *untrimmed;
+    long   total_reads;
+    long   matched_reads;
+    long   trimmed_reads;
+    long   omitted_reads;
+    long   *length_counts;        /* trimmed read length histogram */
+    size_t length_cap;
+} trim_level;
+
+typedef struct {
+    int        side;              /* TRIM_LEFT or TRIM_RIGHT */
+    int        fasta;             /* write FASTA rather than FASTQ */
+    char       prefix[TRIM_MAX_PREFIX_LENGTH];
+    size_t     num_levels;
+    trim_level levels[TRIM_MAX_LEVELS];
+} trim_report;
+
+/* P R O T O T Y P E S *******************************************************/
+trim_report* trim_report_open(const char *prefix,
+                              int side,
+                              int fasta,
+                              const int *mismatches,
+                              size_t num_levels);
+int trim_report_add(trim_report *report,
+                    const trim_read *read,
+                    int matched,
+                    int cost,
+                    size_t match_start,
+                    size_t match_end);
+int trim_report_close(trim_report *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TRIM_H */